@@ -0,0 +1,277 @@
+// bench.cpp: Benchmark suite over synthetic columns, reported as a table and as JSON
+#include "Codec.h"
+#include "ColumnGenerator.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+#include <string.h>    // strcmp
+#include <algorithm>   // std::sort, std::min
+#include <chrono>
+#include <cmath>       // std::ceil
+#include <cstdio>      // std::remove
+#include <fstream>
+#include <iomanip>     // std::setw, std::setprecision
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// A column shape the suite runs every API on
+struct Scenario {
+    std::string name;
+    ColumnSpec spec;
+};
+
+// Timings of one API on one scenario
+struct Measurement {
+    std::string scenario;
+    std::string api;
+    const ColumnSpec* spec;
+    std::vector<double> seconds;  // One per trial, sorted
+    double rowsPerSecond;
+    double bytesPerSecond;
+};
+
+// Run fn(i) warmup times untimed, then trials times timed. i counts on across warmup and trials, so a
+// query trial can take its own key.
+template <typename Fn>
+std::vector<double> TimeTrials(size_t warmup, size_t trials, Fn fn) {
+    for (size_t i = 0; i < warmup; i++) {
+        fn(i);
+    }
+    std::vector<double> seconds;
+    for (size_t i = 0; i < trials; i++) {
+        auto start = std::chrono::steady_clock::now();
+        fn(warmup + i);
+        auto end = std::chrono::steady_clock::now();
+        seconds.push_back(std::chrono::duration<double>(end - start).count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds;
+}
+
+// Median of sorted samples
+double Median(const std::vector<double>& sorted) {
+    size_t n = sorted.size();
+    return n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+}
+
+// Nearest-rank percentile of sorted samples (the largest sample below 100 trials, for p99)
+double Percentile(const std::vector<double>& sorted, double p) {
+    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+    return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Measurement whose throughput is rows and bytes handled per trial, at the median time
+Measurement Summarize(const Scenario& scenario, const std::string& api, std::vector<double> seconds,
+                      double rows, double bytes) {
+    double median = Median(seconds);
+    return {scenario.name, api, &scenario.spec, std::move(seconds), rows / median, bytes / median};
+}
+
+const char* DistributionName(ColumnSpec::Distribution distribution) {
+    return distribution == ColumnSpec::Distribution::Zipf ? "zipf" : "uniform";
+}
+
+// Write the run as JSON, one object per measurement
+bool WriteJson(const std::string& path, const std::vector<Measurement>& measurements, size_t rows,
+               size_t warmup, size_t trials, const EncodeOptions& options) {
+    std::ofstream out(path);
+    if (!out.is_open()) return false;
+    out << std::setprecision(9);
+    out << "{\n";
+    out << "  \"kernels\": \"" << ActiveKernels().name << "\",\n";
+    out << "  \"threads\": " << ThreadPool::Shared().Size() << ",\n";
+    out << "  \"rows\": " << rows << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"trials\": " << trials << ",\n";
+    out << "  \"options\": {\"sorted\": " << (options.sortedDictionary ? "true" : "false")
+        << ", \"index\": " << (options.buildPostingIndex ? "true" : "false")
+        << ", \"compress\": " << (options.compressCodes ? "true" : "false") << "},\n";
+    out << "  \"results\": [\n";
+    for (size_t i = 0; i < measurements.size(); i++) {
+        const Measurement& m = measurements[i];
+        out << "    {\"scenario\": \"" << m.scenario << "\", \"api\": \"" << m.api << "\""
+            << ", \"distribution\": \"" << DistributionName(m.spec->distribution) << "\""
+            << ", \"cardinality\": " << m.spec->cardinality
+            << ", \"min_length\": " << m.spec->minLength << ", \"max_length\": " << m.spec->maxLength
+            << ", \"trials\": " << m.seconds.size()
+            << ", \"median_seconds\": " << Median(m.seconds)
+            << ", \"p99_seconds\": " << Percentile(m.seconds, 0.99)
+            << ", \"min_seconds\": " << m.seconds.front()
+            << ", \"rows_per_second\": " << m.rowsPerSecond
+            << ", \"bytes_per_second\": " << m.bytesPerSecond << "}"
+            << (i + 1 < measurements.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return out.good();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    // Optional arguments: rows=N (1000000), trials=N (25), warmup=N (3), out=<path> (bench.json),
+    // scenario=<name> to run only the scenarios whose name contains it, and sorted, index or compress
+    // as for write_encoding
+    size_t rows = 1000000, trials = 25, warmup = 3;
+    std::string outPath = "bench.json";
+    std::string only;
+    EncodeOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        size_t eq = arg.find('=');
+        std::string name = arg.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+        if (name == "rows") rows = std::max<size_t>(1, std::stoul(value));
+        else if (name == "trials") trials = std::max<size_t>(1, std::stoul(value));
+        else if (name == "warmup") warmup = std::stoul(value);
+        else if (name == "out") outPath = value;
+        else if (name == "scenario") only = value;
+        else if (strcmp(argv[i], "sorted") == 0) options.sortedDictionary = true;
+        else if (strcmp(argv[i], "index") == 0) options.buildPostingIndex = true;
+        else if (strcmp(argv[i], "compress") == 0) options.compressCodes = true;
+        else {
+            std::cerr << "Error: unknown argument " << arg << ", please refer to README.md" << std::endl;
+            return 1;
+        }
+    }
+
+    // Encode and load run a whole column per trial, so they get fewer trials than the queries
+    size_t heavyTrials = std::max<size_t>(3, trials / 5);
+    size_t heavyWarmup = std::min<size_t>(warmup, 1);
+
+    // Cardinality from a handful of values to half the rows, uniform and skewed, short and long keys
+    std::vector<Scenario> scenarios;
+    auto addScenario = [&](const std::string& name, ColumnSpec::Distribution distribution, size_t cardinality,
+                           size_t minLength, size_t maxLength) {
+        ColumnSpec spec;
+        spec.rows = rows;
+        spec.distribution = distribution;
+        spec.zipfExponent = 1.1;
+        spec.cardinality = cardinality;
+        spec.minLength = minLength;
+        spec.maxLength = maxLength;
+        if (only.empty() || name.find(only) != std::string::npos) scenarios.push_back({name, spec});
+    };
+    addScenario("uniform-low-card", ColumnSpec::Distribution::Uniform, 64, 8, 16);
+    addScenario("uniform-high-card", ColumnSpec::Distribution::Uniform, std::max<size_t>(1, rows / 2), 8, 16);
+    addScenario("zipf", ColumnSpec::Distribution::Zipf, 100000, 8, 16);
+    addScenario("short-keys", ColumnSpec::Distribution::Uniform, 10000, 3, 6);
+    addScenario("long-keys", ColumnSpec::Distribution::Uniform, 10000, 64, 128);
+    if (scenarios.empty()) {
+        std::cerr << "Error: no scenario matches " << only << std::endl;
+        return 1;
+    }
+
+    // The codec reports its progress on std::cout; the report is written to the original buffer
+    std::ostream report(std::cout.rdbuf());
+    std::cout.rdbuf(nullptr);
+    report << "SIMD kernels: " << ActiveKernels().name << ", " << ThreadPool::Shared().Size() << " threads, "
+           << rows << " rows, " << warmup << " warmup + " << trials << " trials (" << heavyTrials
+           << " for encode and load)" << std::endl;
+    report << std::left << std::setw(20) << "scenario" << std::setw(14) << "api" << std::right
+           << std::setw(12) << "median ms" << std::setw(12) << "p99 ms" << std::setw(12) << "Mrows/s"
+           << std::setw(12) << "MB/s" << std::endl;
+
+    const std::string encodedPath = "src/Bench.enc";
+    std::vector<Measurement> measurements;
+    for (const Scenario& scenario : scenarios) {
+        ColumnGenerator generator(scenario.spec);
+        std::vector<std::string> column = generator.Rows();
+        double columnBytes = 0;
+        for (const std::string& value : column) {
+            columnBytes += value.size();
+        }
+
+        // Query keys come from random rows, so they follow the column's own skew
+        std::mt19937_64 rng(scenario.spec.seed);
+        std::uniform_int_distribution<size_t> dist(0, column.size() - 1);
+        std::vector<std::string> probes;
+        for (size_t i = 0; i < warmup + trials; i++) {
+            probes.push_back(column[dist(rng)]);
+        }
+        auto probe = [&](size_t i) -> const std::string& { return probes[i % probes.size()]; };
+
+        size_t first = measurements.size();
+
+        // Encode: dictionary build, encode pass and file write, throughput over the raw strings
+        // A failed trial would time as a fast one, so any failure ends the run
+        bool encoded = true;
+        std::vector<double> encodeSeconds = TimeTrials(heavyWarmup, heavyTrials, [&](size_t) {
+            DictionaryCodec codec;
+            encoded = codec.EncodeColumn(column, encodedPath, options) && encoded;
+        });
+        if (!encoded) {
+            std::cerr << "Error: cannot encode " << encodedPath << std::endl;
+            return 1;
+        }
+        measurements.push_back(Summarize(scenario, "encode", std::move(encodeSeconds), rows, columnBytes));
+
+        // Load: map the encoded file and rebuild the lookups, throughput over the file size
+        double fileBytes = 0;
+        {
+            std::ifstream file(encodedPath, std::ios::binary | std::ios::ate);
+            fileBytes = static_cast<double>(file.tellg());
+        }
+        bool loaded = true;
+        std::vector<double> loadSeconds = TimeTrials(heavyWarmup, heavyTrials, [&](size_t) {
+            DictionaryCodec codec;
+            loaded = codec.LoadEncodedFile(encodedPath) && loaded;
+        });
+        if (!loaded) {
+            std::cerr << "Error: cannot load " << encodedPath << std::endl;
+            return 1;
+        }
+        measurements.push_back(Summarize(scenario, "load", std::move(loadSeconds), rows, fileBytes));
+
+        // Queries on the loaded column, throughput over the rows and raw strings they answer for
+        DictionaryCodec codec;
+        if (!codec.LoadEncodedFile(encodedPath)) {
+            std::cerr << "Error: cannot load " << encodedPath << std::endl;
+            return 1;
+        }
+        size_t sink = 0;  // Result sizes, so no query is optimized away
+        measurements.push_back(Summarize(scenario, "item", TimeTrials(warmup, trials, [&](size_t i) {
+            sink += codec.SIMDQueryItem(probe(i)).size();
+        }), rows, columnBytes));
+        measurements.push_back(Summarize(scenario, "item_scalar", TimeTrials(warmup, trials, [&](size_t i) {
+            sink += codec.QueryItem(probe(i)).size();
+        }), rows, columnBytes));
+        measurements.push_back(Summarize(scenario, "prefix", TimeTrials(warmup, trials, [&](size_t i) {
+            sink += codec.SIMDQueryByPrefix(std::string_view(probe(i)).substr(0, 3)).size();
+        }), rows, columnBytes));
+        size_t batchKeys = 16;
+        measurements.push_back(Summarize(scenario, "batch16", TimeTrials(warmup, trials, [&](size_t i) {
+            std::vector<std::string> keys;
+            for (size_t k = 0; k < batchKeys; k++) {
+                keys.push_back(probe(i * batchKeys + k));
+            }
+            for (const SelectionVector& result : codec.QueryBatch(keys)) {
+                sink += result.size();
+            }
+        }), rows, columnBytes));
+        measurements.push_back(Summarize(scenario, "baseline_item", TimeTrials(warmup, trials, [&](size_t i) {
+            sink += codec.BaselineSearch(probe(i)).size();
+        }), rows, columnBytes));
+        if (sink == SIZE_MAX) report << sink;
+
+        for (size_t m = first; m < measurements.size(); m++) {
+            const Measurement& measurement = measurements[m];
+            report << std::left << std::setw(20) << measurement.scenario << std::setw(14) << measurement.api
+                   << std::right << std::fixed << std::setprecision(3)
+                   << std::setw(12) << Median(measurement.seconds) * 1e3
+                   << std::setw(12) << Percentile(measurement.seconds, 0.99) * 1e3
+                   << std::setw(12) << measurement.rowsPerSecond / 1e6
+                   << std::setw(12) << measurement.bytesPerSecond / 1e6 << std::endl;
+        }
+    }
+    std::remove(encodedPath.c_str());
+
+    if (!WriteJson(outPath, measurements, rows, warmup, trials, options)) {
+        std::cerr << "Error: failed to write " << outPath << std::endl;
+        return 1;
+    }
+    report << "Results written to " << outPath << std::endl;
+    return 0;
+}
@@ -0,0 +1,134 @@
+// CodeColumn.h: Encoded column stored at the narrowest code width that fits the dictionary
+
+#ifndef CODE_COLUMN_H
+#define CODE_COLUMN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CodeSet.h"
+#include "SelectionVector.h"
+
+// Codes are stored either byte-aligned (8/16/32/64 bits) or bit-packed (any other width from 1 to 32).
+// Bit-packed codes are grouped in blocks of 64 codes, so block k always starts at word k * bitWidth.
+//
+// A column can also be block-compressed (Compress): every kCompressedBlock rows are stored with
+// whichever of three encodings is smallest, and scans evaluate predicates on that form.
+//   uint64_t directory[blocks]   encoding in bits 0-1, width in bits 2-7, payload word offset above
+//   uint64_t payloads[]          one per block:
+//     frame of reference  uint64_t reference, then code - reference packed at width bits in 64-code blocks
+//                         (nothing at width 0, every code is the reference)
+//     run length          uint64_t runs, uint32_t codes[runs], uint16_t ends[runs] (exclusive, within the block)
+//     delta               uint32_t starts[64-code blocks] padded to a word, then code - previous code packed at
+//                         width bits in 64-code blocks (only for non-decreasing blocks, each 64-code block
+//                         starts over from its start)
+class CodeColumn {
+public:
+    // Number of codes per bit-packed block
+    static constexpr size_t kPackedBlock = 64;
+
+    // Number of codes per compressed block (a whole number of bit-packed blocks)
+    static constexpr size_t kCompressedBlock = 1024;
+
+    // End row meaning "to the end of the column"
+    static constexpr size_t kAllRows = ~size_t(0);
+
+    CodeColumn() = default;
+
+    // Owned storage moves with the column, so only moves are allowed
+    CodeColumn(const CodeColumn&) = delete;
+    CodeColumn& operator=(const CodeColumn&) = delete;
+    CodeColumn(CodeColumn&&) = default;
+    CodeColumn& operator=(CodeColumn&&) = default;
+
+    // True if bitWidth is stored as a plain integer array
+    static bool IsByteAligned(unsigned bitWidth) {
+        return bitWidth == 8 || bitWidth == 16 || bitWidth == 32 || bitWidth == 64;
+    }
+
+    // Pick the storage width for codes 0 .. cardinality - 1
+    static unsigned ChooseBitWidth(size_t cardinality);
+
+    // Bytes needed to store rows codes at bitWidth
+    static size_t BytesFor(size_t rows, unsigned bitWidth);
+
+    // Pack codes into owned storage at bitWidth
+    void Pack(const std::vector<size_t>& codes, unsigned bitWidth);
+
+    // Allocate zeroed owned storage for rows codes at bitWidth, to be filled with Set
+    void Allocate(size_t rows, unsigned bitWidth);
+
+    // Store a code into allocated storage. Threads may fill the column concurrently
+    // as long as each one owns whole kPackedBlock-row blocks.
+    void Set(size_t index, size_t code);
+
+    // Re-encode the codes block-compressed into owned storage, unless that saves less than a quarter of
+    // the bytes. Returns true if the column is compressed.
+    bool Compress();
+
+    // Point the column at already packed (or block-compressed) codes, e.g. a mapped file; returns false
+    // if the sizes disagree or a compressed directory is malformed
+    bool Attach(const void* data, size_t bytes, size_t rows, unsigned bitWidth, bool compressed = false);
+
+    // Drop the codes (and any owned storage)
+    void Clear();
+
+    // Code stored at a row
+    size_t Get(size_t index) const;
+
+    // Codes of the given rows, in the order given (codes[i] is the code of rows[i])
+    void Gather(const uint32_t* rows, size_t n, size_t* codes) const;
+
+    // Codes of rows [begin, end), end clamped to the column size
+    void Unpack(size_t begin, size_t end, size_t* codes) const;
+
+    // Add one to counts[code] for the code of every row in [begin, end) (counts must span every code stored)
+    void CountCodes(size_t begin, size_t end, uint32_t* counts) const;
+
+    // Scans append matching rows in ascending order. They cover the whole column by default, or only
+    // rows [begin, end) so a scan can be split into morsels; on bit-packed columns begin must be a
+    // multiple of kPackedBlock. Compressed blocks are matched run by run or on their packed offsets.
+
+    // Append every row whose code equals code, one row at a time
+    void ScanEqualScalar(size_t code, SelectionVector& results, size_t begin = 0, size_t end = kAllRows) const;
+
+    // Append every row whose code equals code, using the SIMD kernel for the column's width
+    void ScanEqual(size_t code, SelectionVector& results, size_t begin = 0, size_t end = kAllRows) const;
+
+    // Append every row whose code lies in [lo, hi), one row at a time
+    void ScanRangeScalar(size_t lo, size_t hi, SelectionVector& results,
+                         size_t begin = 0, size_t end = kAllRows) const;
+
+    // Append every row whose code lies in [lo, hi), using the SIMD kernel for the column's width
+    void ScanRange(size_t lo, size_t hi, SelectionVector& results, size_t begin = 0, size_t end = kAllRows) const;
+
+    // Append every row whose code is in set, one row at a time
+    void ScanInScalar(const CodeSet& set, SelectionVector& results, size_t begin = 0, size_t end = kAllRows) const;
+
+    // Append every row whose code is in set, in one SIMD pass over the column.
+    // Every code stored in the column must lie inside the set's code space.
+    void ScanIn(const CodeSet& set, SelectionVector& results, size_t begin = 0, size_t end = kAllRows) const;
+
+    size_t Size() const { return size_; }
+    unsigned BitWidth() const { return bitWidth_; }
+    bool IsCompressed() const { return compressed_; }
+    const uint8_t* Data() const { return data_; }
+    size_t Bytes() const { return compressed_ ? compressedBytes_ : BytesFor(size_, bitWidth_); }
+
+private:
+    // Start of row in the packed codes
+    const uint8_t* RowData(size_t row) const;
+
+    // Run kernel(lane, codes, n, base, out) over rows [begin, end), appending what it writes to results
+    template <typename Kernel>
+    void RunKernel(size_t begin, size_t end, SelectionVector& results, Kernel kernel) const;
+
+    std::vector<uint64_t> owned_;   // Storage when packed in memory (word-aligned)
+    const uint8_t* data_ = nullptr; // Packed codes, owned_ or an external buffer
+    size_t size_ = 0;               // Number of rows
+    unsigned bitWidth_ = 64;        // Bits per code
+    bool compressed_ = false;       // Codes are block-compressed
+    size_t compressedBytes_ = 0;    // Bytes of the compressed codes
+};
+
+#endif // CODE_COLUMN_H
@@ -0,0 +1,57 @@
+// CodeSet.h: Set of dictionary codes tested in a single pass over the encoded column
+
+#ifndef CODE_SET_H
+#define CODE_SET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bitmap over the code space [0, codeSpace). The bitmap is kept as 32-bit words so the
+// scan kernels can gather membership bits eight codes at a time.
+class CodeSet {
+public:
+    // Sets up to this size are scanned with one compare per member instead of bitmap lookups
+    static constexpr size_t kSmallSet = 4;
+
+    explicit CodeSet(size_t codeSpace = 0);
+
+    // Add a code, codes outside the code space are ignored
+    void Insert(size_t code) {
+        if (code >= codeSpace_) return;
+        uint32_t bit = uint32_t(1) << (code & 31);
+        if (bitmap_[code >> 5] & bit) return;
+        bitmap_[code >> 5] |= bit;
+        if (count_ == 0 || code < min_) min_ = code;
+        if (count_ == 0 || code > max_) max_ = code;
+        count_++;
+    }
+
+    bool Contains(size_t code) const {
+        return code < codeSpace_ && (bitmap_[code >> 5] >> (code & 31)) & 1;
+    }
+
+    // Members in ascending order
+    std::vector<size_t> Codes() const;
+
+    size_t Count() const { return count_; }
+    bool Empty() const { return count_ == 0; }
+    size_t CodeSpace() const { return codeSpace_; }
+    size_t Min() const { return min_; }
+    size_t Max() const { return max_; }
+
+    // True if the members form one interval [Min(), Max()], which scans as a range compare
+    bool IsContiguous() const { return count_ != 0 && max_ - min_ + 1 == count_; }
+
+    // Membership bitmap, bit (code & 31) of word (code >> 5)
+    const uint32_t* Bitmap() const { return bitmap_.data(); }
+
+private:
+    std::vector<uint32_t> bitmap_;
+    size_t codeSpace_ = 0;
+    size_t count_ = 0;
+    size_t min_ = 0;
+    size_t max_ = 0;
+};
+
+#endif // CODE_SET_H
@@ -3,69 +3,363 @@
 #define DICTIONARY_CODEC_H
 
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
-#include <mutex>
-#include <shared_mutex>
+#include <utility>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include "ColumnFile.h"
+#include "Epoch.h"
+#include "MappedFile.h"
+#include "StringArena.h"
+#include "FrontCodedDictionary.h"
+#include "CodeColumn.h"
+#include "SelectionVector.h"
+#include "PostingIndex.h"
+#include "ZoneMap.h"
+
+// Comparison predicates for QueryCompare (values compare byte-wise, as unsigned chars)
+enum class CompareOp { Less, LessEqual, Greater, GreaterEqual };
+
+// A value and the number of rows holding it (the view points into the dictionary, valid until it changes)
+using ValueCount = std::pair<std::string_view, uint64_t>;
+
+// Options controlling how a column is encoded
+struct EncodeOptions {
+    // Assign codes in lexicographic key order, so prefix queries become one code-range scan
+    bool sortedDictionary = false;
+
+    // Build a posting-list index (code -> compressed row ids) and store it in the encoded file
+    bool buildPostingIndex = false;
+
+    // Stream the input through a read / encode / write pipeline instead of loading it whole. Memory
+    // stays at a few chunks plus the dictionary for any input size (no posting index in this mode).
+    bool streaming = false;
+
+    // Store the codes block-compressed: run-length, frame-of-reference or delta per block of rows,
+    // whichever is smallest, with scans matching runs and packed offsets in place (not when streaming)
+    bool compressCodes = false;
+
+    // Input bytes per pipeline chunk when streaming
+    size_t chunkBytes = size_t(16) << 20;
+};
 
 class DictionaryCodec {
 public:
     // Constructor
     DictionaryCodec();
 
+    // Destructor, waits for a background compaction
+    ~DictionaryCodec();
+
     // Encoding: Perform dictionary encoding on a column file and generate an encoded output
-    bool EncodeColumnFile(const std::string& inputFile, const std::string& outputFile);
+    bool EncodeColumnFile(const std::string& inputFile, const std::string& outputFile,
+                          const EncodeOptions& options = EncodeOptions());
+
+    // Encoding: Perform dictionary encoding on rows already in memory (options.streaming does not apply)
+    bool EncodeColumn(const std::vector<std::string>& rows, const std::string& outputFile,
+                      const EncodeOptions& options = EncodeOptions());
 
     // Test encoding speed based on number of threads and output graph
     void TestEncodingSpeed(const std::string& inputFile);
 
     // Query: Check if a data item exists in the encoded column, and return indices if it does
-    std::vector<size_t> QueryItem(const std::string& dataItem);
+    SelectionVector QueryItem(std::string_view dataItem);
 
     // SIMD Query: Check if a data item exists in the encoded column, and return indices if it does
-    std::vector<size_t> SIMDQueryItem(const std::string& dataItem);
+    // (with a posting index, rare items decode their row list instead of scanning)
+    SelectionVector SIMDQueryItem(std::string_view dataItem);
 
     // Query with Prefix: Search for items matching a prefix, returning unique items and their indices
-    std::vector<size_t> QueryByPrefix(const std::string& prefix) const;
+    SelectionVector QueryByPrefix(std::string_view prefix) const;
 
     // Helper function to perform  SIMD search for prefix matching in encoded data
-    std::vector<size_t> SIMDQueryByPrefix(const std::string& prefix) const;
+    SelectionVector SIMDQueryByPrefix(std::string_view prefix) const;
+
+    // Comparison Query: rows whose value v satisfies v op bound. A sorted dictionary turns it into one
+    // vectorized code-range compare; otherwise the matching codes are collected first.
+    SelectionVector QueryCompare(CompareOp op, std::string_view bound) const;
+
+    // BETWEEN Query: rows whose value lies in [lo, hi], both ends included
+    SelectionVector QueryBetween(std::string_view lo, std::string_view hi) const;
+
+    // IN-list Query: Rows whose value is any of items, in row order, from one pass over the column
+    SelectionVector QueryIn(const std::vector<std::string>& items) const;
+
+    // Batch Query: rows of every key (results[i] belongs to keys[i]). All keys are resolved against the
+    // dictionary first, then answered from one pass over the column however many keys there are.
+    std::vector<SelectionVector> QueryBatch(const std::vector<std::string>& keys) const;
+
+    // Aggregations count codes straight off the column (or the codes of rows, a query result), with
+    // per-thread counters merged at the end; no row's value is decoded.
+
+    // GROUP BY value, COUNT(*): every value present with its row count, in code order
+    std::vector<ValueCount> GroupByCount(const SelectionVector* rows = nullptr) const;
+
+    // Top-K: the k most frequent values with their row counts, most frequent first (ties in code order)
+    std::vector<ValueCount> TopK(size_t k, const SelectionVector* rows = nullptr) const;
+
+    // COUNT(DISTINCT value)
+    size_t CountDistinct(const SelectionVector* rows = nullptr) const;
+
+    // Code-set predicates, so a multi-column query can evaluate each column's conjunct on its own
+    // (see EncodedTable). A set spans this column's code space and is valid until the dictionary changes.
+
+    // Codes equal to item (empty if it is not in the dictionary)
+    CodeSet ItemCodes(std::string_view item) const;
+
+    // Codes of the values starting with prefix
+    CodeSet PrefixCodes(std::string_view prefix) const;
+
+    // Rows holding one of codes, estimated from an evenly spaced sample of the rows
+    size_t EstimateRows(const CodeSet& codes) const;
+
+    // Rows holding one of codes, from one pass over the column
+    SelectionVector ScanCodes(const CodeSet& codes) const;
+
+    // The rows of rows (ascending) holding one of codes, reading only those rows' codes
+    SelectionVector FilterCodes(const CodeSet& codes, const SelectionVector& rows) const;
+
+    // Baseline Column Search for performance comparison: every row is decoded through the dictionary and
+    // compared as a string, nothing is filtered on codes
+    SelectionVector BaselineSearch(std::string_view dataItem) const;
+
+    // Baseline Column Prefix Search for performance comparison: every row is decoded through the dictionary and
+    // compared as a string, nothing is filtered on codes
+    SelectionVector BaselinePrefixSearch(std::string_view dataItem) const;
+
+    // Baseline Column Comparison Search for performance comparison: every row is decoded through the dictionary and
+    // compared as a string, nothing is filtered on codes
+    SelectionVector BaselineCompareSearch(CompareOp op, std::string_view bound) const;
+
+    // Helper to load encoded data from file (memory-mapped, codes are scanned in place)
+    bool LoadEncodedFile(const std::string& inputFile);
+
+    // Helper to load an encoded column stored at [offset, offset + bytes) of a larger file (e.g. one
+    // column of a table file). It has no delta segments and takes no appends.
+    bool LoadEncodedSegment(const std::string& inputFile, size_t offset, size_t bytes);
+
+    // Append: encode rows against the current dictionary (values not in it get the next codes) and
+    // write them as a delta segment next to the encoded file. Queries see the rows once this returns.
+    // Needs an encoded file, from EncodeColumnFile or LoadEncodedFile.
+    bool AppendRows(const std::vector<std::string>& rows);
+
+    // Append every line of a column file as one delta segment (see AppendRows)
+    bool AppendColumnFile(const std::string& inputFile);
+
+    // Compaction: merge the delta segments into a new base file that replaces the encoded file.
+    // Queries keep running on the old segments until the merged file is swapped in; appends wait.
+    bool Compact();
+
+    // Run Compact on a background thread, unless one is already running
+    void CompactInBackground();
+
+    // Wait for a background compaction, returns its result (true if none ran)
+    bool WaitForCompaction();
+
+    // Number of delta segments not merged into the base file yet
+    size_t GetDeltaCount() const;
 
-    // Baseline Column Search (without dictionary encoding) for performance comparison
-    std::vector<size_t> BaselineSearch(const std::string& dataItem);
+    // Getter for the value stored at a row, rebuilt from its code (valid until the dictionary changes)
+    std::string_view GetData(size_t index) const;
 
-    // Baseline Column Prefix Search (without dictionary encoding) for performance comparison
-    std::vector<size_t> BaselinePrefixSearch(const std::string& dataItem);
+    // Late materialization: copy the values of rows (every row must be in the column), in selection
+    // order, into out; out.Get(i) is the value of rows[i]
+    void Decode(const SelectionVector& rows, StringArena& out) const;
 
-    // Helper to load encoded data from file
-    void LoadEncodedFile(const std::string& inputFile);
+    // Late materialization: copy the values of rows [begin, end) into out; out.Get(i) is row begin + i
+    void DecodeRange(size_t begin, size_t end, StringArena& out) const;
 
-    // Getter for dataColumn_
-    const std::string& GetData(size_t index) const { return dataColumn_[index]; }
+    // Returns the number of rows
+    size_t GetDataSize() const;
 
-    // Returns size of dataColumn_
-    size_t GetDataSize() const { return dataSize_; }
+    // True if codes follow lexicographic key order
+    bool IsDictionarySorted() const;
+
+    // True if point lookups can use a posting index
+    bool HasPostingIndex() const;
 
 private:
-    // Dictionary and encoded data storage
-    std::unordered_map<std::string, size_t> dictionary_;          // Maps data items to unique integer codes
-    std::unique_ptr<std::string[]> dataColumn_;                   // Unencoded data
-    std::vector<size_t> encodedColumn_;                           // Encoded column data as integers (keys)
-    mutable std::shared_mutex dictionaryMutex_;                   // Mutex for thread-safe access to dictionary
-    size_t dataSize_;
+    // The base file's dictionary and codes. Built by an encode, load or compaction and never changed
+    // after, so every version published on top of it shares it.
+    struct BaseColumn {
+        MappedFile file;                                          // Mapping backing the sections after a load
+        StringArena keys;                                         // Dictionary keys indexed by code, stored once
+        FrontCodedDictionary frontCoded;                          // Sorted, front-coded keys -> codes (prefix lookups)
+        std::unordered_map<std::string_view, size_t> dictionary;  // Hash lookup into keys, only without frontCoded
+        CodeColumn codes;                                         // Encoded column data, packed to the narrowest code width
+        PostingIndex postingIndex;                                // Optional code -> rows index
+        ZoneMap zoneMap;                                          // Per-morsel code bounds and filters
+        bool sortedDictionary = false;                            // Codes assigned in key order
+
+        // Rebuild dictionary after keys or frontCoded change
+        void BuildLookup();
+    };
+
+    // Rows appended after the base file was written
+    struct DeltaSegment {
+        MappedFile file;        // Mapping backing codes after a load (appended codes are owned)
+        CodeColumn codes;       // Codes of the segment's rows
+        size_t firstRow = 0;    // Row id of the segment's first row
+    };
+
+    // One end of a key range: unbounded, or key with or without key itself
+    struct KeyBound {
+        std::string_view key;
+        bool inclusive = false;
+        bool bounded = false;
+    };
+
+    // Rows [begin, end) of one segment's codes, whose row 0 is row id firstRow
+    struct Morsel {
+        const CodeColumn* column;
+        size_t begin;
+        size_t end;
+        size_t firstRow;
+    };
+
+    // One published state of the column: a base and the delta segments appended to it. Readers pin
+    // the current version and use it without locks; writers never change a published version, they
+    // publish a successor sharing its base and segments and retire this one (see EpochManager).
+    struct Version {
+        std::shared_ptr<const BaseColumn> base;
+        std::vector<std::shared_ptr<const DeltaSegment>> deltas;
+        StringArena deltaKeys;                                    // Appended keys (code base->keys.Size() + i)
+        std::unordered_map<std::string_view, size_t> deltaLookup; // Hash lookup into deltaKeys
+        size_t dataSize = 0;                                      // Rows, base plus delta segments
+
+        // Rebuild deltaLookup after deltaKeys change
+        void BuildDeltaLookup();
+
+        // Number of codes, base and appended keys
+        size_t DictionarySize() const { return base->keys.Size() + deltaKeys.Size(); }
+
+        // The key of a code
+        std::string_view KeyOf(size_t code) const {
+            size_t baseKeys = base->keys.Size();
+            return code < baseKeys ? base->keys.Get(code) : deltaKeys.Get(code - baseKeys);
+        }
+
+        // The code stored at a row, in the base or a delta segment
+        size_t CodeAt(size_t row) const;
+
+        // The code of a key (~0 if absent), through frontCoded when there is one
+        size_t FindCode(std::string_view key) const;
+
+        // Add the codes of appended keys starting with prefix to codes
+        void AddAppendedPrefixCodes(std::string_view prefix, CodeSet& codes) const;
+
+        // The code interval [lo, hi) of base keys starting with prefix (sorted dictionary only)
+        std::pair<size_t, size_t> PrefixCodeRange(std::string_view prefix) const;
+
+        // The codes of every key starting with prefix, base and appended
+        CodeSet PrefixCodeSet(std::string_view prefix) const;
+
+        // The sorted position of the first base key above key (afterKey) or not below it (needs a
+        // sorted or front-coded dictionary)
+        size_t SortedRank(std::string_view key, bool afterKey) const;
+
+        // The codes of rows[0, n) (ascending), codes[i] is the code of rows[i]
+        void RowCodes(const uint32_t* rows, size_t n, size_t* codes) const;
+
+        // The number of rows holding each code, over the whole column or over rows
+        std::vector<uint64_t> CodeCounts(const SelectionVector* rows) const;
+
+        // Split the base (if withBase) and the delta segments into morsels, in row order
+        std::vector<Morsel> Morsels(bool withBase = true) const;
 
-    // Helper function to populate the dictionary using multiple threads
-    void BuildDictionary(const std::vector<std::string>& columnData, unsigned int numThreads = 8);
+        // Run scan(column, begin, end, results) over the morsels on the shared thread pool, merging the
+        // per-morsel results (shifted to row ids) in row order. Base morsels whose zone fails
+        // mayMatch(zone) are skipped.
+        template <typename ScanFn, typename ZoneFn>
+        SelectionVector ScanMorsels(ScanFn scan, ZoneFn mayMatch, bool withBase = true) const;
+
+        // The rows holding one of codes, from one membership pass over the column
+        SelectionVector ScanCodeSet(const CodeSet& codes) const;
+
+        // Copy the keys of n rows into out, codes(start, count, codes) producing the codes of rows
+        // [start, start + count) of the batch
+        template <typename CodesFn>
+        void DecodeRows(size_t n, CodesFn codes, StringArena& out) const;
+    };
+
+    // The current version pinned for the length of a call. The pin comes first, so the version loaded
+    // after it cannot be freed before the snapshot ends.
+    class Snapshot {
+    public:
+        explicit Snapshot(const DictionaryCodec& codec) : version_(codec.current_.load(std::memory_order_acquire)) {}
+
+        const Version& operator*() const { return *version_; }
+        const Version* operator->() const { return version_; }
+
+    private:
+        EpochManager::Guard guard_;
+        const Version* version_;
+    };
+
+    // Published and retired versions. Only writers (holding writerMutex_) publish and free versions.
+    std::atomic<const Version*> current_{nullptr};                // Version new readers pin
+    std::vector<std::pair<uint64_t, const Version*>> retired_;   // Replaced versions and the epoch they were retired at
+
+    // Writer state
+    std::string encodedPath_;                                     // Encoded file the deltas belong to
+    std::mutex writerMutex_;                                      // Serializes encode, load, append and compaction
+    std::mutex compactorMutex_;                                   // Guards compactor_ and compactResult_
+    std::thread compactor_;                                       // Background compaction
+    std::atomic<bool> compacting_{false};                         // compactor_ is still running
+    bool compactResult_ = true;                                   // Result of the last background compaction
+
+    // Helper for the latest version, for writers (holding writerMutex_ or during construction)
+    const Version& Current() const { return *current_.load(std::memory_order_relaxed); }
+
+    // Helper to make version current and retire the one it replaces. With waitForReaders, wait until
+    // no reader can still hold a retired version and free them all (e.g. to unmap a replaced file);
+    // otherwise free the ones no reader can still hold.
+    void Publish(std::unique_ptr<Version> version, bool waitForReaders);
+
+    // Helper to free the retired versions no reader can still hold
+    void ReclaimVersions();
+
+    // Helper function to populate the dictionary of base using multiple threads (0 = hardware_concurrency).
+    // Codes follow first appearance, or key order when sortedKeys is set.
+    void BuildDictionary(BaseColumn& base, const std::vector<std::string_view>& columnData, bool sortedKeys,
+                         unsigned int numThreads = 0);
+
+    // Helper function to encode every row into base.codes using multiple threads
+    void EncodeRows(BaseColumn& base, const std::vector<std::string_view>& columnData, unsigned int numThreads = 0);
 
     // Helper function to perform search for prefix matching in encoded data
-    std::vector<size_t> SearchByPrefix(const std::string& prefix) const;
+    SelectionVector SearchByPrefix(std::string_view prefix) const;
+
+    // Helper to encode a column file in bounded memory (EncodeOptions::streaming)
+    bool StreamEncodeColumnFile(const std::string& inputFile, const std::string& outputFile,
+                                const EncodeOptions& options);
+
+    // Helper to map a column file and split it into rows, returns false if it cannot be read
+    bool LoadColumnFile(const std::string& inputFile, ColumnFile& column) const;
+
+    // Helper to encode rows in memory and write them to outputFile (EncodeColumnFile without streaming)
+    bool EncodeColumnData(const std::vector<std::string_view>& columnData, const std::string& outputFile,
+                          const EncodeOptions& options);
+
+    // Helper to append rows as one delta segment (AppendRows without the string copies)
+    bool AppendRowViews(const std::vector<std::string_view>& rows);
+
+    // Helper to publish base (written to outputFile) as a version without delta segments
+    void PublishEncoded(std::unique_ptr<BaseColumn> base, const std::string& outputFile);
+
+    // Helper to map an encoded file and its delta segments (LoadEncodedFile without waiting for writers),
+    // or with bytes set, the encoded column at [offset, offset + bytes) of the file without any
+    bool MapEncodedFile(const std::string& inputFile, size_t offset = 0, size_t bytes = 0);
 
-    // Helper to load a column file into memory for processing
-    std::vector<std::string> LoadColumnFile(const std::string& inputFile) const;
+    // Helper to map the delta segment at path onto version, returns false if it is missing or corrupt
+    bool MapDeltaSegment(const std::string& path, Version& version) const;
 
-    // Helper to write the dictionary and encoded column to a file
-    bool WriteEncodedColumnFile(const std::string& outputFile, const std::vector<std::string>& columnData) const;
+    // Helper for the rows whose value lies between lower and upper
+    SelectionVector SearchKeyRange(const KeyBound& lower, const KeyBound& upper) const;
 
 };
 
@@ -0,0 +1,42 @@
+// ColumnFile.h: Column text file mapped into memory and split into rows on the shared thread pool
+
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include "MappedFile.h"
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One row per line, as std::getline would read them, but without copying a byte: every row is a view
+// into the mapping. The file is cut into chunks of whole lines; every chunk counts its newlines, then
+// writes its rows at the offset the counts before it give, both with the byte search kernel for the CPU.
+class ColumnFile {
+public:
+    ColumnFile() = default;
+
+    // Rows point into the mapping, so the file can be neither copied nor moved
+    ColumnFile(const ColumnFile&) = delete;
+    ColumnFile& operator=(const ColumnFile&) = delete;
+
+    // Map path and split it into rows on up to numThreads threads (0 = the whole pool). Returns false if
+    // the file cannot be opened or mapped; an empty file has no rows.
+    bool Open(const std::string& path, unsigned int numThreads = 0);
+
+    // Unmap the file and drop the rows
+    void Close();
+
+    // Rows without their newline, valid until Close
+    const std::vector<std::string_view>& Rows() const { return rows_; }
+    size_t Size() const { return rows_.size(); }
+
+    // Bytes of the mapped file
+    size_t Bytes() const { return file_.Size(); }
+
+private:
+    MappedFile file_;
+    std::vector<std::string_view> rows_;
+};
+
+#endif // COLUMN_FILE_H
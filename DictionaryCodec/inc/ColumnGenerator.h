@@ -0,0 +1,48 @@
+// ColumnGenerator.h: Synthetic string columns with controlled cardinality, skew and key length
+
+#ifndef COLUMN_GENERATOR_H
+#define COLUMN_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Shape of a generated column
+struct ColumnSpec {
+    enum class Distribution { Uniform, Zipf };
+
+    size_t rows = 1000000;
+    size_t cardinality = 10000;                     // Distinct values
+    Distribution distribution = Distribution::Uniform;
+    double zipfExponent = 1.0;                      // Skew: value of rank r is drawn with weight 1 / r^s
+    size_t minLength = 8;                           // Key lengths are uniform in [minLength, maxLength]
+    size_t maxLength = 16;
+    uint64_t seed = 1;
+};
+
+// Generates the distinct keys first, then draws every row from them. Keys start with their index in
+// base 26, padded to the width the cardinality needs, so they are distinct and neighbouring keys share
+// prefixes; random letters fill them up to their length. Ranks are shuffled over the keys, so a Zipf
+// column's frequent values are spread over the key order. The same spec always gives the same column.
+class ColumnGenerator {
+public:
+    explicit ColumnGenerator(const ColumnSpec& spec);
+
+    // The distinct keys, by index
+    const std::vector<std::string>& Keys() const { return keys_; }
+
+    // Every row of the column
+    std::vector<std::string> Rows() const;
+
+private:
+    // Index of the key a row takes, given a uniform draw in [0, 1)
+    size_t Draw(double u) const;
+
+    ColumnSpec spec_;
+    std::vector<std::string> keys_;
+    std::vector<double> cumulative_;   // Zipf only: cumulative weight of ranks 0 .. r, normalized to 1
+    std::vector<uint32_t> rankToKey_;  // Zipf only: key index of each rank
+};
+
+#endif // COLUMN_GENERATOR_H
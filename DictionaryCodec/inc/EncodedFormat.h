@@ -0,0 +1,122 @@
+// EncodedFormat.h: On-disk layout of the binary encoded column file
+//
+// File layout (all integers little-endian):
+//   [EncodedFileHeader]
+//   [dictionary section] uint64_t offsets[dictSize + 1], then the key bytes;
+//                        key for code c is bytes[offsets[c], offsets[c + 1])
+//   [code section]       codes packed at codeBits per row, or block-compressed with kFlagCompressedCodes
+//                        (see CodeColumn), aligned to kSectionAlignment
+//   [index section]      optional posting index (see PostingIndex), aligned to kSectionAlignment
+//   [prefix section]     optional front-coded sorted dictionary (see FrontCodedDictionary), aligned to
+//                        kSectionAlignment
+//   [zone section]       optional per-zone code bounds and presence filters (see ZoneMap), aligned to
+//                        kSectionAlignment
+//
+// Rows appended to an encoded file <path> go to delta segment files <path>.delta0, <path>.delta1, ...
+// until compaction merges them into a new base file. A delta segment file is:
+//   [DeltaSegmentHeader]
+//   [dictionary section] the keys first seen in this segment (codes firstCode .. firstCode + newKeys - 1),
+//                        laid out as in the encoded file
+//   [code section]       codes of the segment's rows (firstRow .. firstRow + rows - 1), aligned to
+//                        kSectionAlignment
+//
+// A table file holds one encoded column per CSV column, each with its own dictionary:
+//   [TableFileHeader]
+//   [column directory]   TableColumnEntry columns[columnCount]
+//   [names section]      column names, laid out as a dictionary section (name of column i is entry i)
+//   [column segments]    one complete encoded file per column, each aligned to kTableSegmentAlignment
+
+#ifndef ENCODED_FORMAT_H
+#define ENCODED_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Magic bytes at the start of every encoded file
+constexpr char kEncodedMagic[8] = {'D', 'I', 'C', 'T', 'C', 'O', 'D', 'E'};
+
+// Bump whenever the layout below changes
+constexpr uint32_t kEncodedVersion = 6;
+
+// Magic bytes at the start of every delta segment file
+constexpr char kDeltaMagic[8] = {'D', 'I', 'C', 'T', 'D', 'L', 'T', 'A'};
+
+// Magic bytes at the start of every table file
+constexpr char kTableMagic[8] = {'D', 'I', 'C', 'T', 'T', 'A', 'B', 'L'};
+
+// Bump whenever the table layout changes (the column segments follow kEncodedVersion)
+constexpr uint32_t kTableVersion = 1;
+
+// Header flags
+constexpr uint32_t kFlagSortedDictionary = 1u << 0; // Codes follow lexicographic key order
+constexpr uint32_t kFlagPostingIndex = 1u << 1;     // File carries an index section
+constexpr uint32_t kFlagFrontCoded = 1u << 2;       // File carries a prefix section
+constexpr uint32_t kFlagZoneMap = 1u << 3;          // File carries a zone section
+constexpr uint32_t kFlagCompressedCodes = 1u << 4;  // Code section is block-compressed
+
+// Sections start on a cache-line boundary so mapped codes can be loaded aligned
+constexpr uint64_t kSectionAlignment = 64;
+
+struct EncodedFileHeader {
+    char magic[8];          // kEncodedMagic
+    uint32_t version;       // kEncodedVersion
+    uint32_t flags;         // kFlag* bits
+    uint64_t dataSize;      // Number of rows in the column
+    uint64_t dictSize;      // Number of dictionary entries (codes are 0 .. dictSize - 1)
+    uint32_t codeBits;      // Bits per code (8/16/32/64, or 1-32 bit-packed; the largest code's width if compressed)
+    uint32_t reserved;      // Written as 0
+    uint64_t dictOffset;    // Byte offset of the dictionary section
+    uint64_t dictBytes;     // Byte length of the dictionary section
+    uint64_t codesOffset;   // Byte offset of the code section
+    uint64_t codesBytes;    // Byte length of the code section
+    uint64_t indexOffset;   // Byte offset of the index section (0 if absent)
+    uint64_t indexBytes;    // Byte length of the index section (0 if absent)
+    uint64_t prefixOffset;  // Byte offset of the prefix section (0 if absent)
+    uint64_t prefixBytes;   // Byte length of the prefix section (0 if absent)
+    uint64_t zoneOffset;    // Byte offset of the zone section (0 if absent)
+    uint64_t zoneBytes;     // Byte length of the zone section (0 if absent)
+};
+
+struct DeltaSegmentHeader {
+    char magic[8];          // kDeltaMagic
+    uint32_t version;       // kEncodedVersion
+    uint32_t codeBits;      // Bits per code in the code section
+    uint64_t firstRow;      // Row id of the segment's first row (rows of the base and earlier segments)
+    uint64_t rows;          // Number of rows in the segment
+    uint64_t firstCode;     // Code of the segment's first new key (keys of the base and earlier segments)
+    uint64_t newKeys;       // Number of keys in the dictionary section
+    uint64_t dictOffset;    // Byte offset of the dictionary section
+    uint64_t dictBytes;     // Byte length of the dictionary section
+    uint64_t codesOffset;   // Byte offset of the code section
+    uint64_t codesBytes;    // Byte length of the code section
+};
+
+struct TableFileHeader {
+    char magic[8];          // kTableMagic
+    uint32_t version;       // kTableVersion
+    uint32_t columnCount;   // Number of columns (entries in the column directory)
+    uint64_t rows;          // Number of rows in every column
+    uint64_t namesOffset;   // Byte offset of the names section
+    uint64_t namesBytes;    // Byte length of the names section
+};
+
+struct TableColumnEntry {
+    uint64_t offset;        // Byte offset of the column's encoded file
+    uint64_t bytes;         // Byte length of the column's encoded file
+};
+
+// Column segments start on a page boundary, so each maps on its own
+constexpr uint64_t kTableSegmentAlignment = 4096;
+
+// Round value up to the next multiple of alignment (a power of two)
+inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// True if [offset, offset + bytes) lies within a file of size bytes (header values are untrusted, so the
+// sum is never formed)
+inline bool SectionFits(uint64_t offset, uint64_t bytes, uint64_t size) {
+    return bytes <= size && offset <= size - bytes;
+}
+
+#endif // ENCODED_FORMAT_H
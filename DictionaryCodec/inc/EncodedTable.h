@@ -0,0 +1,74 @@
+// EncodedTable.h: Multi-column table of dictionary-encoded columns with conjunctive predicates
+
+#ifndef ENCODED_TABLE_H
+#define ENCODED_TABLE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Codec.h"
+#include "SelectionVector.h"
+
+// One conjunct of a table query: column = value, or column LIKE 'value%'
+struct TablePredicate {
+    enum class Kind { Equal, Prefix };
+
+    std::string column;
+    Kind kind = Kind::Equal;
+    std::string value;
+};
+
+// A CSV file encoded column by column, each column with its own dictionary, into one table file
+// (see EncodedFormat.h). Queries are conjunctions: each predicate becomes a code set on its column,
+// the most selective one is scanned, and the rows that survive are probed in the other columns.
+class EncodedTable {
+public:
+    EncodedTable() = default;
+
+    // Columns are owned codecs, so a table can be moved but not copied
+    EncodedTable(const EncodedTable&) = delete;
+    EncodedTable& operator=(const EncodedTable&) = delete;
+    EncodedTable(EncodedTable&&) = default;
+    EncodedTable& operator=(EncodedTable&&) = default;
+
+    // Encode a CSV file (a header row of column names, then one row per line, fields split on commas,
+    // double-quoted fields may hold commas and "" quotes) into a table file, then load it.
+    // options apply to every column; streaming is not supported.
+    bool EncodeCsvFile(const std::string& inputFile, const std::string& outputFile,
+                       const EncodeOptions& options = EncodeOptions());
+
+    // Map a table file, every column is scanned in place
+    bool LoadTableFile(const std::string& inputFile);
+
+    // Rows matching every predicate (all rows if there are none), in row order
+    SelectionVector Query(const std::vector<TablePredicate>& predicates) const;
+
+    // Baseline query for performance comparison: every row's values compared as strings
+    SelectionVector BaselineQuery(const std::vector<TablePredicate>& predicates) const;
+
+    // Index of the column named name, or GetColumnCount() if there is none
+    size_t ColumnIndex(std::string_view name) const;
+
+    // Value of a row in a column
+    std::string_view GetValue(size_t row, size_t column) const { return columns_[column]->GetData(row); }
+
+    size_t GetRowCount() const { return rows_; }
+    size_t GetColumnCount() const { return columns_.size(); }
+    const std::string& GetColumnName(size_t column) const { return names_[column]; }
+    const DictionaryCodec& Column(size_t column) const { return *columns_[column]; }
+
+private:
+    // Helper to split a CSV line into fields, returns false on an unterminated quote
+    static bool SplitCsvLine(const std::string& line, std::vector<std::string>& fields);
+
+    // Helper to drop every column
+    void Clear();
+
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<DictionaryCodec>> columns_;
+    size_t rows_ = 0;
+};
+
+#endif // ENCODED_TABLE_H
@@ -0,0 +1,61 @@
+// Epoch.h: Epoch-based reclamation, so readers can use published data without locks or shared counters
+
+#ifndef EPOCH_H
+#define EPOCH_H
+
+#include <atomic>
+#include <cstdint>
+
+// Readers pin the current epoch in a slot of their own (one cache line per thread, so pinning never
+// writes a line another core reads on its hot path); writers publish new data, retire the old data at
+// the epoch Advance returns and free it once Quiescent says no reader pinned before then is left.
+class EpochManager {
+public:
+    // Pins the calling thread from construction to destruction. Guards nest, only the outermost one
+    // pins, so a pinned call may make other pinned calls.
+    class Guard {
+    public:
+        Guard();
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // Manager shared by every codec
+    static EpochManager& Shared();
+
+    // Start a new epoch and return it. Data unpublished before the call is unreachable for readers
+    // pinned at this epoch or later.
+    uint64_t Advance();
+
+    // True if no thread is still pinned at an epoch before epoch
+    bool Quiescent(uint64_t epoch) const;
+
+    // Wait until Quiescent(epoch)
+    void Synchronize(uint64_t epoch) const;
+
+private:
+    // A thread's pin: the epoch it is pinned at, 0 while it is not in a guard
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};
+        std::atomic<bool> inUse{false};  // Owned by a live thread
+        Slot* next = nullptr;            // Slots form a list that only grows
+    };
+
+    // A thread's slot and guard depth
+    struct ThreadState;
+
+    EpochManager() = default;
+
+    // Claim a free slot for the calling thread, or add one
+    Slot* AcquireSlot();
+
+    // The calling thread's state, claiming a slot on first use
+    static ThreadState& LocalState();
+
+    std::atomic<uint64_t> epoch_{1};
+    std::atomic<Slot*> slots_{nullptr};
+};
+
+#endif // EPOCH_H
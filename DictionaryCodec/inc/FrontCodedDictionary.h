@@ -0,0 +1,86 @@
+// FrontCodedDictionary.h: Sorted, front-coded dictionary for point and prefix lookups
+
+#ifndef FRONT_CODED_DICTIONARY_H
+#define FRONT_CODED_DICTIONARY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "StringArena.h"
+
+// Serialized layout (the same bytes are used in memory and in the encoded file):
+//   uint64_t count                         number of keys
+//   uint64_t blockCount
+//   uint64_t identity                      1 if codes follow key order (no code array)
+//   uint64_t blockOffsets[blockCount + 1]  byte offset of each block inside the block area
+//   uint32_t codes[count]                  code of the key at each sorted position, padded to 8 bytes
+//                                          (absent when identity)
+//   block area
+// Keys are sorted and cut into blocks of kBlockKeys. A block stores its first key whole (varint length,
+// bytes) and every further key as the length it shares with the key before it, then the rest
+// (varint shared, varint suffix length, suffix bytes). Lookups binary search the block heads and walk
+// one block, so neither needs a hash table and prefix matches come out as one sorted range.
+class FrontCodedDictionary {
+public:
+    // Keys per front-coded block
+    static constexpr size_t kBlockKeys = 16;
+
+    // Find result for a key that is not in the dictionary
+    static constexpr size_t kNotFound = ~size_t(0);
+
+    FrontCodedDictionary() = default;
+
+    // Owned storage moves with the dictionary, so only moves are allowed
+    FrontCodedDictionary(const FrontCodedDictionary&) = delete;
+    FrontCodedDictionary& operator=(const FrontCodedDictionary&) = delete;
+    FrontCodedDictionary(FrontCodedDictionary&&) = default;
+    FrontCodedDictionary& operator=(FrontCodedDictionary&&) = default;
+
+    // Build from the dictionary keys (keys.Get(c) is the key of code c). codesSorted says codes already
+    // follow key order, so no code array is stored.
+    void Build(const StringArena& keys, bool codesSorted);
+
+    // Point the dictionary at serialized bytes (e.g. a mapped file), returns false if they are malformed
+    bool Attach(const void* data, size_t bytes);
+
+    // Drop the dictionary
+    void Clear();
+
+    // Code of key, or kNotFound
+    size_t Find(std::string_view key) const;
+
+    // Sorted positions [lo, hi) of the keys starting with prefix
+    std::pair<size_t, size_t> PrefixRange(std::string_view prefix) const;
+
+    // Sorted position of the first key above key (afterKey) or not below it
+    size_t Rank(std::string_view key, bool afterKey) const;
+
+    // Code of the key at a sorted position
+    size_t CodeAt(size_t position) const { return codes_ ? codes_[position] : position; }
+
+    size_t Size() const { return count_; }
+    bool Empty() const { return data_ == nullptr; }
+    const uint8_t* Data() const { return data_; }
+    size_t Bytes() const { return bytes_; }
+
+private:
+    // Sorted position of the first key not below key; *exact tells whether that key equals key
+    size_t LowerBound(std::string_view key, bool* exact) const;
+
+    // First key of a block
+    std::string_view BlockHead(size_t block) const;
+
+    std::vector<uint64_t> owned_;         // Storage when built in memory
+    const uint8_t* data_ = nullptr;       // Serialized dictionary, owned_ or an external buffer
+    size_t bytes_ = 0;
+    size_t count_ = 0;
+    size_t blockCount_ = 0;
+    const uint64_t* blockOffsets_ = nullptr;
+    const uint32_t* codes_ = nullptr;     // nullptr when codes follow key order
+    const uint8_t* blocks_ = nullptr;
+    size_t blockBytes_ = 0;
+};
+
+#endif // FRONT_CODED_DICTIONARY_H
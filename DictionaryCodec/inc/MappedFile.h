@@ -0,0 +1,44 @@
+// MappedFile.h: Read-only memory mapping of a file, or of a range of one
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    // Mappings are owned, so they can be moved but not copied
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map the file read-only into memory, returns false if it cannot be opened or mapped
+    bool Open(const std::string& path);
+
+    // Map bytes [offset, offset + length) of the file, returns false if the file is shorter. Data()
+    // points at offset, which keeps its alignment within a page.
+    bool Open(const std::string& path, size_t offset, size_t length);
+
+    // Unmap the file (safe to call on a closed mapping)
+    void Close();
+
+    // Hint the kernel that [offset, offset + length) will be read sequentially
+    void AdviseSequential(size_t offset, size_t length) const;
+
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool IsOpen() const { return data_ != nullptr; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    char* mapping_ = nullptr;   // Page-aligned start of the mapping
+    size_t mappingSize_ = 0;
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,63 @@
+// PostingIndex.h: Inverted index from each code to a compressed list of the rows holding it
+
+#ifndef POSTING_INDEX_H
+#define POSTING_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CodeColumn.h"
+#include "SelectionVector.h"
+
+// Serialized layout (the same bytes are used in memory and in the encoded file):
+//   uint64_t codeSpace
+//   uint64_t offsets[codeSpace + 1]   byte offset of each list inside the block area
+//   uint32_t counts[codeSpace]        rows per code, padded to 8 bytes
+//   block area
+// A list is a run of blocks of up to kBlockRows rows: uint32_t firstRow, uint32_t bits, then the
+// remaining rows as (delta - 1) values bit-packed at bits per value into uint32_t words.
+class PostingIndex {
+public:
+    // Rows per compressed block
+    static constexpr size_t kBlockRows = 128;
+
+    PostingIndex() = default;
+
+    // Owned storage moves with the index, so only moves are allowed
+    PostingIndex(const PostingIndex&) = delete;
+    PostingIndex& operator=(const PostingIndex&) = delete;
+    PostingIndex(PostingIndex&&) = default;
+    PostingIndex& operator=(PostingIndex&&) = default;
+
+    // Build the index for codes 0 .. codeSpace - 1 from an encoded column
+    void Build(const CodeColumn& column, size_t codeSpace);
+
+    // Point the index at serialized bytes (e.g. a mapped file), returns false if they are malformed
+    bool Attach(const void* data, size_t bytes);
+
+    // Drop the index
+    void Clear();
+
+    // Number of rows holding code
+    size_t Count(size_t code) const;
+
+    // Append the rows holding code in ascending order
+    void Decode(size_t code, SelectionVector& results) const;
+
+    bool Empty() const { return data_ == nullptr; }
+    size_t CodeSpace() const { return codeSpace_; }
+    const uint8_t* Data() const { return data_; }
+    size_t Bytes() const { return bytes_; }
+
+private:
+    std::vector<uint64_t> owned_;    // Storage when built in memory
+    const uint8_t* data_ = nullptr;  // Serialized index, owned_ or an external buffer
+    size_t bytes_ = 0;
+    size_t codeSpace_ = 0;
+    const uint64_t* offsets_ = nullptr;
+    const uint32_t* counts_ = nullptr;
+    const uint8_t* blocks_ = nullptr;
+    size_t blockBytes_ = 0;
+};
+
+#endif // POSTING_INDEX_H
@@ -0,0 +1,86 @@
+// QueryClient.h: Client of the query server, with pipelined and blocking calls
+
+#ifndef QUERY_CLIENT_H
+#define QUERY_CLIENT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "QueryProtocol.h"
+#include "SelectionVector.h"
+
+// One served column, as listed by the server
+struct ServedColumn {
+    std::string name;
+    uint64_t rows = 0;
+};
+
+// A decoded response frame
+struct QueryResponse {
+    uint32_t requestId = 0;
+    uint16_t op = 0;
+    uint16_t status = kStatusOk;
+    std::vector<uint32_t> counts;          // Row count per key (one for kOpItem and kOpPrefix)
+    std::vector<SelectionVector> results;  // Rows per key, empty if the request was count-only
+    std::vector<ServedColumn> columns;     // kOpColumns only
+    std::string error;                     // Message of a failed request
+};
+
+// Pipelining: Send* queue requests in a buffer and return their ids, Flush writes them all in one go,
+// and Receive reads the responses back in request order. The blocking calls do all three for a single
+// request, so they must not be mixed with requests still in flight.
+class QueryClient {
+public:
+    QueryClient() = default;
+    ~QueryClient();
+
+    // The connection is owned, so a client can be neither copied nor moved
+    QueryClient(const QueryClient&) = delete;
+    QueryClient& operator=(const QueryClient&) = delete;
+
+    // Connect to a server's socket
+    bool Connect(const std::string& socketPath);
+
+    // Close the connection (safe to call when not connected)
+    void Close();
+
+    // Queue requests, returning their ids (count-only requests return row counts without rows)
+    uint32_t SendColumns();
+    uint32_t SendItem(uint16_t column, std::string_view key, bool countOnly = false);
+    uint32_t SendPrefix(uint16_t column, std::string_view prefix, bool countOnly = false);
+    uint32_t SendBatch(uint16_t column, const std::vector<std::string>& keys, bool countOnly = false);
+
+    // Write every queued request, false if the server has gone
+    bool Flush();
+
+    // Read the next response, false if the connection failed or the frame was malformed
+    bool Receive(QueryResponse& response);
+
+    // Blocking calls, false on a connection failure or an error response (reported on std::cerr)
+    bool Columns(std::vector<ServedColumn>& columns);
+    bool QueryItem(uint16_t column, std::string_view key, SelectionVector& rows);
+    bool QueryPrefix(uint16_t column, std::string_view prefix, SelectionVector& rows);
+    bool QueryBatch(uint16_t column, const std::vector<std::string>& keys, std::vector<SelectionVector>& results);
+
+    bool IsConnected() const { return fd_ >= 0; }
+
+private:
+    // Helper to queue a request header, returning its id
+    uint32_t QueueHeader(uint16_t op, uint16_t column, uint16_t flags, size_t payloadBytes);
+
+    // Helper to read until at least bytes are buffered
+    bool Fill(size_t bytes);
+
+    // Helper to send one request and wait for its response
+    bool Roundtrip(uint32_t requestId, QueryResponse& response);
+
+    int fd_ = -1;
+    uint32_t nextRequestId_ = 0;
+    std::string out_;     // Queued requests
+    std::string in_;      // Received bytes from inPos_ on are not yet decoded
+    size_t inPos_ = 0;
+};
+
+#endif // QUERY_CLIENT_H
@@ -0,0 +1,53 @@
+// QueryProtocol.h: Wire format of the query server's Unix domain socket protocol
+//
+// Both directions carry frames (all integers little-endian):
+//   [FrameHeader] then payloadBytes bytes of payload
+// Requests are pipelined: a client may send any number of requests before reading a response. The
+// server answers a connection's requests in the order they arrived and echoes each requestId.
+//
+// Request payloads:
+//   kOpColumns           empty
+//   kOpItem              the key bytes
+//   kOpPrefix            the prefix bytes
+//   kOpBatch             uint32_t keyCount, then per key a uint32_t length and the key bytes
+// Response payloads (status kStatusOk):
+//   kOpColumns           uint32_t columnCount, then per column uint64_t rows, a uint32_t name length
+//                        and the name bytes
+//   kOpItem, kOpPrefix   uint32_t rowCount, then uint32_t rows[rowCount] in ascending order (rows are
+//                        left out if the request set kRequestCountOnly)
+//   kOpBatch             one result laid out as for kOpItem per key, in request order
+// Any other status carries an error message as its payload.
+
+#ifndef QUERY_PROTOCOL_H
+#define QUERY_PROTOCOL_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Request operations
+constexpr uint16_t kOpColumns = 0;  // Names and row counts of the served columns
+constexpr uint16_t kOpItem = 1;     // Rows equal to a key
+constexpr uint16_t kOpPrefix = 2;   // Rows starting with a prefix
+constexpr uint16_t kOpBatch = 3;    // Rows equal to each of several keys
+
+// Request flags
+constexpr uint16_t kRequestCountOnly = 1u << 0;  // Answer with row counts, no row ids
+
+// Response status
+constexpr uint16_t kStatusOk = 0;
+constexpr uint16_t kStatusBadRequest = 1;  // Unknown op or column, or a malformed payload
+constexpr uint16_t kStatusTooLarge = 2;    // Result does not fit in one frame
+
+// Largest request payload the server reads; a larger frame closes the connection
+constexpr uint32_t kMaxRequestBytes = 16u << 20;
+
+struct FrameHeader {
+    uint32_t payloadBytes;  // Bytes of payload after the header
+    uint32_t requestId;     // Chosen by the client, echoed in the response
+    uint16_t op;            // kOp* (responses echo the request's)
+    uint16_t flags;         // kRequest* bits (responses echo the request's)
+    uint16_t column;        // Index of the column queried, in kOpColumns order (0 in responses)
+    uint16_t status;        // kStatus* (0 in requests)
+};
+
+#endif // QUERY_PROTOCOL_H
@@ -0,0 +1,71 @@
+// QueryServer.h: Long-lived server answering queries on loaded columns over a Unix domain socket
+
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Codec.h"
+#include "QueryProtocol.h"
+
+// Encoded columns are loaded once and queried by any number of clients (see QueryProtocol.h). Each
+// connection is served by its own thread: it answers every complete request it has read, then writes
+// all their responses at once, so pipelined requests cost one read and one write per burst. Queries
+// still spread over the codec's shared thread pool.
+class QueryServer {
+public:
+    QueryServer() = default;
+
+    // Stops serving and waits for the connection threads
+    ~QueryServer();
+
+    // Connections refer to the server, so it can be neither copied nor moved
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    // Load an encoded file (with its delta segments) and serve it as column name. Columns are
+    // numbered in the order they are added; add them all before Serve.
+    bool AddColumn(const std::string& name, const std::string& encodedFile);
+
+    // Bind and listen on a socket path, replacing a stale socket left by an earlier server
+    bool Listen(const std::string& socketPath);
+
+    // Accept connections until Stop, then close them and remove the socket file
+    void Serve();
+
+    // Make Serve return; safe to call from any thread
+    void Stop();
+
+    size_t GetColumnCount() const { return columns_.size(); }
+
+private:
+    struct Connection {
+        int fd;
+        std::thread thread;
+        std::atomic<bool> finished{false};
+    };
+
+    // Serve one client until it disconnects or the server stops
+    void HandleConnection(Connection& connection);
+
+    // Append the response to one request to out
+    void HandleRequest(const FrameHeader& request, const char* payload, std::string& out);
+
+    // Join and drop the connections whose client has gone
+    void ReapConnections();
+
+    std::vector<std::string> names_;
+    std::vector<std::unique_ptr<DictionaryCodec>> columns_;
+    std::string socketPath_;
+    int listenFd_ = -1;
+    std::atomic<bool> stopping_{false};
+    std::mutex connectionsMutex_;           // Guards connections_ against Stop
+    std::list<Connection> connections_;     // List, so a connection never moves while its thread runs
+};
+
+#endif // QUERY_SERVER_H
@@ -0,0 +1,177 @@
+// QueryStats.h: Optional per-query execution statistics and hardware counters
+
+#ifndef QUERY_STATS_H
+#define QUERY_STATS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Work a query does, counted by the codec on whichever thread does it
+enum class QueryCounter {
+    KeysProbed,         // Dictionary keys compared or hashed to resolve the query's values
+    RowsScanned,        // Codes read from the column, by scans, gathers, counts and decodes
+    BytesScanned,       // Code section bytes those rows occupy
+    MorselsSkipped,     // Morsels the zone map ruled out without reading them
+    IndexRows,          // Row ids decoded from posting lists
+    ResultAllocations,  // Result buffers allocated, every growth of a selection included
+    Count
+};
+
+// Counters read with perf_event_open, for the query's own threads only (user space)
+enum class HardwareCounter {
+    Instructions,
+    Cycles,
+    CacheMisses,   // Last-level cache misses
+    BranchMisses,
+    TaskClock,     // Nanoseconds on a CPU (software counter, available where the hardware ones are not)
+    PageFaults,    // Software counter
+    Count
+};
+
+constexpr size_t kQueryCounters = static_cast<size_t>(QueryCounter::Count);
+constexpr size_t kHardwareCounters = static_cast<size_t>(HardwareCounter::Count);
+
+// Counter names as they appear in the records
+const char* QueryCounterName(QueryCounter counter);
+const char* HardwareCounterName(HardwareCounter counter);
+
+// Hardware counter values; a counter the kernel does not permit is left out of available
+struct HardwareCounts {
+    uint64_t values[kHardwareCounters] = {};
+    uint32_t available = 0;  // Bit i set if values[i] was counted
+
+    bool Has(HardwareCounter counter) const { return (available >> static_cast<size_t>(counter)) & 1; }
+};
+
+// Time and hardware counters of one phase of a query (dictionary lookup, scan, merge, ...)
+struct PhaseStats {
+    const char* name = "";
+    double seconds = 0;
+    HardwareCounts hardware;
+};
+
+// One query's record
+struct QueryStats {
+    std::string query;                       // Codec API called
+    double seconds = 0;                      // Wall time
+    uint64_t counters[kQueryCounters] = {};  // Indexed by QueryCounter
+    uint64_t matches = 0;                    // Rows returned (groups for aggregations, codes for code sets)
+    HardwareCounts hardware;                 // Summed over the calling thread and the pool threads
+    std::vector<PhaseStats> phases;          // In execution order, times sum to about seconds
+
+    uint64_t Get(QueryCounter counter) const { return counters[static_cast<size_t>(counter)]; }
+
+    // The record as one line of JSON
+    std::string ToJson() const;
+};
+
+// Records every codec query the constructing thread runs while the profiler is alive, including the
+// work those queries hand to the thread pool. Without a profiler a query pays one thread-local check.
+// Profilers nest: an inner one records until it ends, then the outer one resumes.
+class QueryProfiler {
+public:
+    // hardwareCounters also opens perf_event counters on every thread that works on a query
+    explicit QueryProfiler(bool hardwareCounters = true);
+    ~QueryProfiler();
+
+    // A profiler is tied to its thread, so it can be neither copied nor moved
+    QueryProfiler(const QueryProfiler&) = delete;
+    QueryProfiler& operator=(const QueryProfiler&) = delete;
+
+    const std::vector<QueryStats>& Records() const { return records_; }
+    void Clear() { records_.clear(); }
+
+    // Write every record as one line of JSON
+    void WriteJsonLines(std::ostream& out) const;
+
+    // Hardware counters the kernel lets the calling thread open
+    static HardwareCounts AvailableCounters();
+
+private:
+    friend class QueryTrace;
+
+    QueryProfiler* previous_;
+    bool hardwareCounters_;
+    std::vector<QueryStats> records_;
+
+    inline static thread_local QueryProfiler* current_ = nullptr;
+};
+
+// Instrumentation inside the codec: a public query opens a trace, names its phases and counts its work.
+// Only the outermost query of a thread with a profiler records; every other call is a no-op.
+class QueryTrace {
+public:
+    QueryTrace(const char* query, const char* firstPhase) {
+        if (QueryProfiler::current_ != nullptr && active_ == nullptr) Begin(query, firstPhase);
+    }
+    ~QueryTrace() {
+        if (active_ == this) End();
+    }
+
+    QueryTrace(const QueryTrace&) = delete;
+    QueryTrace& operator=(const QueryTrace&) = delete;
+
+    // Trace the calling thread records into, or nullptr
+    static QueryTrace* Active() { return active_; }
+
+    // Count work of the active trace (safe from pool threads running its tasks)
+    static void Add(QueryCounter counter, uint64_t n) {
+        if (active_ != nullptr) active_->counters_[static_cast<size_t>(counter)].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    // End the current phase of the active trace and start the next one
+    static void Phase(const char* name) {
+        if (active_ != nullptr && active_->owner_) active_->NextPhase(name);
+    }
+
+    // Record the size of the query's result and hand the result back
+    template <typename Result>
+    Result Finish(Result result) {
+        SetMatches(result.size());
+        return result;
+    }
+    void SetMatches(uint64_t matches) { matches_ = matches; }
+
+    // Makes a pool thread record into trace while it runs one of the trace's tasks, adding its
+    // hardware counters to the phase the task runs in (a no-op on the query's own thread)
+    class TaskScope {
+    public:
+        explicit TaskScope(QueryTrace* trace);
+        ~TaskScope();
+
+        TaskScope(const TaskScope&) = delete;
+        TaskScope& operator=(const TaskScope&) = delete;
+
+    private:
+        QueryTrace* trace_;
+        QueryTrace* previous_;
+        HardwareCounts start_;
+    };
+
+private:
+    static constexpr size_t kMaxPhases = 32;
+
+    void Begin(const char* query, const char* firstPhase);
+    void End();
+    void NextPhase(const char* name);
+
+    QueryProfiler* profiler_ = nullptr;
+    bool owner_ = false;                       // Set on the trace the query's own thread opened
+    std::chrono::steady_clock::time_point start_;
+    std::chrono::steady_clock::time_point phaseStart_;
+    HardwareCounts phaseHardware_;             // The query thread's counters when the phase began
+    QueryStats stats_;
+    uint64_t matches_ = 0;
+    std::atomic<uint64_t> counters_[kQueryCounters] = {};
+    std::atomic<size_t> phase_{0};
+    std::atomic<uint64_t> taskHardware_[kMaxPhases][kHardwareCounters] = {};  // Pool threads, per phase
+
+    inline static thread_local QueryTrace* active_ = nullptr;
+};
+
+#endif // QUERY_STATS_H
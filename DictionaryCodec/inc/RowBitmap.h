@@ -0,0 +1,59 @@
+// RowBitmap.h: Compressed (roaring-style) set of row ids for combining query results
+
+#ifndef ROW_BITMAP_H
+#define ROW_BITMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "SelectionVector.h"
+
+// Rows are split into 2^16-row chunks. A chunk with few rows keeps them as a sorted array of
+// 16-bit offsets; a dense chunk switches to a 65536-bit bitmap. And/Or work chunk by chunk,
+// so results can be combined without expanding them back into row ids.
+class RowBitmap {
+public:
+    // Chunks with more rows than this are stored as bitmaps (the point where the array outgrows 8 KB)
+    static constexpr size_t kArrayLimit = 4096;
+
+    RowBitmap() = default;
+
+    // Build from an ascending selection
+    static RowBitmap FromSelection(const SelectionVector& selection);
+
+    // Expand back into an ascending selection
+    SelectionVector ToSelection() const;
+
+    // Rows present in both bitmaps
+    RowBitmap And(const RowBitmap& other) const;
+
+    // Rows present in either bitmap
+    RowBitmap Or(const RowBitmap& other) const;
+
+    bool Contains(uint32_t row) const;
+    size_t Cardinality() const;
+    bool Empty() const { return chunks_.empty(); }
+
+    // Bytes held by the containers
+    size_t MemoryBytes() const;
+
+private:
+    struct Chunk {
+        uint32_t key = 0;                // Row >> 16
+        uint32_t cardinality = 0;        // Rows in the chunk
+        std::vector<uint16_t> array;     // Sorted offsets, used while cardinality <= kArrayLimit
+        std::vector<uint64_t> bits;      // 1024-word bitmap otherwise
+
+        bool IsBitmap() const { return !bits.empty(); }
+        bool Contains(uint16_t offset) const;
+        void ToBitmap();                 // Switch from array to bitmap storage
+        void Normalize();                // Pick the cheaper storage for the cardinality
+    };
+
+    static Chunk AndChunks(const Chunk& a, const Chunk& b);
+    static Chunk OrChunks(const Chunk& a, const Chunk& b);
+
+    std::vector<Chunk> chunks_;          // Non-empty chunks in ascending key order
+};
+
+#endif // ROW_BITMAP_H
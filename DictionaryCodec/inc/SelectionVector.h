@@ -0,0 +1,84 @@
+// SelectionVector.h: Query result as an ascending list of 32-bit row ids
+
+#ifndef SELECTION_VECTOR_H
+#define SELECTION_VECTOR_H
+
+#include "QueryStats.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Allocator that default-initializes on resize, so growing the buffer never zero-fills it
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind { using other = DefaultInitAllocator<U>; };
+
+    DefaultInitAllocator() = default;
+    template <typename U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept {}
+
+    // Every buffer a result grows into counts toward the active query's allocations
+    T* allocate(size_t n) {
+        QueryTrace::Add(QueryCounter::ResultAllocations, 1);
+        return std::allocator<T>::allocate(n);
+    }
+
+    template <typename U>
+    void construct(U* p) noexcept { ::new (static_cast<void*>(p)) U; }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) { ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...); }
+};
+
+// Largest row count a selection can address. Query results are ascending 32-bit row ids, so a column
+// holds at most this many rows.
+constexpr size_t kMaxSelectableRows = UINT32_MAX;
+
+class SelectionVector {
+public:
+    using Storage = std::vector<uint32_t, DefaultInitAllocator<uint32_t>>;
+
+    SelectionVector() = default;
+    explicit SelectionVector(Storage rows) : rows_(std::move(rows)) {}
+
+    // Container access, rows are in ascending order
+    size_t size() const { return rows_.size(); }
+    bool empty() const { return rows_.empty(); }
+    uint32_t operator[](size_t i) const { return rows_[i]; }
+    const uint32_t* data() const { return rows_.data(); }
+    Storage::const_iterator begin() const { return rows_.begin(); }
+    Storage::const_iterator end() const { return rows_.end(); }
+    void reserve(size_t n) { rows_.reserve(n); }
+    void clear() { rows_.clear(); }
+    void push_back(uint32_t row) { rows_.push_back(row); }
+    void resize(size_t n) { rows_.resize(n); }
+
+    // Grow by n uninitialized rows and return where they start, so a kernel can write row ids
+    // in place; resize back to the count actually written
+    uint32_t* Extend(size_t n) {
+        size_t size = rows_.size();
+        rows_.resize(size + n);
+        return rows_.data() + size;
+    }
+
+    // Append base + i for every set bit i of mask (SIMD compaction for the CPU's instruction set).
+    // Scan kernels call this once per block of up to 64 rows.
+    void AppendMask(uint64_t mask, uint32_t base) {
+        if (mask != 0) AppendMaskCompact(mask, base);
+    }
+
+    // Rows present in both selections
+    SelectionVector Intersect(const SelectionVector& other) const;
+
+    // Rows present in either selection
+    SelectionVector Union(const SelectionVector& other) const;
+
+private:
+    void AppendMaskCompact(uint64_t mask, uint32_t base);
+
+    Storage rows_;
+};
+
+#endif // SELECTION_VECTOR_H
@@ -0,0 +1,94 @@
+// SimdKernels.h: Scan, prefix and byte search kernels built for several instruction sets, picked once at startup
+
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Instruction set levels, each one implies the ones below it
+enum class SimdLevel { Scalar, SSE42, AVX2, AVX512 };
+
+// Kernels write matching row ids (base + i) to out and return how many they wrote. They may store up
+// to kKernelSlack entries past the last match, so out needs room for n + kKernelSlack rows.
+constexpr size_t kKernelSlack = 16;
+
+// Rows of codes[0, n) with lo <= code <= hi
+using RangeKernel = size_t (*)(const void* codes, size_t n, uint32_t base, uint64_t lo, uint64_t hi, uint32_t* out);
+
+// Rows of codes[0, n) whose code equals one of keys[0, count), count <= kMaxSmallSetKeys
+using SmallSetKernel = size_t (*)(const void* codes, size_t n, uint32_t base, const uint64_t* keys, size_t count,
+                                  uint32_t* out);
+
+// Rows of codes[0, n) whose bit is set in a membership bitmap of 32-bit words
+using BitmapKernel = size_t (*)(const void* codes, size_t n, uint32_t base, const uint32_t* bitmap, uint32_t* out);
+
+// Rows base + i for every set bit i of mask
+using CompactKernel = size_t (*)(uint64_t mask, uint32_t base, uint32_t* out);
+
+// True if the first len bytes of key and prefix are equal (both must hold at least len bytes)
+using PrefixKernel = bool (*)(const char* key, const char* prefix, size_t len);
+
+// Number of bytes of data[0, n) equal to byte
+using ByteCountKernel = size_t (*)(const char* data, size_t n, char byte);
+
+// Offsets base + i of the bytes of data[0, n) equal to byte, in order; writes exactly as many as it
+// returns, so out needs room for the count ByteCountKernel gives (or n)
+using ByteFindKernel = size_t (*)(const char* data, size_t n, char byte, uint32_t base, uint32_t* out);
+
+// Most keys a small-set kernel compares against
+constexpr size_t kMaxSmallSetKeys = 4;
+
+// One kernel set. Code kernels are indexed by lane width: 0 = 8, 1 = 16, 2 = 32, 3 = 64 bits.
+struct ScanKernels {
+    SimdLevel level = SimdLevel::Scalar;
+    const char* name = "scalar";
+    RangeKernel range[4] = {};
+    SmallSetKernel smallSet[4] = {};
+    BitmapKernel bitmap[4] = {};
+    CompactKernel compact = nullptr;
+    PrefixKernel startsWith = nullptr;
+    ByteCountKernel countByte = nullptr;
+    ByteFindKernel findByte = nullptr;
+};
+
+// Kernel slot of a byte-aligned code width
+inline size_t LaneIndex(unsigned bitWidth) {
+    return bitWidth == 8 ? 0 : bitWidth == 16 ? 1 : bitWidth == 32 ? 2 : 3;
+}
+
+// Best level this CPU (and OS) supports
+SimdLevel DetectSimdLevel();
+
+// Name of a level, as accepted by the DICTCODEC_SIMD environment variable
+const char* SimdLevelName(SimdLevel level);
+
+// Kernels for a level: each level starts from the one below and replaces what it speeds up
+ScanKernels MakeScanKernels(SimdLevel level);
+
+// Kernels chosen on first use: the detected level, capped by DICTCODEC_SIMD (scalar, sse4.2, avx2, avx512)
+const ScanKernels& ActiveKernels();
+
+// Per-level kernel installers, each compiled for its own instruction set
+void AddSSE42Kernels(ScanKernels& kernels);
+void AddAVX2Kernels(ScanKernels& kernels);
+void AddAVX512Kernels(ScanKernels& kernels);
+
+// For every 8-bit mask, the lane offsets of its set bits packed to the front
+struct CompactTable {
+    alignas(32) uint32_t lanes[256][8];
+
+    constexpr CompactTable() : lanes() {
+        for (unsigned mask = 0; mask < 256; ++mask) {
+            unsigned n = 0;
+            for (unsigned bit = 0; bit < 8; ++bit) {
+                if (mask & (1u << bit)) lanes[mask][n++] = bit;
+            }
+        }
+    }
+};
+
+// Shared by the table-driven compaction of the SSE4.2 and AVX2 kernels
+extern const CompactTable kCompactTable;
+
+#endif // SIMD_KERNELS_H
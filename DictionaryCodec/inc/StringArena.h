@@ -0,0 +1,55 @@
+// StringArena.h: Dictionary keys stored back to back in one buffer, indexed by code
+
+#ifndef STRING_ARENA_H
+#define STRING_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// String i is bytes [offsets[i], offsets[i + 1]). This is the layout of the encoded file's dictionary
+// section, so a loaded dictionary points straight into the mapping instead of copying every key.
+class StringArena {
+public:
+    StringArena() { Clear(); }
+
+    // Owned storage moves with the arena, so only moves are allowed
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    // Drop every string, leaving owned storage with room for count strings of bytes in total
+    void Reset(size_t count, size_t bytes);
+
+    // Append a copy of key to owned storage, returns its index.
+    // Views returned by Get are invalidated, the buffer may move.
+    size_t Add(std::string_view key);
+
+    // Point the arena at count + 1 offsets and the bytes they index (e.g. a mapped dictionary section),
+    // returns false if the offsets are not ascending or run past bytesLen
+    bool Attach(const uint64_t* offsets, size_t count, const char* bytes, size_t bytesLen);
+
+    // Drop every string (and any owned storage)
+    void Clear();
+
+    // String at an index
+    std::string_view Get(size_t index) const {
+        return std::string_view(bytes_ + offsets_[index], offsets_[index + 1] - offsets_[index]);
+    }
+
+    size_t Size() const { return count_; }
+    const uint64_t* Offsets() const { return offsets_; } // Size() + 1 entries
+    const char* Bytes() const { return bytes_; }
+    size_t BytesSize() const { return offsets_[count_]; }
+
+private:
+    std::vector<uint64_t> ownedOffsets_; // Offsets when built in memory
+    std::vector<char> ownedBytes_;       // String bytes when built in memory
+    const uint64_t* offsets_ = nullptr;  // ownedOffsets_ or an external buffer
+    const char* bytes_ = nullptr;        // ownedBytes_ or an external buffer
+    size_t count_ = 0;                   // Number of strings
+};
+
+#endif // STRING_ARENA_H
@@ -0,0 +1,64 @@
+// ThreadPool.h: Persistent worker threads that run indexed tasks for parallel loops
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Workers are started once and sleep between loops, so a parallel loop costs a wake-up rather than
+// a thread spawn. The calling thread always takes part in its own loop, which keeps nested loops and
+// pools without workers (one hardware thread) from blocking.
+class ThreadPool {
+public:
+    // Pool running loops on numThreads threads, the caller included (0 = hardware_concurrency)
+    explicit ThreadPool(unsigned int numThreads = 0);
+    ~ThreadPool();
+
+    // Workers belong to the pool, so it can be neither copied nor moved
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by the codec, sized to the hardware
+    static ThreadPool& Shared();
+
+    // Run fn(i) for every i in [0, tasks) and wait for all of them. Tasks are claimed one at a time,
+    // so uneven tasks balance across threads. At most maxThreads threads work on the loop (0 = all).
+    void ParallelFor(size_t tasks, const std::function<void(size_t)>& fn, unsigned int maxThreads = 0);
+
+    // Threads a loop can run on, the caller included
+    unsigned int Size() const { return static_cast<unsigned int>(workers_.size()) + 1; }
+
+private:
+    struct Loop {
+        const std::function<void(size_t)>* fn;
+        size_t tasks;
+        size_t next = 0;         // Next unclaimed task
+        size_t finished = 0;     // Tasks completed
+        unsigned int helpers;    // Workers that may still join
+        unsigned int active = 0; // Workers inside the loop
+    };
+
+    // ParallelFor without the query trace hand-off
+    void RunLoop(size_t tasks, const std::function<void(size_t)>& fn, unsigned int maxThreads);
+
+    // Worker thread body: join queued loops until the pool shuts down
+    void WorkerMain();
+
+    // Claim and run tasks of loop until none are left (called with mutex_ held)
+    void RunTasks(Loop& loop, std::unique_lock<std::mutex>& lock);
+
+    std::vector<std::thread> workers_;
+    std::deque<Loop*> queue_;          // Loops that still accept workers
+    std::mutex mutex_;
+    std::condition_variable wake_;     // Signals workers that a loop was queued
+    std::condition_variable done_;     // Signals callers that a loop may have finished
+    bool stopping_ = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,90 @@
+// ZoneMap.h: Per-zone code bounds and presence filters, so scans can skip zones that cannot match
+
+#ifndef ZONE_MAP_H
+#define ZONE_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "CodeColumn.h"
+#include "CodeSet.h"
+
+// Serialized layout (the same bytes are used in memory and in the encoded file):
+//   uint64_t rows
+//   uint64_t zoneCount                       zones of kZoneRows rows (the last one may be shorter)
+//   uint64_t filterBits                      bits in each zone's presence filter (a power of two)
+//   uint64_t exact                           1 if filter bit c stands for code c, 0 if codes are hashed
+//   uint64_t minCodes[zoneCount]             smallest code in each zone
+//   uint64_t maxCodes[zoneCount]             largest code in each zone
+//   uint32_t filters[zoneCount][filterBits / 32]
+// A code space that fits in kMaxFilterBits gets an exact presence bitmap per zone; a larger one sets two
+// hashed bits per code (a Bloom filter), so a clear bit still proves the code absent.
+class ZoneMap {
+public:
+    // Rows per zone (one scan morsel)
+    static constexpr size_t kZoneRows = size_t(1) << 16;
+
+    // Largest presence filter per zone, in bits
+    static constexpr size_t kMaxFilterBits = size_t(1) << 14;
+
+    ZoneMap() = default;
+
+    // Owned storage moves with the map, so only moves are allowed
+    ZoneMap(const ZoneMap&) = delete;
+    ZoneMap& operator=(const ZoneMap&) = delete;
+    ZoneMap(ZoneMap&&) = default;
+    ZoneMap& operator=(ZoneMap&&) = default;
+
+    // Bytes of the serialized map for rows codes out of codeSpace
+    static size_t BytesFor(size_t rows, size_t codeSpace);
+
+    // Build the map of an encoded column holding codes 0 .. codeSpace - 1
+    void Build(const CodeColumn& column, size_t codeSpace);
+
+    // Allocate an empty map for rows codes, to be filled with Fill
+    void Allocate(size_t rows, size_t codeSpace);
+
+    // Record the zones of codes, whose first row is firstRow (a multiple of kZoneRows)
+    void Fill(const CodeColumn& codes, size_t firstRow);
+
+    // Point the map at serialized bytes (e.g. a mapped file), returns false if they are malformed
+    bool Attach(const void* data, size_t bytes);
+
+    // Drop the map
+    void Clear();
+
+    // False if zone cannot hold code (zones past the map may hold anything)
+    bool MayContain(size_t zone, size_t code) const;
+
+    // False if zone cannot hold a code in [lo, hi)
+    bool MayOverlap(size_t zone, size_t lo, size_t hi) const;
+
+    // False if zone cannot hold any code of set
+    bool MayContainAny(size_t zone, const CodeSet& set) const;
+
+    size_t Rows() const { return rows_; }
+    size_t ZoneCount() const { return zoneCount_; }
+    bool Empty() const { return data_ == nullptr; }
+    const uint8_t* Data() const { return data_; }
+    size_t Bytes() const { return bytes_; }
+
+private:
+    // True if zone's exact filter has a bit set in codes [lo, last]
+    bool AnyInRange(size_t zone, size_t lo, size_t last) const;
+
+    // Filter words of a zone
+    const uint32_t* Filter(size_t zone) const { return filters_ + zone * (filterBits_ / 32); }
+
+    std::vector<uint64_t> owned_;         // Storage when built in memory
+    const uint8_t* data_ = nullptr;       // Serialized map, owned_ or an external buffer
+    size_t bytes_ = 0;
+    size_t rows_ = 0;
+    size_t zoneCount_ = 0;
+    size_t filterBits_ = 0;
+    bool exact_ = false;
+    const uint64_t* minCodes_ = nullptr;
+    const uint64_t* maxCodes_ = nullptr;
+    const uint32_t* filters_ = nullptr;
+};
+
+#endif // ZONE_MAP_H
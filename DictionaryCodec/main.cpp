@@ -1,9 +1,23 @@
 // Main.cpp
 #include "Codec.h"
+#include "EncodedTable.h"
+#include "QueryClient.h"
+#include "QueryServer.h"
+#include "QueryStats.h"
+#include "RowBitmap.h"
+#include "SimdKernels.h"
 #include <iostream>
-#include <string.h>  // strcmp
+#include <string.h>  // strcmp, strncmp
 #include <random>
 #include <chrono>
+#include <algorithm> // std::sort, std::unique
+#include <unordered_map>
+#include <fstream>
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <pthread.h> // pthread_sigmask, pthread_kill
+#include <signal.h>  // sigwait
 
 
 int main(int argc, char* argv[]) {
@@ -12,11 +26,27 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    // Kernels are picked from the CPU at startup, DICTCODEC_SIMD=scalar|sse4.2|avx2 can lower the level
+    std::cout << "SIMD kernels: " << ActiveKernels().name << std::endl;
+
     // Load from raw text file and save encoded data
     if (strcmp(argv[1], "write_encoding") == 0) {
         DictionaryCodec dict;
 
-        dict.EncodeColumnFile("src/Column.txt", "src/Output.txt");
+        // Optional arguments: "sorted" assigns codes in key order, "index" adds a posting index,
+        // "stream" encodes in bounded memory, "compress" block-compresses the codes
+        EncodeOptions options;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "sorted") == 0) options.sortedDictionary = true;
+            if (strcmp(argv[i], "index") == 0) options.buildPostingIndex = true;
+            if (strcmp(argv[i], "stream") == 0) options.streaming = true;
+            if (strcmp(argv[i], "compress") == 0) options.compressCodes = true;
+        }
+
+        if (!dict.EncodeColumnFile("src/Column.txt", "src/Output.txt", options)) {
+            std::cout << "Error: failed to write src/Output.txt" << std::endl;
+            return 1;
+        }
     }
 
     // Query tests demo
@@ -25,7 +55,9 @@ int main(int argc, char* argv[]) {
         DictionaryCodec dict;
 
         // Load the encoded file
-        dict.LoadEncodedFile("src/Output.txt");
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
 
         // Get the maximum index from the data size
         size_t maxIndex = dict.GetDataSize();
@@ -54,7 +86,7 @@ int main(int argc, char* argv[]) {
         auto startQuery = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> queryResults = dict.QueryItem(dict.GetData(randVals[i]));
+            SelectionVector queryResults = dict.QueryItem(dict.GetData(randVals[i]));
         }
 
         auto endQuery = std::chrono::high_resolution_clock::now();
@@ -65,18 +97,48 @@ int main(int argc, char* argv[]) {
         auto startQuerySIMD = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> queryResults = dict.SIMDQueryItem(dict.GetData(randVals[i]));
+            SelectionVector queryResults = dict.SIMDQueryItem(dict.GetData(randVals[i]));
         }
 
         auto endQuerySIMD = std::chrono::high_resolution_clock::now();
         std::chrono::duration<double> queryDurationSIMD = endQuerySIMD - startQuerySIMD;
         std::cout << "QueryItemSIMD execution time: " << queryDurationSIMD.count()/num_tests << " seconds" << std::endl;
 
+        // Timing QueryBatch: the same keys answered from one pass over the column
+        std::vector<std::string> batchKeys;
+        for (size_t i = 0; i < num_tests; i++) {
+            batchKeys.emplace_back(dict.GetData(randVals[i]));
+        }
+        auto startBatch = std::chrono::high_resolution_clock::now();
+        std::vector<SelectionVector> batchResults = dict.QueryBatch(batchKeys);
+        auto endBatch = std::chrono::high_resolution_clock::now();
+        size_t batchMismatches = 0;
+        for (size_t i = 0; i < 10; i++) {
+            batchMismatches += batchResults[i].size() != dict.SIMDQueryItem(batchKeys[i]).size();
+        }
+        std::chrono::duration<double> batchDuration = endBatch - startBatch;
+        std::cout << "QueryBatch of " << num_tests << " keys (" << batchMismatches << " mismatches): "
+                  << batchDuration.count() << " seconds" << std::endl;
+
+        // Late materialization: decode only the rows a query returned, every value must be the item
+        SelectionVector decodeRows = dict.SIMDQueryItem(dict.GetData(randVals[0]));
+        StringArena decoded;
+        auto startDecode = std::chrono::high_resolution_clock::now();
+        dict.Decode(decodeRows, decoded);
+        auto endDecode = std::chrono::high_resolution_clock::now();
+        size_t mismatches = 0;
+        for (size_t i = 0; i < decoded.Size(); i++) {
+            mismatches += decoded.Get(i) != dict.GetData(randVals[0]);
+        }
+        std::chrono::duration<double> decodeDuration = endDecode - startDecode;
+        std::cout << "Decode of " << decoded.Size() << " rows (" << mismatches << " mismatches): "
+                  << decodeDuration.count() << " seconds" << std::endl;
+
         // Timing the BaselineSearch operation
         auto startBaseline = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> baselineResults = dict.BaselineSearch(dict.GetData(randVals[i]));
+            SelectionVector baselineResults = dict.BaselineSearch(dict.GetData(randVals[i]));
         }
 
         auto endBaseline = std::chrono::high_resolution_clock::now();
@@ -90,7 +152,9 @@ int main(int argc, char* argv[]) {
         DictionaryCodec dict;
 
         // Load the encoded file
-        dict.LoadEncodedFile("src/Output.txt");
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
 
         // Get the maximum index from the data size
         size_t maxIndex = dict.GetDataSize();
@@ -118,7 +182,7 @@ int main(int argc, char* argv[]) {
         auto startQuery = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> queryResults = dict.QueryByPrefix(dict.GetData(randVals[i]));
+            SelectionVector queryResults = dict.QueryByPrefix(dict.GetData(randVals[i]));
         }
 
         auto endQuery = std::chrono::high_resolution_clock::now();
@@ -129,7 +193,7 @@ int main(int argc, char* argv[]) {
         auto startQuerySIMD = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> queryResults = dict.SIMDQueryByPrefix(dict.GetData(randVals[i]));
+            SelectionVector queryResults = dict.SIMDQueryByPrefix(dict.GetData(randVals[i]));
         }
 
         auto endQuerySIMD = std::chrono::high_resolution_clock::now();
@@ -140,7 +204,7 @@ int main(int argc, char* argv[]) {
         auto startBaseline = std::chrono::high_resolution_clock::now();
 
         for (size_t i = 0; i < num_tests; i++) {
-            std::vector<size_t> baselineResults = dict.BaselinePrefixSearch(dict.GetData(randVals[i]));
+            SelectionVector baselineResults = dict.BaselinePrefixSearch(dict.GetData(randVals[i]));
         }
 
         auto endBaseline = std::chrono::high_resolution_clock::now();
@@ -148,6 +212,621 @@ int main(int argc, char* argv[]) {
         std::cout << "BaselinePrefixSearch execution time: " << baselineDuration.count()/num_tests << " seconds" << std::endl;
     }
 
+    // IN-list query tests demo
+    else if (strcmp(argv[1], "query_in") == 0) {
+        // Create the DictionaryCodec instance
+        DictionaryCodec dict;
+
+        // Load the encoded file
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
+
+        // Setup random number generator
+        size_t maxIndex = dict.GetDataSize();
+        std::random_device rd;
+        std::uniform_int_distribution<size_t> dist(0, maxIndex - 1);
+
+        // Build an IN list from the values of random rows (duplicates removed)
+        size_t listSize = 10;
+        std::vector<std::string> items;
+        for (size_t i = 0; i < listSize; i++) {
+            items.emplace_back(dict.GetData(dist(rd)));
+        }
+        std::sort(items.begin(), items.end());
+        items.erase(std::unique(items.begin(), items.end()), items.end());
+
+        // Accuracy: one IN pass must return the union of the separate point queries
+        RowBitmap separateRows;
+        for (const auto& item : items) {
+            separateRows = separateRows.Or(RowBitmap::FromSelection(dict.SIMDQueryItem(item)));
+        }
+        SelectionVector inRows = dict.QueryIn(items);
+        bool sameRows = RowBitmap::FromSelection(inRows).And(separateRows).Cardinality() == inRows.size() &&
+                        inRows.size() == separateRows.Cardinality();
+        std::cout << "Rows returned by QueryIn / union of SIMDQueryItem calls: "
+                  << inRows.size() << " " << separateRows.Cardinality()
+                  << (sameRows ? " (same rows)" : " (rows differ)") << std::endl;
+
+        size_t num_tests = 100;
+
+        // Timing the QueryIn operation
+        auto startIn = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector queryResults = dict.QueryIn(items);
+        }
+        auto endIn = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> inDuration = endIn - startIn;
+        std::cout << "QueryIn execution time: " << inDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing one SIMDQueryItem per list entry
+        auto startSeparate = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            for (const auto& item : items) {
+                SelectionVector queryResults = dict.SIMDQueryItem(item);
+            }
+        }
+        auto endSeparate = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> separateDuration = endSeparate - startSeparate;
+        std::cout << "Separate SIMDQueryItem execution time: " << separateDuration.count()/num_tests << " seconds" << std::endl;
+    }
+
+    // Range query tests demo
+    else if (strcmp(argv[1], "query_range") == 0) {
+        // Create the DictionaryCodec instance
+        DictionaryCodec dict;
+
+        // Load the encoded file
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
+
+        // Setup random number generator
+        size_t maxIndex = dict.GetDataSize();
+        std::random_device rd;
+        std::uniform_int_distribution<size_t> dist(0, maxIndex - 1);
+
+        // Bounds taken from the values of random rows
+        size_t num_tests = 20;
+        std::vector<std::string> bounds;
+        for (size_t i = 0; i < 2 * num_tests; i++) {
+            bounds.emplace_back(dict.GetData(dist(rd)));
+        }
+
+        // Accuracy: every comparison against the string baseline, BETWEEN against >= and <= combined
+        const CompareOp ops[] = {CompareOp::Less, CompareOp::LessEqual, CompareOp::Greater, CompareOp::GreaterEqual};
+        const char* opNames[] = {"<", "<=", ">", ">="};
+        std::cout << "Rows returned by QueryCompare / BaselineCompareSearch:" << std::endl;
+        for (size_t k = 0; k < 4; k++) {
+            SelectionVector rows = dict.QueryCompare(ops[k], bounds[0]);
+            SelectionVector baseline = dict.BaselineCompareSearch(ops[k], bounds[0]);
+            bool same = rows.size() == baseline.size() && std::equal(rows.begin(), rows.end(), baseline.begin());
+            std::cout << opNames[k] << " " << rows.size() << " " << baseline.size()
+                      << (same ? " (same rows)" : " (rows differ)") << std::endl;
+        }
+        std::string lo = std::min(bounds[0], bounds[1]);
+        std::string hi = std::max(bounds[0], bounds[1]);
+        SelectionVector between = dict.QueryBetween(lo, hi);
+        SelectionVector baselineBetween = dict.BaselineCompareSearch(CompareOp::GreaterEqual, lo)
+                                              .Intersect(dict.BaselineCompareSearch(CompareOp::LessEqual, hi));
+        bool sameBetween = between.size() == baselineBetween.size() &&
+                           std::equal(between.begin(), between.end(), baselineBetween.begin());
+        std::cout << "BETWEEN " << between.size() << " " << baselineBetween.size()
+                  << (sameBetween ? " (same rows)" : " (rows differ)") << std::endl;
+
+        // Timing the QueryBetween operation
+        auto startBetween = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector queryResults = dict.QueryBetween(std::min(bounds[2 * i], bounds[2 * i + 1]),
+                                                             std::max(bounds[2 * i], bounds[2 * i + 1]));
+        }
+        auto endBetween = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> betweenDuration = endBetween - startBetween;
+        std::cout << "QueryBetween execution time: " << betweenDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing the QueryCompare operation
+        auto startCompare = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector queryResults = dict.QueryCompare(CompareOp::Less, bounds[i]);
+        }
+        auto endCompare = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> compareDuration = endCompare - startCompare;
+        std::cout << "QueryCompare execution time: " << compareDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing the BaselineCompareSearch operation
+        auto startBaseline = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector baselineResults = dict.BaselineCompareSearch(CompareOp::Less, bounds[i]);
+        }
+        auto endBaseline = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> baselineDuration = endBaseline - startBaseline;
+        std::cout << "BaselineCompareSearch execution time: " << baselineDuration.count()/num_tests << " seconds" << std::endl;
+    }
+
+    // Aggregation tests demo
+    else if (strcmp(argv[1], "aggregate") == 0) {
+        // Create the DictionaryCodec instance
+        DictionaryCodec dict;
+
+        // Load the encoded file
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
+
+        // Baseline: count every row's value in a hash map
+        auto baselineCounts = [&dict]() {
+            std::unordered_map<std::string_view, uint64_t> counts;
+            for (size_t i = 0; i < dict.GetDataSize(); i++) {
+                counts[dict.GetData(i)]++;
+            }
+            return counts;
+        };
+
+        // Accuracy: every group against the baseline count of its value
+        std::unordered_map<std::string_view, uint64_t> baseline = baselineCounts();
+        std::vector<ValueCount> groups = dict.GroupByCount();
+        size_t mismatches = groups.size() == baseline.size() ? 0 : 1;
+        for (const ValueCount& group : groups) {
+            if (baseline[group.first] != group.second) mismatches++;
+        }
+        std::cout << "Groups: " << groups.size() << ", distinct values: " << dict.CountDistinct()
+                  << ", mismatches against the baseline: " << mismatches << std::endl;
+
+        std::cout << "Top 5 values:" << std::endl;
+        for (const ValueCount& top : dict.TopK(5)) {
+            std::cout << top.first << " " << top.second << std::endl;
+        }
+
+        // Aggregates over a query result: the rows of a prefix query
+        SelectionVector rows = dict.SIMDQueryByPrefix(dict.GetData(0).substr(0, 2));
+        std::cout << "Rows with prefix \"" << dict.GetData(0).substr(0, 2) << "\": " << rows.size()
+                  << ", distinct values: " << dict.CountDistinct(&rows) << std::endl;
+
+        // Timing the GroupByCount operation
+        size_t num_tests = 10;
+        auto startGroup = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            std::vector<ValueCount> results = dict.GroupByCount();
+        }
+        auto endGroup = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> groupDuration = endGroup - startGroup;
+        std::cout << "GroupByCount execution time: " << groupDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing the TopK operation
+        auto startTop = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            std::vector<ValueCount> results = dict.TopK(10);
+        }
+        auto endTop = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> topDuration = endTop - startTop;
+        std::cout << "TopK execution time: " << topDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing the baseline
+        auto startBaseline = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            std::unordered_map<std::string_view, uint64_t> results = baselineCounts();
+        }
+        auto endBaseline = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> baselineDuration = endBaseline - startBaseline;
+        std::cout << "Baseline hash-map count execution time: " << baselineDuration.count()/num_tests << " seconds" << std::endl;
+    }
+
+    // Append and compaction demo (grows src/Output.txt)
+    else if (strcmp(argv[1], "append") == 0) {
+        // Create the DictionaryCodec instance
+        DictionaryCodec dict;
+
+        // Load the encoded file
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
+
+        // Setup random number generator
+        size_t maxIndex = dict.GetDataSize();
+        std::random_device rd;
+        std::uniform_int_distribution<size_t> dist(0, maxIndex - 1);
+
+        // Append batches mixing existing values with values the dictionary has not seen
+        size_t num_batches = 10;
+        size_t batch_rows = 1000;
+        std::vector<std::string> checkItems;
+        auto startAppend = std::chrono::high_resolution_clock::now();
+        for (size_t b = 0; b < num_batches; b++) {
+            std::vector<std::string> rows;
+            for (size_t i = 0; i < batch_rows; i++) {
+                if (i % 4 == 0) {
+                    rows.push_back("appended-" + std::to_string(maxIndex) + "-" + std::to_string(i % 100));
+                } else {
+                    rows.emplace_back(dict.GetData(dist(rd)));
+                }
+            }
+            checkItems.push_back(rows[0]);
+            checkItems.push_back(rows[1]);
+            if (!dict.AppendRows(rows)) {
+                return 1;
+            }
+        }
+        auto endAppend = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> appendDuration = endAppend - startAppend;
+        std::cout << "AppendRows execution time: " << appendDuration.count()/num_batches << " seconds per "
+                  << batch_rows << " rows (" << dict.GetDeltaCount() << " delta segments)" << std::endl;
+
+        // Accuracy: appended rows must be visible to queries, before and after compaction
+        auto countMismatches = [&]() {
+            size_t mismatches = 0;
+            for (const auto& item : checkItems) {
+                mismatches += dict.SIMDQueryItem(item).size() != dict.BaselineSearch(item).size();
+            }
+            return mismatches;
+        };
+        std::cout << "Rows: " << dict.GetDataSize() << ", query mismatches with delta segments: "
+                  << countMismatches() << std::endl;
+
+        // Queries keep running while the deltas are merged in the background
+        auto startCompact = std::chrono::high_resolution_clock::now();
+        dict.CompactInBackground();
+        size_t queriesDuringCompaction = 0;
+        while (dict.GetDeltaCount() != 0 && queriesDuringCompaction < 100000) {
+            SelectionVector queryResults = dict.SIMDQueryItem(checkItems[queriesDuringCompaction % checkItems.size()]);
+            queriesDuringCompaction++;
+        }
+        if (!dict.WaitForCompaction()) {
+            return 1;
+        }
+        auto endCompact = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> compactDuration = endCompact - startCompact;
+        std::cout << "Compaction time: " << compactDuration.count() << " seconds (" << queriesDuringCompaction
+                  << " queries served meanwhile)" << std::endl;
+        std::cout << "Rows: " << dict.GetDataSize() << ", query mismatches after compaction: "
+                  << countMismatches() << std::endl;
+    }
+
+    // Encode a multi-column table (src/Table.csv, generated from src/Column.txt if missing)
+    else if (strcmp(argv[1], "write_table") == 0) {
+        // Sample table: the value, its first two characters and a bucket number from its row
+        if (!std::ifstream("src/Table.csv").is_open()) {
+            std::ifstream column("src/Column.txt");
+            std::ofstream csv("src/Table.csv");
+            csv << "value,initial,bucket" << std::endl;
+            std::string line;
+            for (size_t row = 0; std::getline(column, line); row++) {
+                csv << line << "," << line.substr(0, 2) << ",b" << (row * 7919) % 64 << "\n";
+            }
+        }
+
+        // Optional arguments as for write_encoding, except "stream"
+        EncodeOptions options;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "sorted") == 0) options.sortedDictionary = true;
+            if (strcmp(argv[i], "index") == 0) options.buildPostingIndex = true;
+            if (strcmp(argv[i], "compress") == 0) options.compressCodes = true;
+        }
+
+        EncodedTable table;
+        if (!table.EncodeCsvFile("src/Table.csv", "src/Table.enc", options)) {
+            std::cout << "Error: failed to write src/Table.enc" << std::endl;
+            return 1;
+        }
+        std::cout << "Encoded " << table.GetRowCount() << " rows in " << table.GetColumnCount() << " columns"
+                  << std::endl;
+    }
+
+    // Conjunctive table query tests demo
+    else if (strcmp(argv[1], "query_table") == 0) {
+        // Load the table file
+        EncodedTable table;
+        if (!table.LoadTableFile("src/Table.enc")) {
+            return 1;
+        }
+
+        // Setup random number generator
+        size_t maxIndex = table.GetRowCount();
+        std::random_device rd;
+        std::uniform_int_distribution<size_t> dist(0, maxIndex - 1);
+
+        // Random conjunctions built from a row's values: bucket = x AND value LIKE 'p%', and
+        // initial = x AND bucket = y
+        size_t value = table.ColumnIndex("value"), initial = table.ColumnIndex("initial");
+        size_t bucket = table.ColumnIndex("bucket");
+        if (bucket == table.GetColumnCount() || value == table.GetColumnCount() ||
+            initial == table.GetColumnCount()) {
+            std::cout << "Error: src/Table.enc needs columns value, initial and bucket" << std::endl;
+            return 1;
+        }
+        std::vector<std::vector<TablePredicate>> queries;
+        size_t num_tests = 100;
+        for (size_t i = 0; i < num_tests; i++) {
+            size_t row = dist(rd);
+            std::string bucketValue(table.GetValue(row, bucket));
+            if (i % 2 == 0) {
+                std::string prefix(table.GetValue(row, value).substr(0, 3));
+                queries.push_back({{"bucket", TablePredicate::Kind::Equal, bucketValue},
+                                   {"value", TablePredicate::Kind::Prefix, prefix}});
+            } else {
+                std::string initialValue(table.GetValue(row, initial));
+                queries.push_back({{"initial", TablePredicate::Kind::Equal, initialValue},
+                                   {"bucket", TablePredicate::Kind::Equal, bucketValue}});
+            }
+        }
+
+        // Accuracy: every query against the row-by-row baseline
+        std::cout << "Number of indexes returned for each method:" << std::endl;
+        for (size_t i = 0; i < 10; i++) {
+            std::cout << table.Query(queries[i]).size() << " " << table.BaselineQuery(queries[i]).size() << std::endl;
+        }
+
+        // Timing the Query operation
+        auto startQuery = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector queryResults = table.Query(queries[i]);
+        }
+        auto endQuery = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> queryDuration = endQuery - startQuery;
+        std::cout << "Query execution time: " << queryDuration.count()/num_tests << " seconds" << std::endl;
+
+        // Timing the baseline
+        auto startBaseline = std::chrono::high_resolution_clock::now();
+        for (size_t i = 0; i < num_tests; i++) {
+            SelectionVector baselineResults = table.BaselineQuery(queries[i]);
+        }
+        auto endBaseline = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> baselineDuration = endBaseline - startBaseline;
+        std::cout << "BaselineQuery execution time: " << baselineDuration.count()/num_tests << " seconds" << std::endl;
+    }
+
+    // Query server: load encoded columns once and answer clients on a Unix socket until SIGINT or SIGTERM
+    else if (strcmp(argv[1], "serve") == 0) {
+        // Optional arguments: socket=<path> (default src/Query.sock), and <name>=<encoded file> for each
+        // column to serve (default column=src/Output.txt)
+        std::string socketPath = "src/Query.sock";
+        std::vector<std::pair<std::string, std::string>> columns;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                std::cout << "Error: expected socket=<path> or <name>=<encoded file>, got " << arg << std::endl;
+                return 1;
+            }
+            if (arg.compare(0, eq, "socket") == 0) {
+                socketPath = arg.substr(eq + 1);
+            } else {
+                columns.emplace_back(arg.substr(0, eq), arg.substr(eq + 1));
+            }
+        }
+        if (columns.empty()) {
+            columns.emplace_back("column", "src/Output.txt");
+        }
+
+        // Block the stop signals before any thread starts, so only the waiting thread below receives them
+        sigset_t stopSignals;
+        sigemptyset(&stopSignals);
+        sigaddset(&stopSignals, SIGINT);
+        sigaddset(&stopSignals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+        QueryServer server;
+        for (const auto& column : columns) {
+            if (!server.AddColumn(column.first, column.second)) {
+                return 1;
+            }
+        }
+        if (!server.Listen(socketPath)) {
+            return 1;
+        }
+
+        std::thread stopper([&]() {
+            int signal = 0;
+            sigwait(&stopSignals, &signal);
+            server.Stop();
+        });
+        std::cout << "Serving " << server.GetColumnCount() << " columns on " << socketPath << std::endl;
+        server.Serve();
+
+        // Serve also returns on an error, with the waiting thread still blocked
+        pthread_kill(stopper.native_handle(), SIGTERM);
+        stopper.join();
+        std::cout << "Server stopped" << std::endl;
+    }
+
+    // Load generator: keeps connections x depth requests in flight against a running server
+    else if (strcmp(argv[1], "load_test") == 0) {
+        // Optional arguments: item, prefix or batch (default item), connections=N (4), depth=N (16),
+        // seconds=N (5), socket=<path> (src/Query.sock). Queries the server's first column.
+        std::string mode = "item";
+        std::string socketPath = "src/Query.sock";
+        size_t connections = 4, depth = 16, seconds = 5;
+        for (int i = 2; i < argc; i++) {
+            std::string arg = argv[i];
+            size_t eq = arg.find('=');
+            std::string name = arg.substr(0, eq);
+            std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+            if (eq == std::string::npos) mode = arg;
+            else if (name == "connections") connections = std::max<size_t>(1, std::stoul(value));
+            else if (name == "depth") depth = std::max<size_t>(1, std::stoul(value));
+            else if (name == "seconds") seconds = std::max<size_t>(1, std::stoul(value));
+            else if (name == "socket") socketPath = value;
+        }
+        if (mode != "item" && mode != "prefix" && mode != "batch") {
+            std::cout << "Error: load_test mode must be item, prefix or batch" << std::endl;
+            return 1;
+        }
+
+        // Keys are values of src/Column.txt; a prefix drops a key's last character
+        std::vector<std::string> keys;
+        {
+            std::ifstream column("src/Column.txt");
+            std::string line;
+            while (std::getline(column, line)) {
+                keys.push_back(line);
+            }
+        }
+        if (keys.empty()) {
+            std::cout << "Error: no keys in src/Column.txt" << std::endl;
+            return 1;
+        }
+
+        QueryClient probe;
+        std::vector<ServedColumn> served;
+        if (!probe.Connect(socketPath) || !probe.Columns(served) || served.empty()) {
+            std::cout << "Error: no server with a column on " << socketPath << std::endl;
+            return 1;
+        }
+        std::cout << "Querying column " << served[0].name << " (" << served[0].rows << " rows) with " << mode
+                  << " requests, " << connections << " connections x " << depth << " in flight" << std::endl;
+
+        // Each connection keeps depth requests in flight: every response is answered with a new request.
+        // Responses come back in request order, so a queue of send times gives each one's latency.
+        using Clock = std::chrono::steady_clock;
+        size_t batch_keys = 16;
+        std::atomic<bool> stop{false};
+        std::atomic<size_t> failures{0};
+        std::vector<std::vector<double>> latencies(connections);
+        std::vector<std::thread> workers;
+        for (size_t c = 0; c < connections; c++) {
+            workers.emplace_back([&, c]() {
+                QueryClient client;
+                if (!client.Connect(socketPath)) {
+                    failures++;
+                    return;
+                }
+                std::mt19937_64 rng(c + 1);
+                std::uniform_int_distribution<size_t> dist(0, keys.size() - 1);
+                std::deque<Clock::time_point> inFlight;
+                auto send = [&]() {
+                    const std::string& key = keys[dist(rng)];
+                    if (mode == "item") {
+                        client.SendItem(0, key);
+                    } else if (mode == "prefix") {
+                        client.SendPrefix(0, std::string_view(key).substr(0, key.size() - (key.size() > 1)));
+                    } else {
+                        std::vector<std::string> batch;
+                        for (size_t k = 0; k < batch_keys; k++) {
+                            batch.push_back(keys[dist(rng)]);
+                        }
+                        client.SendBatch(0, batch);
+                    }
+                    inFlight.push_back(Clock::now());
+                };
+
+                for (size_t i = 0; i < depth; i++) {
+                    send();
+                }
+                if (!client.Flush()) {
+                    failures++;
+                    return;
+                }
+                QueryResponse response;
+                while (!inFlight.empty()) {
+                    if (!client.Receive(response)) {
+                        failures++;
+                        return;
+                    }
+                    latencies[c].push_back(std::chrono::duration<double, std::micro>(Clock::now() - inFlight.front()).count());
+                    inFlight.pop_front();
+                    failures += response.status != kStatusOk;
+                    if (!stop) {
+                        send();
+                        if (!client.Flush()) {
+                            failures++;
+                            return;
+                        }
+                    }
+                }
+            });
+        }
+
+        auto start = Clock::now();
+        std::this_thread::sleep_for(std::chrono::seconds(seconds));
+        stop = true;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        std::chrono::duration<double> elapsed = Clock::now() - start;
+
+        std::vector<double> all;
+        for (const auto& connectionLatencies : latencies) {
+            all.insert(all.end(), connectionLatencies.begin(), connectionLatencies.end());
+        }
+        if (all.empty()) {
+            std::cout << "Error: no responses (" << failures << " failures)" << std::endl;
+            return 1;
+        }
+        std::sort(all.begin(), all.end());
+        auto percentile = [&](double p) { return all[std::min(all.size() - 1, static_cast<size_t>(p * all.size()))]; };
+        std::cout << "Requests: " << all.size() << " in " << elapsed.count() << " seconds (" << failures
+                  << " failures)" << std::endl;
+        std::cout << "Throughput: " << all.size() / elapsed.count() << " requests/s";
+        if (mode == "batch") std::cout << " (" << all.size() * batch_keys / elapsed.count() << " keys/s)";
+        std::cout << std::endl;
+        std::cout << "Latency (us): p50 " << percentile(0.50) << ", p90 " << percentile(0.90) << ", p99 "
+                  << percentile(0.99) << ", p99.9 " << percentile(0.999) << ", max " << all.back() << std::endl;
+    }
+
+    // Per-query execution statistics demo
+    else if (strcmp(argv[1], "query_stats") == 0) {
+        // Optional arguments: out=<path> for the records (src/QueryStats.jsonl), "nohardware" skips the
+        // perf_event counters
+        std::string out_path = "src/QueryStats.jsonl";
+        bool hardware = true;
+        for (int i = 2; i < argc; i++) {
+            if (strncmp(argv[i], "out=", 4) == 0) out_path = argv[i] + 4;
+            if (strcmp(argv[i], "nohardware") == 0) hardware = false;
+        }
+
+        // Create the DictionaryCodec instance
+        DictionaryCodec dict;
+
+        // Load the encoded file
+        if (!dict.LoadEncodedFile("src/Output.txt")) {
+            return 1;
+        }
+
+        HardwareCounts available = QueryProfiler::AvailableCounters();
+        std::cout << "Hardware counters:";
+        for (size_t i = 0; i < kHardwareCounters; i++) {
+            if (hardware && available.Has(static_cast<HardwareCounter>(i))) {
+                std::cout << " " << HardwareCounterName(static_cast<HardwareCounter>(i));
+            }
+        }
+        std::cout << std::endl;
+
+        // One query of every kind on values from random rows, recorded by the profiler
+        std::random_device rd;
+        std::uniform_int_distribution<size_t> dist(0, dict.GetDataSize() - 1);
+        std::string item(dict.GetData(dist(rd)));
+        std::string other(dict.GetData(dist(rd)));
+
+        QueryProfiler profiler(hardware);
+        SelectionVector rows = dict.SIMDQueryItem(item);
+        dict.QueryItem(item);
+        dict.SIMDQueryByPrefix(item.substr(0, 2));
+        dict.QueryByPrefix(item.substr(0, 2));
+        dict.QueryBetween(std::min(item, other), std::max(item, other));
+        dict.QueryIn({item, other});
+        dict.QueryBatch({item, other});
+        dict.GroupByCount();
+        dict.TopK(10);
+        StringArena values;
+        dict.Decode(rows, values);
+        dict.BaselineSearch(item);
+
+        for (const QueryStats& stats : profiler.Records()) {
+            std::cout << stats.query << ": " << stats.seconds * 1e3 << " ms, "
+                      << stats.Get(QueryCounter::KeysProbed) << " keys probed, "
+                      << stats.Get(QueryCounter::RowsScanned) << " rows scanned, "
+                      << stats.Get(QueryCounter::MorselsSkipped) << " morsels skipped, "
+                      << stats.matches << " matches" << std::endl;
+        }
+
+        std::ofstream out(out_path);
+        profiler.WriteJsonLines(out);
+        if (!out.good()) {
+            std::cerr << "Error: failed to write " << out_path << std::endl;
+            return 1;
+        }
+        std::cout << "Records written to " << out_path << std::endl;
+    }
+
     // Prefix query tests demo
     else if (strcmp(argv[1], "encoding_speed") == 0) {
         // Create the DictionaryCodec instance
@@ -0,0 +1,950 @@
+// CodeColumn.cpp: Encoded column stored at the narrowest code width that fits the dictionary
+#include "CodeColumn.h"
+#include "SimdKernels.h"
+#include <algorithm>   // std::min, std::upper_bound
+#include <array>       // std::array
+#include <numeric>     // std::iota
+#include <utility>     // std::index_sequence
+
+namespace {
+
+// Extract code i of a bit-packed block starting at words
+template <unsigned Bits>
+inline uint32_t UnpackOne(const uint64_t* words, size_t i) {
+    constexpr uint64_t kMask = (uint64_t(1) << Bits) - 1;
+    size_t pos = i * Bits;
+    size_t word = pos >> 6;
+    unsigned shift = pos & 63;
+    uint64_t value = words[word] >> shift;
+    if (shift + Bits > 64) {
+        value |= words[word + 1] << (64 - shift);
+    }
+    return static_cast<uint32_t>(value & kMask);
+}
+
+// Unpack one full block of 64 codes, the width is a constant so the loop fully unrolls
+template <unsigned Bits>
+void UnpackBlock(const uint64_t* words, uint32_t* out) {
+    for (size_t i = 0; i < CodeColumn::kPackedBlock; ++i) {
+        out[i] = UnpackOne<Bits>(words, i);
+    }
+}
+
+using UnpackFn = void (*)(const uint64_t*, uint32_t*);
+
+template <size_t... Bits>
+constexpr auto MakeUnpackTable(std::index_sequence<Bits...>) {
+    // Index 0 is unused, widths run from 1 to 32
+    return std::array<UnpackFn, sizeof...(Bits) + 1>{nullptr, &UnpackBlock<Bits + 1>...};
+}
+
+// Width-specialized unpackers, indexed by bit width
+const auto kUnpackers = MakeUnpackTable(std::make_index_sequence<32>{});
+
+// Scalar range scan over a byte-aligned code array
+template <typename T>
+void ScanRangeScalarTyped(const uint8_t* data, size_t n, size_t base, size_t lo, size_t hi, SelectionVector& results) {
+    const T* codes = reinterpret_cast<const T*>(data);
+    size_t span = hi - lo; // One unsigned compare covers both bounds
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<size_t>(codes[i]) - lo < span) {
+            results.push_back(static_cast<uint32_t>(base + i));
+        }
+    }
+}
+
+// Scalar membership scan over a byte-aligned code array
+template <typename T>
+void ScanInScalarTyped(const uint8_t* data, size_t n, size_t base, const CodeSet& set, SelectionVector& results) {
+    const T* codes = reinterpret_cast<const T*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        if (set.Contains(codes[i])) {
+            results.push_back(static_cast<uint32_t>(base + i));
+        }
+    }
+}
+
+// Codes of the given rows of a byte-aligned code array
+template <typename T>
+void GatherTyped(const uint8_t* data, const uint32_t* rows, size_t n, size_t* codes) {
+    const T* values = reinterpret_cast<const T*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        codes[i] = values[rows[i]];
+    }
+}
+
+// Codes of n consecutive rows of a byte-aligned code array, widened
+template <typename T>
+void WidenTyped(const uint8_t* data, size_t n, size_t* codes) {
+    const T* values = reinterpret_cast<const T*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        codes[i] = values[i];
+    }
+}
+
+// Add every code of a byte-aligned array to counts
+template <typename T>
+void CountTyped(const uint8_t* data, size_t n, uint32_t* counts) {
+    const T* codes = reinterpret_cast<const T*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        counts[codes[i]]++;
+    }
+}
+
+// 8-bit codes: four interleaved sub-histograms, so a run of one code does not serialize every
+// increment on a single counter. Only codes that occur are added to counts.
+void CountBytes(const uint8_t* codes, size_t n, uint32_t* counts) {
+    uint32_t lanes[4][256] = {};
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        lanes[0][codes[i]]++;
+        lanes[1][codes[i + 1]]++;
+        lanes[2][codes[i + 2]]++;
+        lanes[3][codes[i + 3]]++;
+    }
+    for (; i < n; ++i) {
+        lanes[0][codes[i]]++;
+    }
+    for (size_t code = 0; code < 256; ++code) {
+        uint32_t sum = lanes[0][code] + lanes[1][code] + lanes[2][code] + lanes[3][code];
+        if (sum != 0) counts[code] += sum;
+    }
+}
+
+// Rows handed to a kernel per call: bounds the unpack buffer and the result growth per step.
+// A multiple of kPackedBlock, so bit-packed chunks always start a block.
+constexpr size_t kKernelRows = 1024;
+static_assert(kKernelRows % CodeColumn::kPackedBlock == 0, "kernel chunks must hold whole packed blocks");
+
+static_assert(CodeSet::kSmallSet <= kMaxSmallSetKeys, "small sets must fit the small-set kernels");
+
+// Compressed blocks: the encoding sits in the low bits of a directory entry, then the width, then the
+// payload's word offset
+enum BlockEncoding : unsigned { kFrameOfReference = 0, kRunLength = 1, kDelta = 2 };
+constexpr unsigned kEncodingBits = 2;
+constexpr unsigned kWidthBits = 6;
+
+// One block of a compressed column
+struct CompressedBlock {
+    unsigned encoding;
+    unsigned width;          // Bits per packed offset or delta
+    size_t rows;             // Rows in the block, the last one may be shorter
+    const uint64_t* payload;
+};
+
+// Bits needed to store values 0 .. value
+inline unsigned BitsFor(uint64_t value) {
+    return value == 0 ? 0 : 64 - __builtin_clzll(value);
+}
+
+// Bit-packed blocks needed for rows codes
+inline size_t PackedBlocks(size_t rows) {
+    return (rows + CodeColumn::kPackedBlock - 1) / CodeColumn::kPackedBlock;
+}
+
+// Payload words of a run-length block
+inline size_t RunLengthWords(size_t runs) {
+    return 1 + (runs * (sizeof(uint32_t) + sizeof(uint16_t)) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+}
+
+// Words of the start codes of a delta block
+inline size_t DeltaStartWords(size_t rows) {
+    return (PackedBlocks(rows) + 1) / 2;
+}
+
+// Block number index of a compressed column
+inline CompressedBlock BlockAt(const uint8_t* data, size_t rows, size_t index) {
+    const uint64_t* directory = reinterpret_cast<const uint64_t*>(data);
+    size_t blocks = (rows + CodeColumn::kCompressedBlock - 1) / CodeColumn::kCompressedBlock;
+    uint64_t entry = directory[index];
+    size_t first = index * CodeColumn::kCompressedBlock;
+    return {static_cast<unsigned>(entry & ((1u << kEncodingBits) - 1)),
+            static_cast<unsigned>((entry >> kEncodingBits) & ((1u << kWidthBits) - 1)),
+            std::min(CodeColumn::kCompressedBlock, rows - first),
+            directory + blocks + (entry >> (kEncodingBits + kWidthBits))};
+}
+
+// Value i of a bit-packed array at width bits (width 0 holds only zeros)
+inline uint64_t PackedValue(const uint64_t* words, size_t i, unsigned width) {
+    if (width == 0) return 0;
+    size_t pos = i * width;
+    size_t word = pos >> 6;
+    unsigned shift = pos & 63;
+    uint64_t value = words[word] >> shift;
+    if (shift + width > 64) {
+        value |= words[word + 1] << (64 - shift);
+    }
+    return value & ((uint64_t(1) << width) - 1);
+}
+
+// Store value i of a bit-packed array of zeroed words
+inline void PackValue(uint64_t* words, size_t i, unsigned width, uint64_t value) {
+    if (width == 0) return;
+    size_t pos = i * width;
+    size_t word = pos >> 6;
+    unsigned shift = pos & 63;
+    words[word] |= value << shift;
+    if (shift + width > 64) {
+        words[word + 1] |= value >> (64 - shift);
+    }
+}
+
+// Unpack 64-code block index of a bit-packed array at width bits
+inline void UnpackPacked(const uint64_t* words, unsigned width, size_t index, uint32_t* out) {
+    if (width == 0) {
+        std::fill(out, out + CodeColumn::kPackedBlock, 0);
+        return;
+    }
+    kUnpackers[width](words + index * width, out);
+}
+
+// Run codes and exclusive run ends of a run-length block
+inline const uint32_t* RunCodes(const CompressedBlock& block) {
+    return reinterpret_cast<const uint32_t*>(block.payload + 1);
+}
+inline const uint16_t* RunEnds(const CompressedBlock& block) {
+    return reinterpret_cast<const uint16_t*>(RunCodes(block) + block.payload[0]);
+}
+
+// Run holding row of a run-length block
+inline size_t RunOf(const CompressedBlock& block, size_t row) {
+    const uint16_t* ends = RunEnds(block);
+    return std::upper_bound(ends, ends + block.payload[0], row) - ends;
+}
+
+// Code of row of a block
+size_t BlockCode(const CompressedBlock& block, size_t row) {
+    switch (block.encoding) {
+        case kRunLength:
+            return RunCodes(block)[RunOf(block, row)];
+        case kFrameOfReference:
+            return block.payload[0] + PackedValue(block.payload + 1, row, block.width);
+        default: {
+            // Deltas are summed from the start of the row's 64-code block
+            const uint64_t* deltas = block.payload + DeltaStartWords(block.rows);
+            size_t first = row - row % CodeColumn::kPackedBlock;
+            size_t code = reinterpret_cast<const uint32_t*>(block.payload)[first / CodeColumn::kPackedBlock];
+            for (size_t i = first + 1; i <= row; ++i) {
+                code += PackedValue(deltas, i, block.width);
+            }
+            return code;
+        }
+    }
+}
+
+// Codes of rows [begin, end) of a block
+void DecodeBlock(const CompressedBlock& block, size_t begin, size_t end, uint32_t* out) {
+    if (block.encoding == kRunLength) {
+        const uint32_t* codes = RunCodes(block);
+        const uint16_t* ends = RunEnds(block);
+        for (size_t run = RunOf(block, begin), row = begin; row < end; ++run) {
+            size_t stop = std::min<size_t>(ends[run], end);
+            out = std::fill_n(out, stop - row, codes[run]);
+            row = stop;
+        }
+        return;
+    }
+
+    // Packed offsets or deltas come out a 64-code block at a time
+    bool delta = block.encoding == kDelta;
+    const uint64_t* words = delta ? block.payload + DeltaStartWords(block.rows) : block.payload + 1;
+    const uint32_t* starts = reinterpret_cast<const uint32_t*>(block.payload);
+    alignas(64) uint32_t packed[CodeColumn::kPackedBlock];
+    for (size_t row = begin; row < end;) {
+        size_t index = row / CodeColumn::kPackedBlock;
+        size_t first = index * CodeColumn::kPackedBlock;
+        size_t stop = std::min(first + CodeColumn::kPackedBlock, end);
+        UnpackPacked(words, block.width, index, packed);
+        if (delta) {
+            uint32_t code = starts[index];
+            for (size_t i = first + 1; i < row; ++i) code += packed[i - first];
+            for (; row < stop; ++row) {
+                if (row != first) code += packed[row - first];
+                *out++ = code;
+            }
+        } else {
+            uint32_t reference = static_cast<uint32_t>(block.payload[0]);
+            for (; row < stop; ++row) *out++ = reference + packed[row - first];
+        }
+    }
+}
+
+// Compress n codes into one block: frame of reference, run length or delta, whichever payload is
+// smallest (ties go to the cheaper one to decode, in that order). The payload is appended to payloads
+// and the block's directory entry returned.
+uint64_t CompressBlock(const uint32_t* codes, size_t n, std::vector<uint64_t>& payloads) {
+    uint32_t lo = codes[0], hi = codes[0], maxDelta = 0;
+    size_t runs = 1;
+    bool ascending = true;
+    for (size_t i = 1; i < n; ++i) {
+        lo = std::min(lo, codes[i]);
+        hi = std::max(hi, codes[i]);
+        runs += codes[i] != codes[i - 1];
+        ascending &= codes[i] >= codes[i - 1];
+        if (ascending && i % CodeColumn::kPackedBlock != 0) maxDelta = std::max(maxDelta, codes[i] - codes[i - 1]);
+    }
+
+    size_t packed = PackedBlocks(n);
+    unsigned forWidth = BitsFor(hi - lo);
+    unsigned deltaWidth = BitsFor(maxDelta);
+    size_t forWords = 1 + packed * forWidth;
+    size_t runWords = RunLengthWords(runs);
+    size_t deltaWords = ascending ? DeltaStartWords(n) + packed * deltaWidth : ~size_t(0);
+
+    size_t offset = payloads.size();
+    if (forWords <= runWords && forWords <= deltaWords) {
+        payloads.resize(offset + forWords, 0);
+        payloads[offset] = lo;
+        for (size_t i = 0; i < n; ++i) {
+            PackValue(payloads.data() + offset + 1, i, forWidth, codes[i] - lo);
+        }
+        return kFrameOfReference | uint64_t(forWidth) << kEncodingBits | uint64_t(offset) << (kEncodingBits + kWidthBits);
+    }
+    if (runWords <= deltaWords) {
+        payloads.resize(offset + runWords, 0);
+        payloads[offset] = runs;
+        uint32_t* runCodes = reinterpret_cast<uint32_t*>(payloads.data() + offset + 1);
+        uint16_t* runEnds = reinterpret_cast<uint16_t*>(runCodes + runs);
+        size_t run = 0;
+        for (size_t i = 1; i <= n; ++i) {
+            if (i == n || codes[i] != codes[i - 1]) {
+                runCodes[run] = codes[i - 1];
+                runEnds[run++] = static_cast<uint16_t>(i);
+            }
+        }
+        return kRunLength | uint64_t(offset) << (kEncodingBits + kWidthBits);
+    }
+    payloads.resize(offset + deltaWords, 0);
+    uint32_t* starts = reinterpret_cast<uint32_t*>(payloads.data() + offset);
+    uint64_t* deltas = payloads.data() + offset + DeltaStartWords(n);
+    for (size_t i = 0; i < n; ++i) {
+        if (i % CodeColumn::kPackedBlock == 0) {
+            starts[i / CodeColumn::kPackedBlock] = codes[i];
+        } else {
+            PackValue(deltas, i, deltaWidth, codes[i] - codes[i - 1]);
+        }
+    }
+    return kDelta | uint64_t(deltaWidth) << kEncodingBits | uint64_t(offset) << (kEncodingBits + kWidthBits);
+}
+
+// True if a compressed directory and its payloads describe rows codes within bytes
+bool ValidCompressed(const void* data, size_t bytes, size_t rows) {
+    size_t blocks = (rows + CodeColumn::kCompressedBlock - 1) / CodeColumn::kCompressedBlock;
+    if (bytes % sizeof(uint64_t) != 0 || bytes / sizeof(uint64_t) < blocks) return false;
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    const uint64_t* directory = reinterpret_cast<const uint64_t*>(base);
+    size_t words = bytes / sizeof(uint64_t) - blocks;
+
+    for (size_t index = 0; index < blocks; ++index) {
+        uint64_t offset = directory[index] >> (kEncodingBits + kWidthBits);
+        CompressedBlock block = BlockAt(base, rows, index);
+        if (block.encoding > kDelta || block.width > 32 || offset >= words) return false;
+        size_t available = words - offset;
+        if (block.encoding == kFrameOfReference) {
+            if (1 + PackedBlocks(block.rows) * block.width > available) return false;
+        } else if (block.encoding == kDelta) {
+            if (DeltaStartWords(block.rows) + PackedBlocks(block.rows) * block.width > available) return false;
+        } else {
+            // Run ends must climb strictly to the end of the block
+            size_t runs = block.payload[0];
+            if (runs == 0 || runs > block.rows || RunLengthWords(runs) > available) return false;
+            const uint16_t* ends = RunEnds(block);
+            for (size_t run = 0; run < runs; ++run) {
+                if (ends[run] <= (run == 0 ? 0 : ends[run - 1])) return false;
+            }
+            if (ends[runs - 1] != block.rows) return false;
+        }
+    }
+    return true;
+}
+
+// Largest code a kernel lane holds
+inline uint64_t LaneMax(size_t lane) {
+    return lane == 3 ? ~uint64_t(0) : (uint64_t(1) << (8 << lane)) - 1;
+}
+
+// Lanes of offsets from reference, widened back to 32-bit codes
+void WidenLanes(size_t lane, const void* offsets, size_t n, size_t reference, uint32_t* codes) {
+    for (size_t i = 0; i < n; ++i) {
+        switch (lane) {
+            case 0:  codes[i] = static_cast<uint32_t>(reference + static_cast<const uint8_t*>(offsets)[i]); break;
+            case 1:  codes[i] = static_cast<uint32_t>(reference + static_cast<const uint16_t*>(offsets)[i]); break;
+            default: codes[i] = static_cast<uint32_t>(reference + static_cast<const uint32_t*>(offsets)[i]); break;
+        }
+    }
+}
+
+// Scan predicates on compressed blocks: Matches tests one code (a run), MayOverlap rules out codes
+// [lo, last], and Run is the kernel over lanes of offsets from a reference code.
+
+// Codes in [lo, last]
+class RangePredicate {
+public:
+    RangePredicate(size_t lo, size_t last, const ScanKernels& kernels) : lo_(lo), last_(last), kernels_(kernels) {}
+
+    bool Matches(size_t code) const { return code >= lo_ && code <= last_; }
+    bool MayOverlap(size_t lo, size_t last) const { return lo <= last_ && last >= lo_; }
+
+    // The bounds move by the reference instead of the offsets
+    size_t Run(size_t lane, const void* offsets, size_t n, uint32_t base, size_t reference, uint32_t* out) const {
+        if (last_ < reference) return 0;
+        uint64_t lo = lo_ > reference ? lo_ - reference : 0;
+        if (lo > LaneMax(lane)) return 0;
+        return kernels_.range[lane](offsets, n, base, lo, std::min<uint64_t>(last_ - reference, LaneMax(lane)), out);
+    }
+
+private:
+    size_t lo_, last_;
+    const ScanKernels& kernels_;
+};
+
+// Codes of a set
+class SetPredicate {
+public:
+    SetPredicate(const CodeSet& set, const ScanKernels& kernels) : set_(set), kernels_(kernels) {
+        if (set.Count() <= CodeSet::kSmallSet) members_ = set.Codes();
+    }
+
+    bool Matches(size_t code) const { return set_.Contains(code); }
+    bool MayOverlap(size_t lo, size_t last) const { return !set_.Empty() && lo <= set_.Max() && last >= set_.Min(); }
+
+    // Small sets move their members by the reference; the bitmap is indexed by code, so offsets from a
+    // nonzero reference are widened back to codes first
+    size_t Run(size_t lane, const void* offsets, size_t n, uint32_t base, size_t reference, uint32_t* out) const {
+        if (!members_.empty()) {
+            uint64_t keys[kMaxSmallSetKeys];
+            size_t count = 0;
+            for (size_t code : members_) {
+                if (code >= reference && code - reference <= LaneMax(lane)) keys[count++] = code - reference;
+            }
+            return count == 0 ? 0 : kernels_.smallSet[lane](offsets, n, base, keys, count, out);
+        }
+        if (reference == 0) return kernels_.bitmap[lane](offsets, n, base, set_.Bitmap(), out);
+        alignas(64) uint32_t codes[CodeColumn::kCompressedBlock];
+        WidenLanes(lane, offsets, n, reference, codes);
+        return kernels_.bitmap[LaneIndex(32)](codes, n, base, set_.Bitmap(), out);
+    }
+
+private:
+    const CodeSet& set_;
+    std::vector<size_t> members_;
+    const ScanKernels& kernels_;
+};
+
+// Append rows [begin, end) to results
+void AppendRows(size_t begin, size_t end, SelectionVector& results) {
+    uint32_t* out = results.Extend(end - begin);
+    std::iota(out, out + (end - begin), static_cast<uint32_t>(begin));
+}
+
+// Append the rows a predicate's kernel matches among n lanes of offsets from reference
+template <typename Predicate>
+void AppendMatches(const Predicate& predicate, size_t lane, const void* offsets, size_t n, size_t base,
+                   size_t reference, SelectionVector& results) {
+    size_t size = results.size();
+    uint32_t* out = results.Extend(n + kKernelSlack);
+    results.resize(size + predicate.Run(lane, offsets, n, static_cast<uint32_t>(base), reference, out));
+}
+
+// Scan rows [begin, end) of a compressed column without decompressing what the encoding lets a
+// predicate skip: a run-length block tests each run once, a frame-of-reference block is ruled out by its
+// bounds or compares the packed offsets (in place at 8/16/32 bits), and a delta block is non-decreasing,
+// so the starts of its 64-code blocks bound what each one holds.
+template <typename Predicate>
+void ScanBlocks(const uint8_t* data, size_t rows, size_t begin, size_t end, const Predicate& predicate,
+                SelectionVector& results) {
+    alignas(64) uint32_t unpacked[CodeColumn::kCompressedBlock];
+    for (size_t row = begin; row < end;) {
+        size_t index = row / CodeColumn::kCompressedBlock;
+        size_t first = index * CodeColumn::kCompressedBlock;
+        size_t stop = std::min(first + CodeColumn::kCompressedBlock, end);
+        CompressedBlock block = BlockAt(data, rows, index);
+        size_t lo = row - first, hi = stop - first;
+        row = stop;
+
+        if (block.encoding == kRunLength) {
+            const uint32_t* codes = RunCodes(block);
+            const uint16_t* ends = RunEnds(block);
+            for (size_t run = RunOf(block, lo), start = lo; start < hi; ++run) {
+                size_t runEnd = std::min<size_t>(ends[run], hi);
+                if (predicate.Matches(codes[run])) AppendRows(first + start, first + runEnd, results);
+                start = runEnd;
+            }
+        } else if (block.encoding == kFrameOfReference) {
+            size_t reference = block.payload[0];
+            size_t last = reference + (uint64_t(1) << block.width) - 1;
+            if (!predicate.MayOverlap(reference, last)) continue;
+            if (block.width == 0) {
+                if (predicate.Matches(reference)) AppendRows(first + lo, first + hi, results);
+            } else if (CodeColumn::IsByteAligned(block.width)) {
+                const uint8_t* offsets = reinterpret_cast<const uint8_t*>(block.payload + 1) + lo * (block.width / 8);
+                AppendMatches(predicate, LaneIndex(block.width), offsets, hi - lo, first + lo, reference, results);
+            } else {
+                size_t firstPacked = lo / CodeColumn::kPackedBlock;
+                for (size_t index = firstPacked; index * CodeColumn::kPackedBlock < hi; ++index) {
+                    UnpackPacked(block.payload + 1, block.width, index,
+                                 unpacked + (index - firstPacked) * CodeColumn::kPackedBlock);
+                }
+                AppendMatches(predicate, LaneIndex(32), unpacked + (lo - firstPacked * CodeColumn::kPackedBlock),
+                              hi - lo, first + lo, reference, results);
+            }
+        } else {
+            const uint32_t* starts = reinterpret_cast<const uint32_t*>(block.payload);
+            size_t packedBlocks = PackedBlocks(block.rows);
+            for (size_t start = lo; start < hi;) {
+                size_t index = start / CodeColumn::kPackedBlock;
+                size_t packedEnd = std::min((index + 1) * CodeColumn::kPackedBlock, hi);
+                size_t upper = index + 1 < packedBlocks ? starts[index + 1] : ~size_t(0);
+                if (predicate.MayOverlap(starts[index], upper)) {
+                    DecodeBlock(block, start, packedEnd, unpacked);
+                    AppendMatches(predicate, LaneIndex(32), unpacked, packedEnd - start, first + start, 0, results);
+                }
+                start = packedEnd;
+            }
+        }
+    }
+}
+
+// Portable kernels for the one-row-at-a-time scans of compressed columns
+const ScanKernels& ScalarKernels() {
+    static const ScanKernels kernels = MakeScanKernels(SimdLevel::Scalar);
+    return kernels;
+}
+
+} // namespace
+
+// Pick the storage width for codes 0 .. cardinality - 1
+unsigned CodeColumn::ChooseBitWidth(size_t cardinality) {
+    unsigned bits = 1;
+    while (bits < 64 && (uint64_t(1) << bits) < cardinality) {
+        bits++;
+    }
+    if (bits > 32) return 64;
+
+    unsigned aligned = bits <= 8 ? 8 : bits <= 16 ? 16 : 32;
+
+    // Byte-aligned kernels are cheaper per code, so only bit-pack when it saves at least a quarter of the bytes
+    if (4 * (aligned - bits) >= aligned) return bits;
+    return aligned;
+}
+
+// Bytes needed to store rows codes at bitWidth
+size_t CodeColumn::BytesFor(size_t rows, unsigned bitWidth) {
+    if (IsByteAligned(bitWidth)) {
+        return rows * (bitWidth / 8);
+    }
+    // Bit-packed storage is always a whole number of 64-code blocks (bitWidth words each)
+    size_t blocks = (rows + kPackedBlock - 1) / kPackedBlock;
+    return blocks * bitWidth * sizeof(uint64_t);
+}
+
+// Pack codes into owned storage at bitWidth
+void CodeColumn::Pack(const std::vector<size_t>& codes, unsigned bitWidth) {
+    Allocate(codes.size(), bitWidth);
+    for (size_t i = 0; i < codes.size(); ++i) {
+        Set(i, codes[i]);
+    }
+}
+
+// Allocate zeroed owned storage for rows codes at bitWidth
+void CodeColumn::Allocate(size_t rows, unsigned bitWidth) {
+    owned_.assign((BytesFor(rows, bitWidth) + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    data_ = reinterpret_cast<const uint8_t*>(owned_.data());
+    size_ = rows;
+    bitWidth_ = bitWidth;
+    compressed_ = false;
+    compressedBytes_ = 0;
+}
+
+// Store a code into allocated storage
+void CodeColumn::Set(size_t index, size_t code) {
+    uint8_t* out = reinterpret_cast<uint8_t*>(owned_.data());
+    switch (bitWidth_) {
+        case 8:  out[index] = static_cast<uint8_t>(code); break;
+        case 16: reinterpret_cast<uint16_t*>(out)[index] = static_cast<uint16_t>(code); break;
+        case 32: reinterpret_cast<uint32_t*>(out)[index] = static_cast<uint32_t>(code); break;
+        case 64: owned_[index] = code; break;
+        default: {
+            // Bits are OR-ed into zeroed words; a code never straddles into the next block
+            size_t pos = index * bitWidth_;
+            size_t word = pos >> 6;
+            unsigned shift = pos & 63;
+            owned_[word] |= static_cast<uint64_t>(code) << shift;
+            if (shift + bitWidth_ > 64) {
+                owned_[word + 1] |= static_cast<uint64_t>(code) >> (64 - shift);
+            }
+            break;
+        }
+    }
+}
+
+// Compress every block with the smallest of its encodings; codes wider than 32 bits stay as they are
+bool CodeColumn::Compress() {
+    if (compressed_ || bitWidth_ > 32 || size_ == 0) return compressed_;
+
+    size_t blocks = (size_ + kCompressedBlock - 1) / kCompressedBlock;
+    std::vector<uint64_t> directory(blocks);
+    std::vector<uint64_t> payloads;
+    size_t codes[kCompressedBlock];
+    uint32_t narrow[kCompressedBlock];
+    for (size_t index = 0; index < blocks; ++index) {
+        size_t begin = index * kCompressedBlock;
+        size_t n = std::min(kCompressedBlock, size_ - begin);
+        Unpack(begin, begin + n, codes);
+        std::copy(codes, codes + n, narrow);
+        directory[index] = CompressBlock(narrow, n, payloads);
+    }
+
+    // Like bit-packing, only worth it when it saves at least a quarter of the bytes
+    size_t bytes = (blocks + payloads.size()) * sizeof(uint64_t);
+    if (4 * bytes > 3 * Bytes()) return false;
+    directory.insert(directory.end(), payloads.begin(), payloads.end());
+    owned_ = std::move(directory);
+    data_ = reinterpret_cast<const uint8_t*>(owned_.data());
+    compressed_ = true;
+    compressedBytes_ = bytes;
+    return true;
+}
+
+// Point the column at already packed or compressed codes
+bool CodeColumn::Attach(const void* data, size_t bytes, size_t rows, unsigned bitWidth, bool compressed) {
+    if (bitWidth == 0 || (bitWidth > 32 && bitWidth != 64)) return false;
+    if (compressed ? bitWidth > 32 || !ValidCompressed(data, bytes, rows) : bytes != BytesFor(rows, bitWidth)) {
+        return false;
+    }
+    owned_.clear();
+    owned_.shrink_to_fit();
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = rows;
+    bitWidth_ = bitWidth;
+    compressed_ = compressed;
+    compressedBytes_ = compressed ? bytes : 0;
+    return true;
+}
+
+// Drop the codes
+void CodeColumn::Clear() {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    data_ = nullptr;
+    size_ = 0;
+    bitWidth_ = 64;
+    compressed_ = false;
+    compressedBytes_ = 0;
+}
+
+// Code stored at a row
+size_t CodeColumn::Get(size_t index) const {
+    if (compressed_) {
+        return BlockCode(BlockAt(data_, size_, index / kCompressedBlock), index % kCompressedBlock);
+    }
+    switch (bitWidth_) {
+        case 8:  return data_[index];
+        case 16: return reinterpret_cast<const uint16_t*>(data_)[index];
+        case 32: return reinterpret_cast<const uint32_t*>(data_)[index];
+        case 64: return reinterpret_cast<const uint64_t*>(data_)[index];
+        default: {
+            const uint64_t* words = reinterpret_cast<const uint64_t*>(data_);
+            size_t pos = index * bitWidth_;
+            size_t word = pos >> 6;
+            unsigned shift = pos & 63;
+            uint64_t value = words[word] >> shift;
+            if (shift + bitWidth_ > 64) {
+                value |= words[word + 1] << (64 - shift);
+            }
+            return value & ((uint64_t(1) << bitWidth_) - 1);
+        }
+    }
+}
+
+// Codes of the given rows, in the order given
+void CodeColumn::Gather(const uint32_t* rows, size_t n, size_t* codes) const {
+    if (compressed_) {
+        // A block holding several of the rows is decoded once, a lone row is looked up on its own
+        alignas(64) uint32_t block[kCompressedBlock];
+        size_t decoded = kAllRows;
+        for (size_t i = 0; i < n; ++i) {
+            size_t index = rows[i] / kCompressedBlock;
+            if (index != decoded && i + 1 < n && rows[i + 1] / kCompressedBlock == index) {
+                CompressedBlock compressed = BlockAt(data_, size_, index);
+                DecodeBlock(compressed, 0, compressed.rows, block);
+                decoded = index;
+            }
+            codes[i] = index == decoded ? block[rows[i] % kCompressedBlock] : Get(rows[i]);
+        }
+        return;
+    }
+    switch (bitWidth_) {
+        case 8:  GatherTyped<uint8_t>(data_, rows, n, codes); break;
+        case 16: GatherTyped<uint16_t>(data_, rows, n, codes); break;
+        case 32: GatherTyped<uint32_t>(data_, rows, n, codes); break;
+        case 64: GatherTyped<uint64_t>(data_, rows, n, codes); break;
+        default:
+            for (size_t i = 0; i < n; ++i) {
+                codes[i] = Get(rows[i]);
+            }
+            break;
+    }
+}
+
+// Codes of rows [begin, end); bit-packed rows are unpacked a whole block at a time
+void CodeColumn::Unpack(size_t begin, size_t end, size_t* codes) const {
+    end = std::min(end, size_);
+    if (begin >= end) return;
+
+    if (compressed_) {
+        alignas(64) uint32_t block[kCompressedBlock];
+        for (size_t row = begin; row < end;) {
+            size_t first = row - row % kCompressedBlock;
+            size_t stop = std::min(first + kCompressedBlock, end);
+            DecodeBlock(BlockAt(data_, size_, row / kCompressedBlock), row - first, stop - first, block);
+            codes = std::copy(block, block + (stop - row), codes);
+            row = stop;
+        }
+        return;
+    }
+
+    switch (bitWidth_) {
+        case 8:  WidenTyped<uint8_t>(RowData(begin), end - begin, codes); return;
+        case 16: WidenTyped<uint16_t>(RowData(begin), end - begin, codes); return;
+        case 32: WidenTyped<uint32_t>(RowData(begin), end - begin, codes); return;
+        case 64: WidenTyped<uint64_t>(RowData(begin), end - begin, codes); return;
+        default: break;
+    }
+
+    // Rows before the first block boundary and after the last one come out one by one
+    size_t row = begin;
+    for (; row < end && row % kPackedBlock != 0; ++row) {
+        *codes++ = Get(row);
+    }
+    UnpackFn unpack = kUnpackers[bitWidth_];
+    alignas(64) uint32_t block[kPackedBlock];
+    for (; row + kPackedBlock <= end; row += kPackedBlock) {
+        unpack(reinterpret_cast<const uint64_t*>(RowData(row)), block);
+        codes = std::copy(block, block + kPackedBlock, codes);
+    }
+    for (; row < end; ++row) {
+        *codes++ = Get(row);
+    }
+}
+
+// Count the codes of rows [begin, end); bit-packed rows are unpacked a whole block at a time
+void CodeColumn::CountCodes(size_t begin, size_t end, uint32_t* counts) const {
+    end = std::min(end, size_);
+    if (begin >= end) return;
+
+    // Runs are counted whole, other blocks are decoded
+    if (compressed_) {
+        alignas(64) uint32_t codes[kCompressedBlock];
+        for (size_t row = begin; row < end;) {
+            size_t first = row - row % kCompressedBlock;
+            size_t stop = std::min(first + kCompressedBlock, end);
+            CompressedBlock block = BlockAt(data_, size_, row / kCompressedBlock);
+            if (block.encoding == kRunLength) {
+                const uint16_t* ends = RunEnds(block);
+                for (size_t run = RunOf(block, row - first), start = row - first; start < stop - first; ++run) {
+                    size_t runEnd = std::min<size_t>(ends[run], stop - first);
+                    counts[RunCodes(block)[run]] += static_cast<uint32_t>(runEnd - start);
+                    start = runEnd;
+                }
+            } else {
+                DecodeBlock(block, row - first, stop - first, codes);
+                for (size_t i = 0; i < stop - row; ++i) {
+                    counts[codes[i]]++;
+                }
+            }
+            row = stop;
+        }
+        return;
+    }
+
+    switch (bitWidth_) {
+        case 8:  CountBytes(RowData(begin), end - begin, counts); return;
+        case 16: CountTyped<uint16_t>(RowData(begin), end - begin, counts); return;
+        case 32: CountTyped<uint32_t>(RowData(begin), end - begin, counts); return;
+        case 64: CountTyped<uint64_t>(RowData(begin), end - begin, counts); return;
+        default: break;
+    }
+
+    size_t row = begin;
+    for (; row < end && row % kPackedBlock != 0; ++row) {
+        counts[Get(row)]++;
+    }
+    UnpackFn unpack = kUnpackers[bitWidth_];
+    alignas(64) uint32_t block[kPackedBlock];
+    for (; row + kPackedBlock <= end; row += kPackedBlock) {
+        unpack(reinterpret_cast<const uint64_t*>(RowData(row)), block);
+        for (size_t i = 0; i < kPackedBlock; ++i) {
+            counts[block[i]]++;
+        }
+    }
+    for (; row < end; ++row) {
+        counts[Get(row)]++;
+    }
+}
+
+// Start of row in the packed codes. Bit-packed rows must start a block.
+const uint8_t* CodeColumn::RowData(size_t row) const {
+    if (IsByteAligned(bitWidth_)) {
+        return data_ + row * (bitWidth_ / 8);
+    }
+    return data_ + (row / kPackedBlock) * bitWidth_ * sizeof(uint64_t);
+}
+
+// Run a code kernel over rows [begin, end), kKernelRows at a time. Byte-aligned codes go to the kernel
+// in place, bit-packed codes are unpacked to 32-bit lanes first; each call writes straight into results.
+template <typename Kernel>
+void CodeColumn::RunKernel(size_t begin, size_t end, SelectionVector& results, Kernel kernel) const {
+    bool aligned = IsByteAligned(bitWidth_);
+    size_t lane = aligned ? LaneIndex(bitWidth_) : LaneIndex(32);
+    UnpackFn unpack = aligned ? nullptr : kUnpackers[bitWidth_];
+    alignas(64) uint32_t unpacked[kKernelRows];
+
+    for (size_t start = begin; start < end; start += kKernelRows) {
+        size_t n = std::min(kKernelRows, end - start);
+        const void* codes = RowData(start);
+        if (!aligned) {
+            const uint64_t* words = reinterpret_cast<const uint64_t*>(codes);
+            for (size_t block = 0; block * kPackedBlock < n; ++block) {
+                unpack(words + block * bitWidth_, unpacked + block * kPackedBlock);
+            }
+            codes = unpacked;
+        }
+
+        size_t size = results.size();
+        uint32_t* out = results.Extend(n + kKernelSlack);
+        results.resize(size + kernel(lane, codes, n, static_cast<uint32_t>(start), out));
+    }
+}
+
+// Append every row in [begin, end) whose code equals code, one row at a time
+void CodeColumn::ScanEqualScalar(size_t code, SelectionVector& results, size_t begin, size_t end) const {
+    ScanRangeScalar(code, code + 1, results, begin, end);
+}
+
+// Append every row in [begin, end) whose code equals code, using the SIMD kernel for the column's width
+void CodeColumn::ScanEqual(size_t code, SelectionVector& results, size_t begin, size_t end) const {
+    end = std::min(end, size_);
+    // A code wider than the column cannot be stored in it
+    if (begin >= end || (bitWidth_ < 64 && code >> bitWidth_)) return;
+
+    const ScanKernels& kernels = ActiveKernels();
+    if (compressed_) {
+        ScanBlocks(data_, size_, begin, end, RangePredicate(code, code, kernels), results);
+        return;
+    }
+    RunKernel(begin, end, results, [&](size_t lane, const void* codes, size_t n, uint32_t base, uint32_t* out) {
+        return kernels.range[lane](codes, n, base, code, code, out);
+    });
+}
+
+// Append every row in [begin, end) whose code lies in [lo, hi), one row at a time
+void CodeColumn::ScanRangeScalar(size_t lo, size_t hi, SelectionVector& results, size_t begin, size_t end) const {
+    end = std::min(end, size_);
+    if (lo >= hi || begin >= end) return;
+    if (compressed_) {
+        ScanBlocks(data_, size_, begin, end, RangePredicate(lo, hi - 1, ScalarKernels()), results);
+        return;
+    }
+
+    const uint8_t* data = RowData(begin);
+    size_t n = end - begin;
+    switch (bitWidth_) {
+        case 8:  ScanRangeScalarTyped<uint8_t>(data, n, begin, lo, hi, results); break;
+        case 16: ScanRangeScalarTyped<uint16_t>(data, n, begin, lo, hi, results); break;
+        case 32: ScanRangeScalarTyped<uint32_t>(data, n, begin, lo, hi, results); break;
+        case 64: ScanRangeScalarTyped<uint64_t>(data, n, begin, lo, hi, results); break;
+        default:
+            for (size_t i = begin; i < end; ++i) {
+                size_t code = Get(i);
+                if (code >= lo && code < hi) {
+                    results.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            break;
+    }
+}
+
+// Append every row in [begin, end) whose code lies in [lo, hi), using the SIMD kernel for the column's width
+void CodeColumn::ScanRange(size_t lo, size_t hi, SelectionVector& results, size_t begin, size_t end) const {
+    end = std::min(end, size_);
+    // Clamp the range to the codes the column can hold, the kernels compare inclusive bounds
+    size_t maxCode = bitWidth_ < 64 ? (size_t(1) << bitWidth_) - 1 : ~size_t(0);
+    if (lo >= hi || lo > maxCode || begin >= end) return;
+    size_t last = std::min(hi - 1, maxCode);
+
+    const ScanKernels& kernels = ActiveKernels();
+    if (compressed_) {
+        ScanBlocks(data_, size_, begin, end, RangePredicate(lo, last, kernels), results);
+        return;
+    }
+    RunKernel(begin, end, results, [&](size_t lane, const void* codes, size_t n, uint32_t base, uint32_t* out) {
+        return kernels.range[lane](codes, n, base, lo, last, out);
+    });
+}
+
+// Append every row in [begin, end) whose code is in set, one row at a time
+void CodeColumn::ScanInScalar(const CodeSet& set, SelectionVector& results, size_t begin, size_t end) const {
+    end = std::min(end, size_);
+    if (begin >= end) return;
+    if (compressed_) {
+        ScanBlocks(data_, size_, begin, end, SetPredicate(set, ScalarKernels()), results);
+        return;
+    }
+
+    const uint8_t* data = RowData(begin);
+    size_t n = end - begin;
+    switch (bitWidth_) {
+        case 8:  ScanInScalarTyped<uint8_t>(data, n, begin, set, results); break;
+        case 16: ScanInScalarTyped<uint16_t>(data, n, begin, set, results); break;
+        case 32: ScanInScalarTyped<uint32_t>(data, n, begin, set, results); break;
+        case 64: ScanInScalarTyped<uint64_t>(data, n, begin, set, results); break;
+        default:
+            for (size_t i = begin; i < end; ++i) {
+                if (set.Contains(Get(i))) {
+                    results.push_back(static_cast<uint32_t>(i));
+                }
+            }
+            break;
+    }
+}
+
+// Append every row in [begin, end) whose code is in set, in one SIMD pass over the column
+void CodeColumn::ScanIn(const CodeSet& set, SelectionVector& results, size_t begin, size_t end) const {
+    end = std::min(end, size_);
+    if (set.Empty() || begin >= end) return;
+
+    // A contiguous set (e.g. a prefix on a sorted dictionary) is a single range compare
+    if (set.IsContiguous()) {
+        ScanRange(set.Min(), set.Max() + 1, results, begin, end);
+        return;
+    }
+
+    const ScanKernels& kernels = ActiveKernels();
+    if (compressed_) {
+        ScanBlocks(data_, size_, begin, end, SetPredicate(set, kernels), results);
+        return;
+    }
+
+    // Small sets: one equality compare per member
+    if (set.Count() <= CodeSet::kSmallSet) {
+        // Codes wider than the column cannot be stored in it (the kernels would truncate them)
+        size_t maxCode = bitWidth_ < 64 ? (size_t(1) << bitWidth_) - 1 : ~size_t(0);
+        uint64_t keys[kMaxSmallSetKeys];
+        size_t count = 0;
+        for (size_t code : set.Codes()) {
+            if (code <= maxCode) keys[count++] = code;
+        }
+        if (count == 0) return;
+        RunKernel(begin, end, results, [&](size_t lane, const void* data, size_t n, uint32_t base, uint32_t* out) {
+            return kernels.smallSet[lane](data, n, base, keys, count, out);
+        });
+        return;
+    }
+
+    // Larger sets: membership bits looked up in the set's bitmap (gathered where the instruction set allows)
+    const uint32_t* bitmap = set.Bitmap();
+    RunKernel(begin, end, results, [&](size_t lane, const void* data, size_t n, uint32_t base, uint32_t* out) {
+        return kernels.bitmap[lane](data, n, base, bitmap, out);
+    });
+}
@@ -0,0 +1,19 @@
+// CodeSet.cpp: Set of dictionary codes tested in a single pass over the encoded column
+#include "CodeSet.h"
+
+CodeSet::CodeSet(size_t codeSpace)
+    : bitmap_((codeSpace + 31) / 32 + 1, 0), codeSpace_(codeSpace) {}
+
+// Members in ascending order
+std::vector<size_t> CodeSet::Codes() const {
+    std::vector<size_t> codes;
+    codes.reserve(count_);
+    for (size_t w = min_ >> 5; count_ != 0 && w <= (max_ >> 5); ++w) {
+        uint32_t bits = bitmap_[w];
+        while (bits) {
+            codes.push_back(w * 32 + __builtin_ctz(bits));
+            bits &= bits - 1;
+        }
+    }
+    return codes;
+}
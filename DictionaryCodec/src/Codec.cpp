@@ -1,124 +1,1163 @@
 // Codec.cpp
 #include "Codec.h"
+#include "EncodedFormat.h"
+#include "QueryStats.h"
+#include "BoundedQueue.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
 #include <fstream>
 #include <iostream>
 #include <cstring>
-#include <immintrin.h>
 #include <thread>
 #include <chrono>
 #include <cstdlib>
+#include <string_view>
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <numeric>
+#include <iterator>
+
+namespace {
+
+// The dictionary build is partitioned into 2^kShardBits hash shards
+constexpr unsigned kShardBits = 6;
+constexpr size_t kDictionaryShards = size_t(1) << kShardBits;
+
+// Shard of a key hash, taken from the high bits of a mixed hash
+// (the per-shard hash tables bucket on the low bits)
+inline size_t ShardOf(size_t hash) {
+    return (hash * 0x9E3779B97F4A7C15ULL) >> (64 - kShardBits);
+}
 
-DictionaryCodec::DictionaryCodec() {}
+// One shard of the dictionary under construction: key -> first row the key appears at
+using BuildShard = std::unordered_map<std::string_view, size_t>;
 
-// Helper to load a column file into memory for processing
-std::vector<std::string> DictionaryCodec::LoadColumnFile(const std::string& inputFile) const {
-    std::cout << "Loading file." << std::endl;
-    std::ifstream file(inputFile);
-    std::vector<std::string> columnData;
-    std::string line;
-    while (std::getline(file, line)) {
-        columnData.push_back(line);
+// Point lookups use the posting index while the item matches fewer than 1 / kPostingScanRatio
+// of the rows; decoding a posting costs roughly this many scanned rows
+constexpr size_t kPostingScanRatio = 32;
+
+// Scans are split into morsels of kMorselRows rows. A morsel of codes fits in L2 at every width up to
+// 32 bits, and the count is a multiple of CodeColumn::kPackedBlock so bit-packed morsels start a block.
+// Base morsels are the zones of the zone map.
+constexpr size_t kMorselRows = ZoneMap::kZoneRows;
+
+// Code of a key missing from the dictionary
+constexpr size_t kNoCode = FrontCodedDictionary::kNotFound;
+
+// Selectivity estimates read the codes of this many evenly spaced rows
+constexpr size_t kEstimateRows = 4096;
+
+// Late materialization works kDecodeBatch rows at a time and prefetches dictionary entries this
+// many rows ahead of the copy (the offsets twice as far, since the key address depends on them)
+constexpr size_t kDecodeBatch = 1024;
+constexpr size_t kDecodePrefetch = 16;
+
+// Streaming encode: stages hand whole chunks to the next one through queues this deep, so at most
+// a few chunks of input (and their codes) are alive at once
+constexpr size_t kPipelineDepth = 2;
+
+// Rows of spilled codes repacked per step when a streamed file is finalized (whole packed blocks)
+constexpr size_t kRepackRows = size_t(1) << 20;
+
+// Zero bytes for padding sections out to kSectionAlignment
+const char kPadding[kSectionAlignment] = {};
+
+// Bytes of a dictionary section holding keys
+uint64_t DictionaryBytes(const StringArena& keys) {
+    return (keys.Size() + 1) * sizeof(uint64_t) + keys.BytesSize();
+}
+
+// Write a dictionary section: the arena's offsets, then its bytes
+void WriteDictionary(std::ofstream& file, const StringArena& keys) {
+    file.write(reinterpret_cast<const char*>(keys.Offsets()), (keys.Size() + 1) * sizeof(uint64_t));
+    file.write(keys.Bytes(), keys.BytesSize());
+}
+
+// Header of an encoded file: section offsets follow from the dictionary and the section sizes
+EncodedFileHeader MakeHeader(uint32_t flags, uint64_t rows, const StringArena& keys, unsigned codeBits,
+                             uint64_t codesBytes, uint64_t indexBytes, uint64_t prefixBytes, uint64_t zoneBytes) {
+    EncodedFileHeader header = {};
+    std::memcpy(header.magic, kEncodedMagic, sizeof(kEncodedMagic));
+    header.version = kEncodedVersion;
+    header.flags = flags;
+    header.dataSize = rows;
+    header.dictSize = keys.Size();
+    header.codeBits = codeBits;
+    header.dictOffset = AlignUp(sizeof(header), kSectionAlignment);
+    header.dictBytes = DictionaryBytes(keys);
+    header.codesOffset = AlignUp(header.dictOffset + header.dictBytes, kSectionAlignment);
+    header.codesBytes = codesBytes;
+    if ((flags & kFlagPostingIndex) != 0) {
+        header.indexOffset = AlignUp(header.codesOffset + header.codesBytes, kSectionAlignment);
+        header.indexBytes = indexBytes;
+    }
+    if ((flags & kFlagFrontCoded) != 0) {
+        uint64_t previousEnd = header.indexOffset != 0 ? header.indexOffset + header.indexBytes
+                                                       : header.codesOffset + header.codesBytes;
+        header.prefixOffset = AlignUp(previousEnd, kSectionAlignment);
+        header.prefixBytes = prefixBytes;
     }
+    if ((flags & kFlagZoneMap) != 0) {
+        uint64_t previousEnd = header.prefixOffset != 0 ? header.prefixOffset + header.prefixBytes
+                             : header.indexOffset != 0  ? header.indexOffset + header.indexBytes
+                                                        : header.codesOffset + header.codesBytes;
+        header.zoneOffset = AlignUp(previousEnd, kSectionAlignment);
+        header.zoneBytes = zoneBytes;
+    }
+    return header;
+}
+
+// Write the header and the dictionary section, padded up to the code section
+void WriteHeaderAndDictionary(std::ofstream& file, const EncodedFileHeader& header, const StringArena& keys) {
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(kPadding, header.dictOffset - sizeof(header));
+    WriteDictionary(file, keys);
+    file.write(kPadding, header.codesOffset - (header.dictOffset + header.dictBytes));
+}
+
+// Write an optional section that follows the one ending at previousEnd, padded up to its offset
+void WriteSection(std::ofstream& file, uint64_t previousEnd, uint64_t offset, const void* data, uint64_t bytes) {
+    file.write(kPadding, offset - previousEnd);
+    file.write(static_cast<const char*>(data), bytes);
+}
+
+// Write a whole encoded file: keys, codes and the optional index, prefix and zone sections (empty ones
+// are left out). It is written under a temporary name and renamed into place, so a file already at
+// path stays intact for the readers still mapping it.
+bool WriteEncodedFile(const std::string& path, bool sortedKeys, const StringArena& keys, const CodeColumn& codes,
+                      const PostingIndex& index, const FrontCodedDictionary& frontCoded, const ZoneMap& zoneMap) {
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open()) return false;
 
+    uint32_t flags = (sortedKeys ? kFlagSortedDictionary : 0) |
+                     (index.Empty() ? 0 : kFlagPostingIndex) |
+                     (frontCoded.Empty() ? 0 : kFlagFrontCoded) |
+                     (zoneMap.Empty() ? 0 : kFlagZoneMap) |
+                     (codes.IsCompressed() ? kFlagCompressedCodes : 0);
+    EncodedFileHeader header = MakeHeader(flags, codes.Size(), keys, codes.BitWidth(), codes.Bytes(),
+                                          index.Bytes(), frontCoded.Bytes(), zoneMap.Bytes());
+    WriteHeaderAndDictionary(file, header, keys);
+
+    // Code section
+    file.write(reinterpret_cast<const char*>(codes.Data()), header.codesBytes);
+    uint64_t end = header.codesOffset + header.codesBytes;
+
+    // Optional index, prefix and zone sections
+    if (!index.Empty()) {
+        WriteSection(file, end, header.indexOffset, index.Data(), header.indexBytes);
+        end = header.indexOffset + header.indexBytes;
+    }
+    if (!frontCoded.Empty()) {
+        WriteSection(file, end, header.prefixOffset, frontCoded.Data(), header.prefixBytes);
+        end = header.prefixOffset + header.prefixBytes;
+    }
+    if (!zoneMap.Empty()) {
+        WriteSection(file, end, header.zoneOffset, zoneMap.Data(), header.zoneBytes);
+    }
     file.close();
-    return columnData;
+    if (file.fail() || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
 }
 
-// Helper to load an encoded file into memory for processing
-void DictionaryCodec::LoadEncodedFile(const std::string& inputFile) {
+// File of delta segment index of the encoded file at path
+std::string DeltaPath(const std::string& path, size_t index) {
+    return path + ".delta" + std::to_string(index);
+}
+
+// Helper to check that every code stored in codes lies below codeCount. Codes index the dictionary,
+// counts and code sets unchecked, so a file is only trusted once this holds.
+bool CodesInRange(const CodeColumn& codes, size_t codeCount) {
+    SelectionVector outside;
+    codes.ScanRange(codeCount, ~size_t(0), outside);
+    return outside.empty();
+}
+
+// Remove the delta segment files of the encoded file at path (they are numbered without gaps)
+void RemoveDeltaFiles(const std::string& path) {
+    for (size_t index = 0; std::remove(DeltaPath(path, index).c_str()) == 0; ++index) {
+    }
+}
+
+// Write a delta segment file. It is written under a temporary name and renamed into place, so a
+// segment file is either complete or absent.
+bool WriteDeltaFile(const std::string& path, uint64_t firstRow, uint64_t firstCode, const StringArena& keys,
+                    const CodeColumn& codes) {
+    DeltaSegmentHeader header = {};
+    std::memcpy(header.magic, kDeltaMagic, sizeof(kDeltaMagic));
+    header.version = kEncodedVersion;
+    header.codeBits = codes.BitWidth();
+    header.firstRow = firstRow;
+    header.rows = codes.Size();
+    header.firstCode = firstCode;
+    header.newKeys = keys.Size();
+    header.dictOffset = AlignUp(sizeof(header), kSectionAlignment);
+    header.dictBytes = DictionaryBytes(keys);
+    header.codesOffset = AlignUp(header.dictOffset + header.dictBytes, kSectionAlignment);
+    header.codesBytes = codes.Bytes();
+
+    std::string tempPath = path + ".tmp";
+    std::ofstream file(tempPath, std::ios::binary);
+    if (!file.is_open()) return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(kPadding, header.dictOffset - sizeof(header));
+    WriteDictionary(file, keys);
+    file.write(kPadding, header.codesOffset - (header.dictOffset + header.dictBytes));
+    file.write(reinterpret_cast<const char*>(codes.Data()), header.codesBytes);
+    file.close();
+    if (file.fail() || std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        std::remove(tempPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+// Resolve 0 to the shared pool's thread count
+unsigned int ResolveThreads(unsigned int numThreads) {
+    return numThreads == 0 ? ThreadPool::Shared().Size() : numThreads;
+}
+
+// Helper to view rows held as strings, so they share the encode path of a mapped column file
+std::vector<std::string_view> RowViews(const std::vector<std::string>& rows) {
+    return std::vector<std::string_view>(rows.begin(), rows.end());
+}
+
+// Range [begin, end) of part index when n items are split into parts pieces
+std::pair<size_t, size_t> ChunkBounds(size_t n, size_t parts, size_t index) {
+    return {n * index / parts, n * (index + 1) / parts};
+}
+
+// Helper to count the rows and code bytes a scan of morsels reads toward the active query
+template <typename Morsels>
+void CountScanned(const Morsels& morsels) {
+    if (QueryTrace::Active() == nullptr) return;
+    size_t rows = 0, bytes = 0;
+    for (const auto& morsel : morsels) {
+        rows += morsel.end - morsel.begin;
+        bytes += (morsel.end - morsel.begin) * morsel.column->Bytes() / morsel.column->Size();
+    }
+    QueryTrace::Add(QueryCounter::RowsScanned, rows);
+    QueryTrace::Add(QueryCounter::BytesScanned, bytes);
+}
+
+// Run fn(t) for t in [0, numThreads) on the shared pool, at most numThreads at a time
+template <typename Fn>
+void RunOnThreads(unsigned int numThreads, Fn fn) {
+    ThreadPool::Shared().ParallelFor(numThreads, fn, numThreads);
+}
+
+} // namespace
+
+// Readers always find a version, an empty one until a column is encoded or loaded
+DictionaryCodec::DictionaryCodec() {
+    auto version = std::make_unique<Version>();
+    version->base = std::make_shared<BaseColumn>();
+    current_.store(version.release(), std::memory_order_release);
+}
+
+// No reader may still be inside the codec, so every version can go
+DictionaryCodec::~DictionaryCodec() {
+    WaitForCompaction();
+    for (const auto& [epoch, version] : retired_) {
+        delete version;
+    }
+    delete current_.load(std::memory_order_relaxed);
+}
+
+// Publish: new readers pin version from here on; readers already pinned keep the old one until they
+// leave, so it is retired at a new epoch and freed once the epoch manager reports them gone
+void DictionaryCodec::Publish(std::unique_ptr<Version> version, bool waitForReaders) {
+    const Version* old = current_.exchange(version.release(), std::memory_order_seq_cst);
+    uint64_t epoch = EpochManager::Shared().Advance();
+    retired_.emplace_back(epoch, old);
+    if (waitForReaders) {
+        EpochManager::Shared().Synchronize(epoch);
+    }
+    ReclaimVersions();
+}
+
+// Helper to free the retired versions no reader can still hold (they retire in epoch order)
+void DictionaryCodec::ReclaimVersions() {
+    const EpochManager& epochs = EpochManager::Shared();
+    size_t freed = 0;
+    while (freed < retired_.size() && epochs.Quiescent(retired_[freed].first)) {
+        delete retired_[freed].second;
+        ++freed;
+    }
+    retired_.erase(retired_.begin(), retired_.begin() + freed);
+}
+
+// Helper to map a column file and split it into rows on the shared pool, without a copy per line
+bool DictionaryCodec::LoadColumnFile(const std::string& inputFile, ColumnFile& column) const {
     std::cout << "Loading file." << std::endl;
-    std::ifstream file(inputFile);
+    if (!column.Open(inputFile)) {
+        std::cerr << "Error: could not open " << inputFile << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    size_t ind = 0;
-    size_t keyVal;
-    std::string dataStr;
+// Helper to load an encoded file into memory for processing
+bool DictionaryCodec::LoadEncodedFile(const std::string& inputFile) {
+    WaitForCompaction();
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+    return MapEncodedFile(inputFile);
+}
 
-    file >> dataSize_; // Load first line, size of data
+// Helper to load an encoded column embedded in a larger file
+bool DictionaryCodec::LoadEncodedSegment(const std::string& inputFile, size_t offset, size_t bytes) {
+    if (bytes == 0) {
+        std::cerr << "Error: empty encoded column in " << inputFile << std::endl;
+        return false;
+    }
+    WaitForCompaction();
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+    return MapEncodedFile(inputFile, offset, bytes);
+}
 
-    dataColumn_ = std::make_unique<std::string[]>(dataSize_);
+// Helper to map an encoded file and the delta segments appended to it, or an embedded encoded column
+bool DictionaryCodec::MapEncodedFile(const std::string& inputFile, size_t offset, size_t bytes) {
+    std::cout << "Loading file." << std::endl;
 
-    while (file >> keyVal) {
-        encodedColumn_.push_back(keyVal);
-        file >> dataStr;
-        dictionary_[dataStr] = keyVal;
-        dataColumn_[ind] = dataStr;
+    MappedFile file;
+    if (!file.Open(inputFile, offset, bytes)) {
+        std::cerr << "Error: could not map " << inputFile << std::endl;
+        return false;
+    }
+
+    // Validate the header before trusting any offsets in it
+    EncodedFileHeader header;
+    if (file.Size() < sizeof(header)) {
+        std::cerr << "Error: " << inputFile << " is too small to be an encoded file" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, kEncodedMagic, sizeof(kEncodedMagic)) != 0) {
+        std::cerr << "Error: " << inputFile << " is not an encoded file" << std::endl;
+        return false;
+    }
+    if (header.version != kEncodedVersion) {
+        std::cerr << "Error: " << inputFile << " has format version " << header.version
+                  << ", expected " << kEncodedVersion << std::endl;
+        return false;
+    }
+    if (header.dataSize > kMaxSelectableRows) {
+        std::cerr << "Error: " << inputFile << " has more rows than a selection can address" << std::endl;
+        return false;
+    }
+    if (!SectionFits(header.dictOffset, header.dictBytes, file.Size()) ||
+        !SectionFits(header.codesOffset, header.codesBytes, file.Size()) ||
+        header.codesOffset % kSectionAlignment != 0 ||
+        header.codeBits == 0 || (header.codeBits > 32 && header.codeBits != 64) ||
+        ((header.flags & kFlagCompressedCodes) == 0 &&
+         header.codesBytes != CodeColumn::BytesFor(header.dataSize, header.codeBits)) ||
+        header.dictSize >= header.dictBytes / sizeof(uint64_t)) {
+        std::cerr << "Error: " << inputFile << " has corrupt section offsets" << std::endl;
+        return false;
+    }
+    if ((header.flags & kFlagPostingIndex) != 0 &&
+        !SectionFits(header.indexOffset, header.indexBytes, file.Size())) {
+        std::cerr << "Error: " << inputFile << " has a corrupt index section" << std::endl;
+        return false;
+    }
+    if ((header.flags & kFlagFrontCoded) != 0 &&
+        !SectionFits(header.prefixOffset, header.prefixBytes, file.Size())) {
+        std::cerr << "Error: " << inputFile << " has a corrupt prefix section" << std::endl;
+        return false;
+    }
+    if ((header.flags & kFlagZoneMap) != 0 &&
+        (!SectionFits(header.zoneOffset, header.zoneBytes, file.Size()) ||
+         header.zoneOffset % kSectionAlignment != 0)) {
+        std::cerr << "Error: " << inputFile << " has a corrupt zone section" << std::endl;
+        return false;
+    }
 
-        ind++;
+    // The code section is checked before anything is replaced (a mapping keeps its address when moved)
+    CodeColumn codes;
+    if (!codes.Attach(file.Data() + header.codesOffset, header.codesBytes, header.dataSize, header.codeBits,
+                      (header.flags & kFlagCompressedCodes) != 0)) {
+        std::cerr << "Error: " << inputFile << " has a corrupt code section" << std::endl;
+        return false;
+    }
+    if (header.codeBits > CodeColumn::ChooseBitWidth(header.dictSize) || !CodesInRange(codes, header.dictSize)) {
+        std::cerr << "Error: " << inputFile << " has codes outside its dictionary" << std::endl;
+        return false;
     }
 
-    file.close();
+    // The dictionary section is already an arena (sections are 64-byte aligned, so its offsets can
+    // be read in place). Lookups use the front-coded prefix section in place too; only a file
+    // without one needs a hash lookup rebuilt.
+    const char* dictBase = file.Data() + header.dictOffset;
+    const char* keyBytes = dictBase + (header.dictSize + 1) * sizeof(uint64_t);
+    size_t keyBytesLen = header.dictBytes - (header.dictSize + 1) * sizeof(uint64_t);
+
+    // The new base is built aside and published whole, readers keep the current one meanwhile
+    auto base = std::make_unique<BaseColumn>();
+    if (header.dictOffset % alignof(uint64_t) != 0 ||
+        !base->keys.Attach(reinterpret_cast<const uint64_t*>(dictBase), header.dictSize, keyBytes, keyBytesLen)) {
+        std::cerr << "Error: " << inputFile << " has a corrupt dictionary" << std::endl;
+        return false;
+    }
+    if ((header.flags & kFlagFrontCoded) != 0 &&
+        (!base->frontCoded.Attach(file.Data() + header.prefixOffset, header.prefixBytes) ||
+         base->frontCoded.Size() != base->keys.Size())) {
+        std::cerr << "Warning: ignoring malformed prefix section in " << inputFile << std::endl;
+        base->frontCoded.Clear();
+    }
+    base->BuildLookup();
+
+    // Codes are scanned straight out of the mapping, no copy is made
+    file.AdviseSequential(header.codesOffset, header.codesBytes);
+    base->file = std::move(file);
+    base->codes = std::move(codes);
+    if ((header.flags & kFlagPostingIndex) != 0 &&
+        (!base->postingIndex.Attach(base->file.Data() + header.indexOffset, header.indexBytes) ||
+         base->postingIndex.CodeSpace() != header.dictSize)) {
+        std::cerr << "Warning: ignoring malformed posting index in " << inputFile << std::endl;
+        base->postingIndex.Clear();
+    }
+    if ((header.flags & kFlagZoneMap) != 0 &&
+        (!base->zoneMap.Attach(base->file.Data() + header.zoneOffset, header.zoneBytes) ||
+         base->zoneMap.Rows() != header.dataSize)) {
+        std::cerr << "Warning: ignoring malformed zone section in " << inputFile << std::endl;
+        base->zoneMap.Clear();
+    }
+    base->sortedDictionary = (header.flags & kFlagSortedDictionary) != 0;
+
+    auto version = std::make_unique<Version>();
+    version->base = std::move(base);
+    version->dataSize = header.dataSize;
+
+    // Appended rows: delta segments chain on from the base, up to the first missing or corrupt one.
+    // An embedded column has none.
+    encodedPath_.clear();
+    if (bytes == 0) {
+        encodedPath_ = inputFile;
+        while (MapDeltaSegment(DeltaPath(inputFile, version->deltas.size()), *version)) {
+        }
+    }
+    version->BuildDeltaLookup();
+    if (!version->deltas.empty()) {
+        std::cout << "Loaded " << version->deltas.size() << " delta segments." << std::endl;
+    }
+
+    // The replaced file is unmapped once no reader can still be scanning it
+    Publish(std::move(version), true);
     std::cout << "Finished loading file" << std::endl;
+    return true;
 }
 
-// Helper to write the dictionary and encoded column to a file
-bool DictionaryCodec::WriteEncodedColumnFile(const std::string& outputFile, const std::vector<std::string>& columnData) const {
-    std::cout << "Writing file." << std::endl;
+// Helper to map one delta segment, which must continue the rows and codes of version
+bool DictionaryCodec::MapDeltaSegment(const std::string& path, Version& version) const {
+    MappedFile file;
+    if (!file.Open(path)) return false;
+
+    DeltaSegmentHeader header;
+    bool valid = file.Size() >= sizeof(header);
+    if (valid) {
+        std::memcpy(&header, file.Data(), sizeof(header));
+        valid = std::memcmp(header.magic, kDeltaMagic, sizeof(kDeltaMagic)) == 0 &&
+                header.version == kEncodedVersion &&
+                header.firstRow == version.dataSize && header.firstCode == version.DictionarySize() &&
+                header.rows <= kMaxSelectableRows - version.dataSize &&
+                SectionFits(header.dictOffset, header.dictBytes, file.Size()) &&
+                header.dictOffset % alignof(uint64_t) == 0 &&
+                header.newKeys < header.dictBytes / sizeof(uint64_t) &&
+                SectionFits(header.codesOffset, header.codesBytes, file.Size()) &&
+                header.codesOffset % kSectionAlignment == 0 &&
+                header.codeBits != 0 && (header.codeBits <= 32 || header.codeBits == 64) &&
+                header.codesBytes == CodeColumn::BytesFor(header.rows, header.codeBits);
+    }
+    StringArena keys;
+    auto segment = std::make_shared<DeltaSegment>();
+    if (valid) {
+        const char* dictBase = file.Data() + header.dictOffset;
+        const char* keyBytes = dictBase + (header.newKeys + 1) * sizeof(uint64_t);
+        size_t keyBytesLen = header.dictBytes - (header.newKeys + 1) * sizeof(uint64_t);
+        valid = keys.Attach(reinterpret_cast<const uint64_t*>(dictBase), header.newKeys, keyBytes, keyBytesLen) &&
+                segment->codes.Attach(file.Data() + header.codesOffset, header.codesBytes, header.rows,
+                                      header.codeBits) &&
+                header.codeBits <= CodeColumn::ChooseBitWidth(header.firstCode + header.newKeys) &&
+                CodesInRange(segment->codes, header.firstCode + header.newKeys);
+    }
+    if (!valid) {
+        std::cerr << "Warning: ignoring " << path << " and the delta segments after it, it does not continue "
+                  << encodedPath_ << std::endl;
+        return false;
+    }
 
-    std::ofstream file(outputFile);
-    file << columnData.size() << "\n"; // First line is size of data
-    if (!file.is_open()) return false;
+    // New keys are copied (deltaKeys spans every segment), codes stay in the mapping
+    for (size_t i = 0; i < keys.Size(); ++i) {
+        version.deltaKeys.Add(keys.Get(i));
+    }
+    segment->file = std::move(file);
+    segment->firstRow = header.firstRow;
+    version.dataSize += header.rows;
+    version.deltas.push_back(std::move(segment));
+    return true;
+}
 
-    // Write dictionary --> format: key data
-    for (size_t i = 0; i < encodedColumn_.size(); i++) {
-        file << encodedColumn_[i] << "\n" << columnData[i] << "\n";
+// Helper to rebuild deltaLookup (adding keys may move the arena's bytes, so the views are rebuilt)
+void DictionaryCodec::Version::BuildDeltaLookup() {
+    deltaLookup.clear();
+    deltaLookup.reserve(deltaKeys.Size());
+    for (size_t i = 0; i < deltaKeys.Size(); ++i) {
+        deltaLookup.emplace(deltaKeys.Get(i), base->keys.Size() + i);
     }
-    file.close();
+}
 
-    return true;
+// Helper for the code stored at a row
+size_t DictionaryCodec::Version::CodeAt(size_t row) const {
+    if (row < base->codes.Size()) {
+        return base->codes.Get(row);
+    }
+    // The last segment starting at or before row holds it
+    auto next = std::upper_bound(deltas.begin(), deltas.end(), row,
+                                 [](size_t r, const auto& delta) { return r < delta->firstRow; });
+    const DeltaSegment& delta = **std::prev(next);
+    return delta.codes.Get(row - delta.firstRow);
+}
+
+// Helper to publish a freshly encoded base, written to outputFile, with no delta segments
+void DictionaryCodec::PublishEncoded(std::unique_ptr<BaseColumn> base, const std::string& outputFile) {
+    auto version = std::make_unique<Version>();
+    version->dataSize = base->codes.Size();
+    version->base = std::move(base);
+    encodedPath_ = outputFile;
+    Publish(std::move(version), true);
+}
+
+// Helper to rebuild dictionary after keys or frontCoded change
+void DictionaryCodec::BaseColumn::BuildLookup() {
+    // A front-coded dictionary answers lookups itself, the hash table is only kept without one.
+    // The views point into keys, which must not grow while dictionary is in use.
+    std::unordered_map<std::string_view, size_t>().swap(dictionary);
+    if (!frontCoded.Empty()) return;
+    dictionary.reserve(keys.Size());
+    for (size_t code = 0; code < keys.Size(); ++code) {
+        dictionary.emplace(keys.Get(code), code);
+    }
+}
+
+// Helper to look up the code of a key, in the base dictionary then among the appended keys
+size_t DictionaryCodec::Version::FindCode(std::string_view key) const {
+    size_t code = kNoCode;
+    if (!base->frontCoded.Empty()) {
+        code = base->frontCoded.Find(key);
+    } else {
+        QueryTrace::Add(QueryCounter::KeysProbed, 1);
+        auto it = base->dictionary.find(key);
+        if (it != base->dictionary.end()) code = it->second;
+    }
+    if (code == kNoCode && !deltaLookup.empty()) {
+        QueryTrace::Add(QueryCounter::KeysProbed, 1);
+        auto it = deltaLookup.find(key);
+        if (it != deltaLookup.end()) code = it->second;
+    }
+    return code;
+}
+
+// Helper to add the codes of appended keys starting with prefix
+void DictionaryCodec::Version::AddAppendedPrefixCodes(std::string_view prefix, CodeSet& codes) const {
+    QueryTrace::Add(QueryCounter::KeysProbed, deltaKeys.Size());
+    for (size_t i = 0; i < deltaKeys.Size(); ++i) {
+        if (deltaKeys.Get(i).substr(0, prefix.size()) == prefix) {
+            codes.Insert(base->keys.Size() + i);
+        }
+    }
+}
+
+// Helper to find the code interval [lo, hi) of keys starting with prefix
+std::pair<size_t, size_t> DictionaryCodec::Version::PrefixCodeRange(std::string_view prefix) const {
+    // Sorted positions of the front-coded dictionary are the codes themselves
+    if (!base->frontCoded.Empty()) {
+        return base->frontCoded.PrefixRange(prefix);
+    }
+
+    // Binary searches over codes: first key not below the prefix, then the end of the keys
+    // starting with it (they sort directly after the prefix itself)
+    const StringArena& keys = base->keys;
+    size_t lo = 0, hi = keys.Size();
+    size_t probes = 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys.Get(mid) < prefix) lo = mid + 1; else hi = mid;
+        probes++;
+    }
+    size_t first = lo;
+    hi = keys.Size();
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (keys.Get(mid).substr(0, prefix.size()) == prefix) lo = mid + 1; else hi = mid;
+        probes++;
+    }
+    QueryTrace::Add(QueryCounter::KeysProbed, probes);
+    return {first, lo};
 }
 
 // Multi-threaded dictionary builder
-void DictionaryCodec::BuildDictionary(const std::vector<std::string>& columnData, unsigned int numThreads) {
+void DictionaryCodec::BuildDictionary(BaseColumn& base, const std::vector<std::string_view>& columnData,
+                                      bool sortedKeys, unsigned int numThreads) {
     std::cout << "Building dictionary." << std::endl;
 
-    std::mutex localMutex;
-    int code = 0;
+    numThreads = ResolveThreads(numThreads);
+    size_t rows = columnData.size();
+    std::hash<std::string_view> hasher;
 
-    auto encodeChunk = [&](size_t start, size_t end) {
-        std::unordered_map<std::string, int> localDictionary;
+    // Pass 1: every thread collects the distinct keys of its row range, already split by shard
+    std::vector<std::vector<BuildShard>> local(numThreads, std::vector<BuildShard>(kDictionaryShards));
+    RunOnThreads(numThreads, [&](size_t t) {
+        auto [start, end] = ChunkBounds(rows, numThreads, t);
+        std::vector<BuildShard>& shards = local[t];
         for (size_t i = start; i < end; ++i) {
-            const auto& item = columnData[i];
-            if (localDictionary.find(item) == localDictionary.end()) {
-                localDictionary[item] = code++;
+            std::string_view key = columnData[i];
+            // emplace keeps the first row the key appears at within this range
+            shards[ShardOf(hasher(key))].emplace(key, i);
+        }
+    });
+
+    // Pass 2: each shard is merged by exactly one thread, so the merge needs no locks.
+    // Ranges are merged in row order, so the first insert of a key holds its first row overall.
+    std::vector<BuildShard> shards(kDictionaryShards);
+    RunOnThreads(numThreads, [&](size_t t) {
+        for (size_t s = t; s < kDictionaryShards; s += numThreads) {
+            for (auto& threadShards : local) {
+                shards[s].insert(threadShards[s].begin(), threadShards[s].end());
+                BuildShard().swap(threadShards[s]);
             }
         }
-        std::lock_guard<std::mutex> lock(localMutex);
-        for (const auto& [key, value] : localDictionary) {
-            dictionary_[key] = value;
+    });
+
+    // Pass 3: deterministic global codes, either by first appearance (what a single-threaded
+    // encoder would assign) or by key for an order-preserving dictionary
+    std::vector<std::pair<std::string_view, size_t>> entries;
+    for (const BuildShard& shard : shards) {
+        entries.insert(entries.end(), shard.begin(), shard.end());
+    }
+    shards.clear();
+
+    if (sortedKeys) {
+        // string_view compares bytes as unsigned char, the same order PrefixCodeRange searches in
+        std::sort(entries.begin(), entries.end());
+    } else {
+        std::sort(entries.begin(), entries.end(),
+                  [](const auto& a, const auto& b) { return a.second < b.second; });
+    }
+
+    // Copy every distinct key once into the arena, in code order
+    size_t keyBytes = 0;
+    for (const auto& entry : entries) {
+        keyBytes += entry.first.size();
+    }
+    base.dictionary.clear();
+    base.frontCoded.Clear();
+    base.keys.Reset(entries.size(), keyBytes);
+    for (const auto& entry : entries) {
+        base.keys.Add(entry.first);
+    }
+    base.BuildLookup();
+    base.sortedDictionary = sortedKeys;
+}
+
+// Multi-threaded encode pass, writing codes straight into base.codes
+void DictionaryCodec::EncodeRows(BaseColumn& base, const std::vector<std::string_view>& columnData,
+                                 unsigned int numThreads) {
+    std::cout << "Encoding rows." << std::endl;
+
+    numThreads = ResolveThreads(numThreads);
+    size_t rows = columnData.size();
+
+    // Store the codes at the narrowest width the dictionary allows (a zone map of older codes no longer applies)
+    base.zoneMap.Clear();
+    base.codes.Allocate(rows, CodeColumn::ChooseBitWidth(base.dictionary.size()));
+
+    // Ranges are cut on packed-block boundaries so no two threads write the same word
+    size_t blocks = (rows + CodeColumn::kPackedBlock - 1) / CodeColumn::kPackedBlock;
+    RunOnThreads(numThreads, [&](size_t t) {
+        auto [firstBlock, lastBlock] = ChunkBounds(blocks, numThreads, t);
+        size_t start = firstBlock * CodeColumn::kPackedBlock;
+        size_t end = std::min(lastBlock * CodeColumn::kPackedBlock, rows);
+        for (size_t i = start; i < end; ++i) {
+            // base.dictionary is read-only here, concurrent finds are safe
+            base.codes.Set(i, base.dictionary.find(columnData[i])->second);
         }
-    };
+    });
+}
 
-    size_t chunkSize = columnData.size() / numThreads;
-    std::vector<std::thread> threads;
+// Encoding: Perform dictionary encoding on a column file
+bool DictionaryCodec::EncodeColumnFile(const std::string& inputFile, const std::string& outputFile,
+                                       const EncodeOptions& options) {
+    WaitForCompaction();
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+
+    // Rows appended to an earlier file at this path belong to the old column
+    RemoveDeltaFiles(outputFile);
+    if (options.streaming) {
+        return StreamEncodeColumnFile(inputFile, outputFile, options);
+    }
 
-    for (size_t i = 0; i < numThreads; ++i) {
-        size_t start = i * chunkSize;
-        size_t end = (i == numThreads - 1) ? columnData.size() : start + chunkSize;
-        threads.emplace_back(encodeChunk, start, end);
+    // Rows are views into the mapped file, which stays mapped until the dictionary holds its own copies
+    ColumnFile column;
+    if (!LoadColumnFile(inputFile, column)) return false;
+    if (column.Size() > kMaxSelectableRows) {
+        std::cerr << "Error: " << inputFile << " has more rows than a selection can address" << std::endl;
+        return false;
     }
+    return EncodeColumnData(column.Rows(), outputFile, options);
+}
 
-    for (auto& thread : threads) {
-        thread.join();
+// Encoding: Perform dictionary encoding on rows in memory
+bool DictionaryCodec::EncodeColumn(const std::vector<std::string>& rows, const std::string& outputFile,
+                                   const EncodeOptions& options) {
+    WaitForCompaction();
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+    RemoveDeltaFiles(outputFile);
+    if (rows.size() > kMaxSelectableRows) {
+        std::cerr << "Error: " << rows.size() << " rows are more than a selection can address" << std::endl;
+        return false;
     }
+    return EncodeColumnData(RowViews(rows), outputFile, options);
 }
 
-// Encoding: Perform dictionary encoding on a column file
-bool DictionaryCodec::EncodeColumnFile(const std::string& inputFile, const std::string& outputFile) {
-    auto columnData = LoadColumnFile(inputFile);
-    BuildDictionary(columnData);
+// Helper to encode rows in memory: dictionary, codes, lookups, zone map, optional index and compression
+bool DictionaryCodec::EncodeColumnData(const std::vector<std::string_view>& columnData, const std::string& outputFile,
+                                       const EncodeOptions& options) {
+    // The new column is built aside, readers keep the current version until it is published
+    auto base = std::make_unique<BaseColumn>();
+    BuildDictionary(*base, columnData, options.sortedDictionary);
+    EncodeRows(*base, columnData);
+
+    // Once every row is encoded the front-coded dictionary takes over lookups from the hash table
+    std::cout << "Front-coding dictionary." << std::endl;
+    base->frontCoded.Build(base->keys, base->sortedDictionary);
+    base->BuildLookup();
+
+    // Per-morsel code bounds and presence filters, so scans skip morsels that cannot match
+    std::cout << "Building zone map." << std::endl;
+    base->zoneMap.Build(base->codes, base->keys.Size());
+
+    if (options.buildPostingIndex) {
+        std::cout << "Building posting index." << std::endl;
+        base->postingIndex.Build(base->codes, base->keys.Size());
+    }
 
-    // Encode column using dictionary
-    encodedColumn_.reserve(columnData.size());
-    for (const auto& item : columnData) {
-        encodedColumn_.push_back(dictionary_[item]);
+    // Compressed last, the zone map and index are built faster from plain codes
+    if (options.compressCodes) {
+        std::cout << "Compressing codes." << std::endl;
+        if (!base->codes.Compress()) {
+            std::cout << "Codes left uncompressed, compression would save less than a quarter." << std::endl;
+        }
     }
 
-    return WriteEncodedColumnFile(outputFile, columnData);
+    std::cout << "Writing file." << std::endl;
+    if (!WriteEncodedFile(outputFile, base->sortedDictionary, base->keys, base->codes, base->postingIndex,
+                          base->frontCoded, base->zoneMap)) {
+        return false;
+    }
+    PublishEncoded(std::move(base), outputFile);
+    return true;
+}
+
+// Streaming encode: a reader thread cuts the input into chunks of whole lines, this thread encodes each
+// chunk against a growing dictionary (codes in order of first appearance), and a writer thread spills
+// the 32-bit codes to a temporary file. Once the input is done the file is written with the final
+// dictionary, repacking the spilled codes to the final width a slice at a time.
+bool DictionaryCodec::StreamEncodeColumnFile(const std::string& inputFile, const std::string& outputFile,
+                                             const EncodeOptions& options) {
+    if (options.buildPostingIndex) {
+        std::cerr << "Error: the posting index needs every row in memory, encode without streaming" << std::endl;
+        return false;
+    }
+    if (options.compressCodes) {
+        std::cerr << "Error: block compression needs every row in memory, encode without streaming" << std::endl;
+        return false;
+    }
+    std::ifstream input(inputFile, std::ios::binary);
+    if (!input.is_open()) {
+        std::cerr << "Error: could not open " << inputFile << std::endl;
+        return false;
+    }
+    std::string spillFile = outputFile + ".codes.tmp";
+    std::ofstream spill(spillFile, std::ios::binary | std::ios::trunc);
+    if (!spill.is_open()) {
+        std::cerr << "Error: could not create " << spillFile << std::endl;
+        return false;
+    }
+
+    std::cout << "Streaming encode." << std::endl;
+    size_t chunkBytes = std::max<size_t>(options.chunkBytes, 1);
+    BoundedQueue<std::string> chunks(kPipelineDepth);
+    BoundedQueue<std::vector<uint32_t>> encoded(kPipelineDepth);
+
+    // Reader: chunks end after the last newline, the partial line carries into the next chunk
+    std::thread reader([&] {
+        std::string carry;
+        for (;;) {
+            std::string chunk = std::move(carry);
+            size_t filled = chunk.size();
+            chunk.resize(filled + chunkBytes);
+            input.read(&chunk[filled], chunkBytes);
+            chunk.resize(filled + input.gcount());
+            if (input.gcount() == 0) {
+                // End of input: a last line without a newline is still a row
+                if (!chunk.empty()) chunks.Push(std::move(chunk));
+                break;
+            }
+            size_t cut = chunk.rfind('\n');
+            if (cut == std::string::npos) {
+                carry = std::move(chunk); // A line longer than a chunk, keep reading
+                continue;
+            }
+            carry.assign(chunk, cut + 1, std::string::npos);
+            chunk.resize(cut + 1);
+            if (!chunks.Push(std::move(chunk))) break;
+        }
+        chunks.Close();
+    });
+
+    // Writer: spill codes in arrival order
+    bool writeFailed = false;
+    std::thread writer([&] {
+        std::vector<uint32_t> codes;
+        while (encoded.Pop(codes)) {
+            spill.write(reinterpret_cast<const char*>(codes.data()), codes.size() * sizeof(uint32_t));
+            if (!spill) {
+                writeFailed = true;
+                encoded.Close();
+                break;
+            }
+        }
+    });
+
+    // Encoder: keys live in a deque so the map's string_views stay valid as it grows
+    std::deque<std::string> keys;
+    std::unordered_map<std::string_view, uint32_t> codeOf;
+    uint64_t rows = 0;
+    std::string chunk;
+    while (chunks.Pop(chunk)) {
+        std::vector<uint32_t> codes;
+        const char* p = chunk.data();
+        const char* end = p + chunk.size();
+        while (p < end) {
+            const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+            const char* lineEnd = newline ? newline : end;
+            std::string_view line(p, lineEnd - p);
+            auto it = codeOf.find(line);
+            if (it == codeOf.end()) {
+                keys.emplace_back(line);
+                it = codeOf.emplace(keys.back(), static_cast<uint32_t>(keys.size() - 1)).first;
+            }
+            codes.push_back(it->second);
+            p = newline ? newline + 1 : end;
+        }
+        rows += codes.size();
+        if (rows > kMaxSelectableRows || !encoded.Push(std::move(codes))) break;
+    }
+    chunks.Close();
+    encoded.Close();
+    reader.join();
+    writer.join();
+    spill.close();
+
+    bool failed = true;
+    if (input.bad()) {
+        std::cerr << "Error: failed reading " << inputFile << std::endl;
+    } else if (rows > kMaxSelectableRows) {
+        std::cerr << "Error: " << inputFile << " has more rows than a selection can address" << std::endl;
+    } else if (writeFailed || spill.fail()) {
+        std::cerr << "Error: failed writing " << spillFile << std::endl;
+    } else {
+        failed = false;
+    }
+    if (failed) {
+        std::remove(spillFile.c_str());
+        return false;
+    }
+    codeOf.clear();
+
+    // Final codes: first appearance, or key order (remapping the spilled codes) for a sorted dictionary
+    std::vector<uint32_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint32_t> remap;
+    if (options.sortedDictionary) {
+        std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys[a] < keys[b]; });
+        remap.resize(keys.size());
+        for (size_t code = 0; code < order.size(); ++code) {
+            remap[order[code]] = static_cast<uint32_t>(code);
+        }
+    }
+    size_t keyBytes = 0;
+    for (const std::string& key : keys) {
+        keyBytes += key.size();
+    }
+    StringArena finalKeys;
+    finalKeys.Reset(keys.size(), keyBytes);
+    for (uint32_t code : order) {
+        finalKeys.Add(keys[code]);
+    }
+    std::deque<std::string>().swap(keys);
+
+    std::cout << "Writing file." << std::endl;
+    unsigned bitWidth = CodeColumn::ChooseBitWidth(finalKeys.Size());
+    FrontCodedDictionary frontCoded;
+    frontCoded.Build(finalKeys, options.sortedDictionary);
+    ZoneMap zoneMap;
+    zoneMap.Allocate(rows, finalKeys.Size());
+    uint32_t flags = (options.sortedDictionary ? kFlagSortedDictionary : 0) | kFlagFrontCoded | kFlagZoneMap;
+    EncodedFileHeader header = MakeHeader(flags, rows, finalKeys, bitWidth, CodeColumn::BytesFor(rows, bitWidth), 0,
+                                          frontCoded.Bytes(), zoneMap.Bytes());
+
+    // Written under a temporary name, so a reader still scanning a file at outputFile keeps its bytes
+    std::string tempFile = outputFile + ".tmp";
+    std::ofstream file(tempFile, std::ios::binary);
+    std::ifstream spilled(spillFile, std::ios::binary);
+    if (!file.is_open() || !spilled.is_open()) {
+        std::cerr << "Error: could not write " << outputFile << std::endl;
+        std::remove(spillFile.c_str());
+        return false;
+    }
+    WriteHeaderAndDictionary(file, header, finalKeys);
+
+    // Code section: slices of whole packed blocks concatenate into the same bytes as one packed column.
+    // Slices also hold whole zones, so the zone map is filled as they go by.
+    std::vector<uint32_t> slice(std::min<uint64_t>(kRepackRows, rows));
+    CodeColumn packed;
+    for (uint64_t done = 0; done < rows && file;) {
+        size_t n = static_cast<size_t>(std::min<uint64_t>(kRepackRows, rows - done));
+        if (!spilled.read(reinterpret_cast<char*>(slice.data()), n * sizeof(uint32_t))) break;
+        packed.Allocate(n, bitWidth);
+        for (size_t i = 0; i < n; ++i) {
+            packed.Set(i, remap.empty() ? slice[i] : remap[slice[i]]);
+        }
+        file.write(reinterpret_cast<const char*>(packed.Data()), packed.Bytes());
+        zoneMap.Fill(packed, done);
+        done += n;
+    }
+    WriteSection(file, header.codesOffset + header.codesBytes, header.prefixOffset, frontCoded.Data(),
+                 header.prefixBytes);
+    WriteSection(file, header.prefixOffset + header.prefixBytes, header.zoneOffset, zoneMap.Data(),
+                 header.zoneBytes);
+    bool complete = file && spilled;
+    file.close();
+    spilled.close();
+    std::remove(spillFile.c_str());
+    if (!complete || file.fail() || std::rename(tempFile.c_str(), outputFile.c_str()) != 0) {
+        std::cerr << "Error: failed writing " << outputFile << std::endl;
+        std::remove(tempFile.c_str());
+        return false;
+    }
+
+    // Serve queries from the mapped result rather than keeping anything in memory
+    return MapEncodedFile(outputFile);
+}
+
+// Append: rows are encoded against the dictionary as it stands and written as one delta segment
+bool DictionaryCodec::AppendRows(const std::vector<std::string>& rows) {
+    return AppendRowViews(RowViews(rows));
+}
+
+// Helper to append rows as one delta segment
+bool DictionaryCodec::AppendRowViews(const std::vector<std::string_view>& rows) {
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+    if (encodedPath_.empty()) {
+        std::cerr << "Error: nothing to append to, encode or load a column first" << std::endl;
+        return false;
+    }
+    if (rows.empty()) return true;
+    const Version& current = Current();
+    if (current.dataSize + rows.size() > kMaxSelectableRows) {
+        std::cerr << "Error: appending " << rows.size() << " rows exceeds the rows a selection can address"
+                  << std::endl;
+        return false;
+    }
+
+    // Published versions never change and only writers (holding writerMutex_) publish, so the current
+    // one is read without pinning. Values not in the dictionary get the next codes, in order of first
+    // appearance.
+    size_t firstCode = current.DictionarySize();
+    std::unordered_map<std::string_view, size_t> newCodes; // Views into rows
+    std::vector<size_t> codes(rows.size());
+    size_t newBytes = 0;
+    for (size_t i = 0; i < rows.size(); ++i) {
+        size_t code = current.FindCode(rows[i]);
+        if (code == kNoCode) {
+            auto [it, inserted] = newCodes.emplace(rows[i], firstCode + newCodes.size());
+            if (inserted) newBytes += rows[i].size();
+            code = it->second;
+        }
+        codes[i] = code;
+    }
+    std::vector<std::string_view> ordered(newCodes.size());
+    for (const auto& [key, code] : newCodes) {
+        ordered[code - firstCode] = key;
+    }
+    StringArena newKeys;
+    newKeys.Reset(ordered.size(), newBytes);
+    for (std::string_view key : ordered) {
+        newKeys.Add(key);
+    }
+
+    auto segment = std::make_shared<DeltaSegment>();
+    segment->firstRow = current.dataSize;
+    segment->codes.Pack(codes, CodeColumn::ChooseBitWidth(firstCode + newKeys.Size()));
+    std::string path = DeltaPath(encodedPath_, current.deltas.size());
+    if (!WriteDeltaFile(path, current.dataSize, firstCode, newKeys, segment->codes)) {
+        std::cerr << "Error: could not write " << path << std::endl;
+        return false;
+    }
+
+    // The segment is on disk, publish a version with it. The base and earlier segments are shared,
+    // the appended keys are copied so the published arena never moves under a reader.
+    auto version = std::make_unique<Version>();
+    version->base = current.base;
+    version->deltas = current.deltas;
+    version->deltas.push_back(std::move(segment));
+    version->deltaKeys.Reset(current.deltaKeys.Size() + newKeys.Size(),
+                             current.deltaKeys.BytesSize() + newKeys.BytesSize());
+    for (size_t i = 0; i < current.deltaKeys.Size(); ++i) {
+        version->deltaKeys.Add(current.deltaKeys.Get(i));
+    }
+    for (size_t i = 0; i < newKeys.Size(); ++i) {
+        version->deltaKeys.Add(newKeys.Get(i));
+    }
+    version->BuildDeltaLookup();
+    version->dataSize = current.dataSize + rows.size();
+    Publish(std::move(version), false);
+    return true;
+}
+
+// Append the lines of a column file
+bool DictionaryCodec::AppendColumnFile(const std::string& inputFile) {
+    ColumnFile column;
+    return LoadColumnFile(inputFile, column) && AppendRowViews(column.Rows());
+}
+
+// Compaction: base and delta segments are merged into one column under the same dictionary order
+// (a sorted dictionary is re-sorted with the appended keys), written beside the encoded file and
+// renamed over it
+bool DictionaryCodec::Compact() {
+    std::lock_guard<std::mutex> writerLock(writerMutex_);
+    const Version& current = Current();
+    if (current.deltas.empty()) return true;
+    std::cout << "Compacting " << current.deltas.size() << " delta segments." << std::endl;
+
+    // Only writers publish versions and this one holds writerMutex_, so the merge reads the current
+    // version while queries keep pinning it
+    const BaseColumn& base = *current.base;
+    size_t codeCount = current.DictionarySize();
+    std::vector<uint32_t> order(codeCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<uint32_t> remap;
+    if (base.sortedDictionary) {
+        std::sort(order.begin(), order.end(), [&current](uint32_t a, uint32_t b) {
+            return current.KeyOf(a) < current.KeyOf(b);
+        });
+        remap.resize(codeCount);
+        for (size_t code = 0; code < order.size(); ++code) {
+            remap[order[code]] = static_cast<uint32_t>(code);
+        }
+    }
+    StringArena keys;
+    keys.Reset(codeCount, base.keys.BytesSize() + current.deltaKeys.BytesSize());
+    for (uint32_t code : order) {
+        keys.Add(current.KeyOf(code));
+    }
+
+    CodeColumn column;
+    column.Allocate(current.dataSize, CodeColumn::ChooseBitWidth(codeCount));
+    size_t batch[kDecodeBatch];
+    for (const Morsel& morsel : current.Morsels()) {
+        for (size_t start = morsel.begin; start < morsel.end; start += kDecodeBatch) {
+            size_t count = std::min(kDecodeBatch, morsel.end - start);
+            morsel.column->Unpack(start, start + count, batch);
+            for (size_t i = 0; i < count; ++i) {
+                column.Set(morsel.firstRow + start + i, remap.empty() ? batch[i] : remap[batch[i]]);
+            }
+        }
+    }
+
+    FrontCodedDictionary frontCoded;
+    frontCoded.Build(keys, base.sortedDictionary);
+    PostingIndex index;
+    if (!base.postingIndex.Empty()) {
+        index.Build(column, codeCount);
+    }
+    ZoneMap zoneMap;
+    zoneMap.Build(column, codeCount);
+    if (base.codes.IsCompressed()) {
+        column.Compress();
+    }
+
+    // Swap the merged file in (readers of the old version keep the replaced file's mapping). Delta
+    // files left behind by a crash after the rename no longer continue the merged rows, so a load
+    // ignores them.
+    std::string path = encodedPath_;
+    if (!WriteEncodedFile(path, base.sortedDictionary, keys, column, index, frontCoded, zoneMap)) {
+        std::cerr << "Error: could not write " << path << std::endl;
+        return false;
+    }
+    RemoveDeltaFiles(path);
+    return MapEncodedFile(path);
+}
+
+// Run Compact on a background thread
+void DictionaryCodec::CompactInBackground() {
+    std::lock_guard<std::mutex> compactorLock(compactorMutex_);
+    if (compacting_.exchange(true)) return;
+    if (compactor_.joinable()) compactor_.join(); // An earlier run that has finished
+    compactor_ = std::thread([this] {
+        // Read only after the thread is joined, so the write needs no lock
+        compactResult_ = Compact();
+        compacting_ = false;
+    });
+}
+
+// Wait for a background compaction
+bool DictionaryCodec::WaitForCompaction() {
+    std::lock_guard<std::mutex> compactorLock(compactorMutex_);
+    if (compactor_.joinable()) compactor_.join();
+    return compactResult_;
+}
+
+// Number of delta segments
+size_t DictionaryCodec::GetDeltaCount() const {
+    Snapshot v(*this);
+    return v->deltas.size();
+}
+
+// Value stored at a row
+std::string_view DictionaryCodec::GetData(size_t index) const {
+    Snapshot v(*this);
+    return v->KeyOf(v->CodeAt(index));
+}
+
+// Number of rows
+size_t DictionaryCodec::GetDataSize() const {
+    Snapshot v(*this);
+    return v->dataSize;
+}
+
+// True if codes follow lexicographic key order
+bool DictionaryCodec::IsDictionarySorted() const {
+    Snapshot v(*this);
+    return v->base->sortedDictionary;
+}
+
+// True if point lookups can use a posting index
+bool DictionaryCodec::HasPostingIndex() const {
+    Snapshot v(*this);
+    return !v->base->postingIndex.Empty();
 }
 
 // Test encoding speed based on number of threads and output graph
 void DictionaryCodec::TestEncodingSpeed(const std::string& inputFile) {
-    auto columnData = LoadColumnFile(inputFile);
+    ColumnFile column;
+    if (!LoadColumnFile(inputFile, column)) return;
+    const std::vector<std::string_view>& columnData = column.Rows();
 
     size_t numThreads = std::thread::hardware_concurrency();
     std::cout << "Max number of threads: " << numThreads << std::endl;
@@ -127,14 +1166,16 @@ void DictionaryCodec::TestEncodingSpeed(const std::string& inputFile) {
     std::vector<double> y_data;          // To store average time durations
     int numRuns = 10;
 
-    for (size_t t = 1; t < numThreads; ++t) {
+    for (size_t t = 1; t <= numThreads; ++t) {
         double totalTime = 0.0;
 
         for (int i = 0; i < numRuns; ++i) {
+            // Time the full encode: dictionary build plus the encode pass
             auto start = std::chrono::high_resolution_clock::now();
-            BuildDictionary(columnData, t);
+            BaseColumn base;
+            BuildDictionary(base, columnData, false, t);
+            EncodeRows(base, columnData, t);
             auto end = std::chrono::high_resolution_clock::now();
-            dictionary_.clear();
 
             // Calculate the duration in milliseconds
             std::chrono::duration<double, std::milli> duration = end - start;
@@ -158,185 +1199,782 @@ void DictionaryCodec::TestEncodingSpeed(const std::string& inputFile) {
     system("gnuplot -persist src/plot.gp");
 }
 
-// Query: Check if a data item exists in the encoded column, return indices if found
-std::vector<size_t> DictionaryCodec::QueryItem(const std::string& dataItem) {
-    std::vector<size_t> results;
-
-    std::shared_lock lock(dictionaryMutex_);
+// Morsels: every segment is cut into kMorselRows pieces, so bit-packed morsels start a block
+std::vector<DictionaryCodec::Morsel> DictionaryCodec::Version::Morsels(bool withBase) const {
+    std::vector<Morsel> morsels;
+    auto split = [&morsels](const CodeColumn& column, size_t firstRow) {
+        for (size_t begin = 0; begin < column.Size(); begin += kMorselRows) {
+            morsels.push_back({&column, begin, std::min(begin + kMorselRows, column.Size()), firstRow});
+        }
+    };
+    if (withBase) split(base->codes, 0);
+    for (const auto& delta : deltas) {
+        split(delta->codes, delta->firstRow);
+    }
+    return morsels;
+}
 
-    auto it = dictionary_.find(dataItem);
-    if (it == dictionary_.end()) {
+// Morsel-driven scan: scan(column, begin, end, results) runs over each morsel of the base and delta
+// segments on the shared pool, then the per-morsel results are concatenated in morsel (and so row)
+// order, shifting delta rows to their row ids. Base morsels the zone map rules out are never read.
+template <typename ScanFn, typename ZoneFn>
+SelectionVector DictionaryCodec::Version::ScanMorsels(ScanFn scan, ZoneFn mayMatch, bool withBase) const {
+    QueryTrace::Phase("scan");
+    std::vector<Morsel> morsels = Morsels(withBase);
+    if (!base->zoneMap.Empty()) {
+        size_t all = morsels.size();
+        morsels.erase(std::remove_if(morsels.begin(), morsels.end(), [&](const Morsel& morsel) {
+            return morsel.column == &base->codes && !mayMatch(morsel.begin / kMorselRows);
+        }), morsels.end());
+        QueryTrace::Add(QueryCounter::MorselsSkipped, all - morsels.size());
+    }
+    CountScanned(morsels);
+    if (morsels.empty()) return SelectionVector();
+    if (morsels.size() == 1 && morsels[0].firstRow == 0) {
+        SelectionVector results;
+        scan(*morsels[0].column, morsels[0].begin, morsels[0].end, results);
         return results;
     }
 
-    size_t maxI = encodedColumn_.size();
-    size_t key = it->second;
-    for (size_t i = 0; i < maxI; i++) {
-        if (encodedColumn_[i] == key) {
-            results.push_back(i);
-        }
+    ThreadPool& pool = ThreadPool::Shared();
+    std::vector<SelectionVector> parts(morsels.size());
+    pool.ParallelFor(morsels.size(), [&](size_t m) {
+        scan(*morsels[m].column, morsels[m].begin, morsels[m].end, parts[m]);
+    });
+    QueryTrace::Phase("merge");
+
+    // Output offset of every morsel, then each morsel copies itself into place
+    std::vector<size_t> offsets(morsels.size() + 1, 0);
+    for (size_t m = 0; m < morsels.size(); ++m) {
+        offsets[m + 1] = offsets[m] + parts[m].size();
     }
-    return results;
+    SelectionVector::Storage merged(offsets[morsels.size()]);
+    pool.ParallelFor(morsels.size(), [&](size_t m) {
+        uint32_t firstRow = static_cast<uint32_t>(morsels[m].firstRow);
+        std::transform(parts[m].begin(), parts[m].end(), merged.begin() + offsets[m],
+                       [firstRow](uint32_t row) { return row + firstRow; });
+    });
+    return SelectionVector(std::move(merged));
 }
 
-std::vector<size_t> DictionaryCodec::SIMDQueryItem(const std::string& dataItem) {
-    std::vector<size_t> results;
+// Late materialization: two passes over the codes, the first sizes the output arena so the copy
+// pass never reallocates. Codes are random dictionary accesses, so the entries of base keys are
+// prefetched (appended keys are few and stay cached).
+template <typename CodesFn>
+void DictionaryCodec::Version::DecodeRows(size_t n, CodesFn codesFor, StringArena& out) const {
+    const uint64_t* offsets = base->keys.Offsets();
+    const char* bytes = base->keys.Bytes();
+    size_t baseKeys = base->keys.Size();
+    size_t codes[kDecodeBatch];
+    QueryTrace::Add(QueryCounter::RowsScanned, n);
+
+    size_t total = 0;
+    for (size_t start = 0; start < n; start += kDecodeBatch) {
+        size_t count = std::min(kDecodeBatch, n - start);
+        codesFor(start, count, codes);
+        for (size_t i = 0; i < count; ++i) {
+            if (i + kDecodePrefetch < count && codes[i + kDecodePrefetch] < baseKeys) {
+                __builtin_prefetch(offsets + codes[i + kDecodePrefetch]);
+            }
+            total += KeyOf(codes[i]).size();
+        }
+    }
 
-    std::shared_lock lock(dictionaryMutex_);
+    out.Reset(n, total);
+    for (size_t start = 0; start < n; start += kDecodeBatch) {
+        size_t count = std::min(kDecodeBatch, n - start);
+        codesFor(start, count, codes);
+        for (size_t i = 0; i < count; ++i) {
+            if (i + 2 * kDecodePrefetch < count && codes[i + 2 * kDecodePrefetch] < baseKeys) {
+                __builtin_prefetch(offsets + codes[i + 2 * kDecodePrefetch]);
+            }
+            if (i + kDecodePrefetch < count && codes[i + kDecodePrefetch] < baseKeys) {
+                __builtin_prefetch(bytes + offsets[codes[i + kDecodePrefetch]]);
+            }
+            out.Add(KeyOf(codes[i]));
+        }
+    }
+}
 
-    // Find the dictionary entry for `dataItem`
-    auto it = dictionary_.find(dataItem);
-    if (it == dictionary_.end()) {
-        return results;
+// Helper for the codes of ascending rows
+void DictionaryCodec::Version::RowCodes(const uint32_t* rows, size_t n, size_t* codes) const {
+    // Rows ascend, so rows ending in the base lie in it entirely
+    if (n == 0) return;
+    if (rows[n - 1] < base->codes.Size()) {
+        base->codes.Gather(rows, n, codes);
+        return;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        codes[i] = CodeAt(rows[i]);
     }
+}
 
-    size_t maxI = encodedColumn_.size();
-    size_t key = it->second;
+// Late materialization of a query result
+void DictionaryCodec::Decode(const SelectionVector& rows, StringArena& out) const {
+    QueryTrace trace("Decode", "decode");
+    Snapshot v(*this);
+    v->DecodeRows(rows.size(), [&](size_t start, size_t count, size_t* codes) {
+        v->RowCodes(rows.data() + start, count, codes);
+    }, out);
+    trace.SetMatches(rows.size());
+}
 
-    // SIMD register for the key (assuming size_t is 64-bit)
-    __m256i keyVec = _mm256_set1_epi64x(static_cast<long long>(key));
+// Late materialization of a row range
+void DictionaryCodec::DecodeRange(size_t begin, size_t end, StringArena& out) const {
+    QueryTrace trace("DecodeRange", "decode");
+    Snapshot v(*this);
+    end = std::min(end, v->dataSize);
+    begin = std::min(begin, end);
+    size_t baseRows = v->base->codes.Size();
+    v->DecodeRows(end - begin, [&](size_t start, size_t count, size_t* codes) {
+        size_t first = begin + start;
+        size_t inBase = first < baseRows ? std::min(count, baseRows - first) : 0;
+        v->base->codes.Unpack(first, first + inBase, codes);
+        for (size_t i = inBase; i < count; ++i) {
+            codes[i] = v->CodeAt(first + i);
+        }
+    }, out);
+    trace.SetMatches(end - begin);
+}
 
-    // Process 4 elements at a time with AVX2
-    size_t i = 0;
-    for (; i + 3 < maxI; i += 4) {
-        // Load 4 elements from encodedColumn_ into a SIMD register
-        __m256i columnVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&encodedColumn_[i]));
+// Query: Check if a data item exists in the encoded column, return indices if found
+SelectionVector DictionaryCodec::QueryItem(std::string_view dataItem) {
+    SelectionVector results;
+    QueryTrace trace("QueryItem", "lookup");
 
-        // Compare each element in the chunk to `keyVec`
-        __m256i cmpResult = _mm256_cmpeq_epi64(columnVec, keyVec);
+    Snapshot v(*this);
 
-        // Get a mask of matching elements
-        int mask = _mm256_movemask_epi8(cmpResult);
+    size_t code = v->FindCode(dataItem);
+    if (code == kNoCode) {
+        return results;
+    }
 
-        // For each matching bit in the mask, add the index to results
-        for (int j = 0; j < 4; ++j) {
-            if ((mask >> (j * 8)) & 0xFF) {  // Each 64-bit match uses 8 bits in the mask
-                results.push_back(i + j);
-            }
-        }
+    // An appended key only occurs in the delta segments
+    return trace.Finish(v->ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+        column.ScanEqualScalar(code, part, begin, end);
+    }, [&](size_t zone) { return v->base->zoneMap.MayContain(zone, code); }, code < v->base->keys.Size()));
+}
+
+SelectionVector DictionaryCodec::SIMDQueryItem(std::string_view dataItem) {
+    SelectionVector results;
+    QueryTrace trace("SIMDQueryItem", "lookup");
+
+    Snapshot v(*this);
+
+    // Find the dictionary entry for `dataItem`
+    size_t code = v->FindCode(dataItem);
+    if (code == kNoCode) {
+        return results;
     }
 
-    // Handle remaining elements (if any) in a scalar loop
-    for (; i < maxI; ++i) {
-        if (encodedColumn_[i] == key) {
-            results.push_back(i);
+    // Compare codes with the kernel for the column's code width (8/16/32/64-bit or bit-packed)
+    auto scan = [&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+        column.ScanEqual(code, part, begin, end);
+    };
+    auto mayMatch = [&](size_t zone) { return v->base->zoneMap.MayContain(zone, code); };
+
+    // Planner: a rare item decodes its posting list, a frequent one is cheaper to scan. The index
+    // covers the base file, rows appended since are scanned.
+    bool inBase = code < v->base->keys.Size();
+    if (inBase && !v->base->postingIndex.Empty() && v->base->postingIndex.Count(code) * kPostingScanRatio < v->dataSize) {
+        QueryTrace::Phase("index");
+        v->base->postingIndex.Decode(code, results);
+        QueryTrace::Add(QueryCounter::IndexRows, results.size());
+        for (uint32_t row : v->ScanMorsels(scan, mayMatch, false)) {
+            results.push_back(row);
         }
+        return trace.Finish(std::move(results));
     }
 
-    return results;
+    // An appended key only occurs in the delta segments
+    return trace.Finish(v->ScanMorsels(scan, mayMatch, inBase));
 }
 
 // Dictionary-assisted prefix search
-std::vector<size_t> DictionaryCodec::SearchByPrefix(const std::string& prefix) const {
-    std::vector<size_t> results;
+SelectionVector DictionaryCodec::SearchByPrefix(std::string_view prefix) const {
     size_t prefixLen = prefix.size();
 
-    // Lock reading mutex
-    std::shared_lock lock(dictionaryMutex_);
-
-    for (const auto& [key, code] : dictionary_) {
-        if (key.compare(0, prefixLen, prefix) == 0) {
+    // Pin the current version, appends and compaction publish new ones without blocking this query
+    Snapshot v(*this);
+
+    // Sorted dictionary: matching keys own one contiguous code interval, scan the column once.
+    // Matching keys appended since the file was written lie outside it, so they join a code set.
+    if (v->base->sortedDictionary) {
+        auto [lo, hi] = v->PrefixCodeRange(prefix);
+        CodeSet appended(v->DictionarySize());
+        v->AddAppendedPrefixCodes(prefix, appended);
+        if (appended.Empty()) {
+            return v->ScanMorsels([&, lo = lo, hi = hi](const CodeColumn& column, size_t begin, size_t end,
+                                                     SelectionVector& part) {
+                column.ScanRangeScalar(lo, hi, part, begin, end);
+            }, [&, lo = lo, hi = hi](size_t zone) { return v->base->zoneMap.MayOverlap(zone, lo, hi); });
+        }
+        for (size_t code = lo; code < hi; ++code) {
+            appended.Insert(code);
+        }
+        return v->ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+            column.ScanInScalar(appended, part, begin, end);
+        }, [&](size_t zone) { return v->base->zoneMap.MayContainAny(zone, appended); });
+    }
 
-            size_t maxI = encodedColumn_.size();
-            for (size_t i = 0; i < maxI; i++) {
-                if (encodedColumn_[i] == code) {
-                    results.push_back(i);
-                }
+    // Collect the matching codes first, then scan the column once. The front-coded dictionary holds
+    // them as one sorted run; without it every key is compared (walking the arena in code order).
+    CodeSet codes(v->DictionarySize());
+    if (!v->base->frontCoded.Empty()) {
+        auto [lo, hi] = v->base->frontCoded.PrefixRange(prefix);
+        for (size_t position = lo; position < hi; ++position) {
+            codes.Insert(v->base->frontCoded.CodeAt(position));
+        }
+    } else {
+        QueryTrace::Add(QueryCounter::KeysProbed, v->base->keys.Size());
+        for (size_t code = 0; code < v->base->keys.Size(); ++code) {
+            if (v->base->keys.Get(code).substr(0, prefixLen) == prefix) {
+                codes.Insert(code);
             }
         }
     }
-    return results;
+    v->AddAppendedPrefixCodes(prefix, codes);
+    return v->ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+        column.ScanInScalar(codes, part, begin, end);
+    }, [&](size_t zone) { return v->base->zoneMap.MayContainAny(zone, codes); });
 }
 
 // Query by prefix without SIMD
-std::vector<size_t> DictionaryCodec::QueryByPrefix(const std::string& prefix) const {
-    return SearchByPrefix(prefix);
+SelectionVector DictionaryCodec::QueryByPrefix(std::string_view prefix) const {
+    QueryTrace trace("QueryByPrefix", "lookup");
+    return trace.Finish(SearchByPrefix(prefix));
 }
 
 // SIMD-assisted prefix search
-std::vector<size_t> DictionaryCodec::SIMDQueryByPrefix(const std::string& prefix) const {
-    std::vector<size_t> results;
+SelectionVector DictionaryCodec::SIMDQueryByPrefix(std::string_view prefix) const {
+    QueryTrace trace("SIMDQueryByPrefix", "lookup");
+
+    // Pin the current version, appends and compaction publish new ones without blocking this query
+    Snapshot v(*this);
+
+    // Sorted dictionary: one vectorized range compare over the column, or when appended keys match
+    // too, one membership pass with the interval and their codes
+    if (v->base->sortedDictionary) {
+        auto [lo, hi] = v->PrefixCodeRange(prefix);
+        CodeSet appended(v->DictionarySize());
+        v->AddAppendedPrefixCodes(prefix, appended);
+        if (appended.Empty()) {
+            return trace.Finish(v->ScanMorsels([&, lo = lo, hi = hi](const CodeColumn& column, size_t begin, size_t end,
+                                                                  SelectionVector& part) {
+                column.ScanRange(lo, hi, part, begin, end);
+            }, [&, lo = lo, hi = hi](size_t zone) { return v->base->zoneMap.MayOverlap(zone, lo, hi); }));
+        }
+        for (size_t code = lo; code < hi; ++code) {
+            appended.Insert(code);
+        }
+        return trace.Finish(v->ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+            column.ScanIn(appended, part, begin, end);
+        }, [&](size_t zone) { return v->base->zoneMap.MayContainAny(zone, appended); }));
+    }
+
+    // One vectorized membership pass over the column, rows come out in order
+    return trace.Finish(v->ScanCodeSet(v->PrefixCodeSet(prefix)));
+}
+
+// Helper for the codes of keys starting with prefix: the code interval of a sorted dictionary, one
+// sorted run of the front-coded dictionary, or without either, every key's leading bytes compared
+// with the prefix kernel for the CPU's instruction set. Appended keys are compared one by one.
+CodeSet DictionaryCodec::Version::PrefixCodeSet(std::string_view prefix) const {
     size_t prefixLen = prefix.size();
+    CodeSet codes(DictionarySize());
+    if (base->sortedDictionary) {
+        auto [lo, hi] = PrefixCodeRange(prefix);
+        for (size_t code = lo; code < hi; ++code) {
+            codes.Insert(code);
+        }
+    } else if (!base->frontCoded.Empty()) {
+        auto [lo, hi] = base->frontCoded.PrefixRange(prefix);
+        for (size_t position = lo; position < hi; ++position) {
+            codes.Insert(base->frontCoded.CodeAt(position));
+        }
+    } else {
+        PrefixKernel startsWith = ActiveKernels().startsWith;
+        QueryTrace::Add(QueryCounter::KeysProbed, base->keys.Size());
+        for (size_t code = 0; code < base->keys.Size(); ++code) {
+            std::string_view key = base->keys.Get(code);
+            if (key.size() >= prefixLen && startsWith(key.data(), prefix.data(), prefixLen)) {
+                codes.Insert(code);
+            }
+        }
+    }
+    AddAppendedPrefixCodes(prefix, codes);
+    return codes;
+}
 
-    // Lock reading mutex
-    std::shared_lock lock(dictionaryMutex_);
+// Helper for the rows holding one of codes: one vectorized membership pass, skipping the morsels the
+// zone map rules out
+SelectionVector DictionaryCodec::Version::ScanCodeSet(const CodeSet& codes) const {
+    if (codes.Empty()) return SelectionVector();
+    return ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+        column.ScanIn(codes, part, begin, end);
+    }, [&](size_t zone) { return base->zoneMap.MayContainAny(zone, codes); });
+}
 
-    // Prepare SIMD register for prefix (up to 32 characters for AVX2)
-    char paddedPrefix[32] = {0};  // Zero-padding for shorter prefixes
-    std::memcpy(paddedPrefix, prefix.data(), prefixLen);
-    __m256i prefixVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(paddedPrefix));
+// Comparison query: one open-ended key range
+SelectionVector DictionaryCodec::QueryCompare(CompareOp op, std::string_view bound) const {
+    KeyBound lower, upper;
+    switch (op) {
+        case CompareOp::Less:         upper = {bound, false, true}; break;
+        case CompareOp::LessEqual:    upper = {bound, true, true}; break;
+        case CompareOp::Greater:      lower = {bound, false, true}; break;
+        case CompareOp::GreaterEqual: lower = {bound, true, true}; break;
+    }
+    QueryTrace trace("QueryCompare", "lookup");
+    return trace.Finish(SearchKeyRange(lower, upper));
+}
 
-    for (const auto& [key, code] : dictionary_) {
-        if (key.size() >= prefixLen) {
-            // Load the first 32 bytes of the key
-            __m256i keyVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key.data()));
+// BETWEEN query: a key range closed at both ends
+SelectionVector DictionaryCodec::QueryBetween(std::string_view lo, std::string_view hi) const {
+    QueryTrace trace("QueryBetween", "lookup");
+    return trace.Finish(SearchKeyRange({lo, true, true}, {hi, true, true}));
+}
 
-            // Compare prefix with the beginning of the key
-            __m256i cmpResult = _mm256_cmpeq_epi8(prefixVec, keyVec);
-            int mask = _mm256_movemask_epi8(cmpResult);
+// Helper to find the sorted position of the first base key above key or not below it
+size_t DictionaryCodec::Version::SortedRank(std::string_view key, bool afterKey) const {
+    // Sorted positions of the front-coded dictionary (on a sorted dictionary they are the codes)
+    if (!base->frontCoded.Empty()) {
+        return base->frontCoded.Rank(key, afterKey);
+    }
 
-            // Check if the first `prefixLen` bytes match
-            if ((mask & ((1 << prefixLen) - 1)) == ((1 << prefixLen) - 1)) {
-                size_t maxI = encodedColumn_.size();
+    // Binary search over the codes of a sorted dictionary
+    size_t lo = 0, hi = base->keys.Size();
+    size_t probes = 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        std::string_view midKey = base->keys.Get(mid);
+        if (midKey < key || (afterKey && midKey == key)) lo = mid + 1; else hi = mid;
+        probes++;
+    }
+    QueryTrace::Add(QueryCounter::KeysProbed, probes);
+    return lo;
+}
 
-                // Prepare SIMD register for code comparison
-                __m256i codeVec = _mm256_set1_epi64x(static_cast<long long>(code));
+// Range predicates: the matching base keys are one run of sorted positions. On a sorted dictionary the
+// run is a code interval and the column is scanned with one range compare; otherwise the run's codes
+// (or without a front-coded dictionary, every key compared with the bounds) go into a code set for a
+// membership scan. Either way no row's value is compared as a string.
+SelectionVector DictionaryCodec::SearchKeyRange(const KeyBound& lower, const KeyBound& upper) const {
+    auto inRange = [&](std::string_view key) {
+        if (lower.bounded && (lower.inclusive ? key < lower.key : key <= lower.key)) return false;
+        if (upper.bounded && (upper.inclusive ? key > upper.key : key >= upper.key)) return false;
+        return true;
+    };
 
-                // Process encodedColumn_ in chunks of 4 (for 64-bit integers)
-                size_t i = 0;
-                for (; i + 3 < maxI; i += 4) {
-                    // Load 4 elements from encodedColumn_ into a SIMD register
-                    __m256i columnVec = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&encodedColumn_[i]));
+    Snapshot v(*this);
 
-                    // Compare each element in the chunk to `codeVec`
-                    __m256i cmpResultCode = _mm256_cmpeq_epi64(columnVec, codeVec);
+    // Keys appended since the file was written are outside the sorted run, compare them one by one
+    CodeSet codes(v->DictionarySize());
+    QueryTrace::Add(QueryCounter::KeysProbed, v->deltaKeys.Size());
+    for (size_t i = 0; i < v->deltaKeys.Size(); ++i) {
+        if (inRange(v->deltaKeys.Get(i))) codes.Insert(v->base->keys.Size() + i);
+    }
 
-                    // Get a mask of matching elements
-                    int maskCode = _mm256_movemask_epi8(cmpResultCode);
+    if (v->base->sortedDictionary || !v->base->frontCoded.Empty()) {
+        size_t first = lower.bounded ? v->SortedRank(lower.key, !lower.inclusive) : 0;
+        size_t last = upper.bounded ? v->SortedRank(upper.key, upper.inclusive) : v->base->keys.Size();
+        last = std::max(first, last);
+        if (v->base->sortedDictionary && codes.Empty()) {
+            return v->ScanMorsels([&](const CodeColumn& column, size_t begin, size_t end, SelectionVector& part) {
+                column.ScanRange(first, last, part, begin, end);
+            }, [&](size_t zone) { return v->base->zoneMap.MayOverlap(zone, first, last); });
+        }
+        for (size_t position = first; position < last; ++position) {
+            codes.Insert(v->base->frontCoded.Empty() ? position : v->base->frontCoded.CodeAt(position));
+        }
+    } else {
+        QueryTrace::Add(QueryCounter::KeysProbed, v->base->keys.Size());
+        for (size_t code = 0; code < v->base->keys.Size(); ++code) {
+            if (inRange(v->base->keys.Get(code))) codes.Insert(code);
+        }
+    }
+    return v->ScanCodeSet(codes);
+}
 
-                    // For each matching bit in the mask, add the index to results
-                    for (int j = 0; j < 4; ++j) {
-                        if ((maskCode >> (j * 8)) & 0xFF) {  // Each 64-bit match uses 8 bits in the mask
-                            results.push_back(i + j);
-                        }
-                    }
-                }
+// IN-list query: rows matching any of items, in row order, from a single pass over the column
+SelectionVector DictionaryCodec::QueryIn(const std::vector<std::string>& items) const {
+    QueryTrace trace("QueryIn", "lookup");
+    Snapshot v(*this);
 
-                // Handle remaining elements (if any) in a scalar loop
-                for (; i < maxI; ++i) {
-                    if (encodedColumn_[i] == code) {
-                        results.push_back(i);
-                    }
+    CodeSet codes(v->DictionarySize());
+    for (const std::string& item : items) {
+        size_t code = v->FindCode(item);
+        if (code != kNoCode) {
+            codes.Insert(code);
+        }
+    }
+    return trace.Finish(v->ScanCodeSet(codes));
+}
+
+// Batch query: one membership pass over the column finds the rows of every key at once, then the
+// codes of the matched rows route each row to its key's query slot through a code -> slot table
+std::vector<SelectionVector> DictionaryCodec::QueryBatch(const std::vector<std::string>& keys) const {
+    std::vector<SelectionVector> results(keys.size());
+    QueryTrace trace("QueryBatch", "lookup");
+    Snapshot v(*this);
+
+    // Resolve every key first; keys with the same value share one slot
+    CodeSet codes(v->DictionarySize());
+    std::vector<size_t> keyCodes(keys.size(), kNoCode);
+    for (size_t k = 0; k < keys.size(); ++k) {
+        keyCodes[k] = v->FindCode(keys[k]);
+        if (keyCodes[k] != kNoCode) {
+            codes.Insert(keyCodes[k]);
+        }
+    }
+    if (codes.Empty()) return results;
+
+    // Slots in code order; the table only spans the batch's codes, not the whole dictionary
+    constexpr uint32_t kNoSlot = ~uint32_t(0);
+    std::vector<size_t> slotCodes = codes.Codes();
+    size_t minCode = codes.Min();
+    std::vector<uint32_t> slotOf(codes.Max() - minCode + 1, kNoSlot);
+    for (size_t slot = 0; slot < slotCodes.size(); ++slot) {
+        slotOf[slotCodes[slot] - minCode] = static_cast<uint32_t>(slot);
+    }
+    std::vector<SelectionVector> slotRows(slotCodes.size());
+
+    // Planner: when every key of the batch is rare, decoding the posting lists beats a column pass
+    // (only while there are no appended rows, which the index does not cover)
+    bool usePostings = !v->base->postingIndex.Empty() && v->deltas.empty();
+    if (usePostings) {
+        size_t postings = 0;
+        for (size_t code : slotCodes) {
+            postings += v->base->postingIndex.Count(code);
+        }
+        usePostings = postings * kPostingScanRatio < v->dataSize;
+    }
+    if (usePostings) {
+        QueryTrace::Phase("index");
+        for (size_t slot = 0; slot < slotCodes.size(); ++slot) {
+            v->base->postingIndex.Decode(slotCodes[slot], slotRows[slot]);
+            QueryTrace::Add(QueryCounter::IndexRows, slotRows[slot].size());
+        }
+    } else {
+        // Every morsel the zone map keeps holds its matches (rows of its segment) with their slots, in row order
+        QueryTrace::Phase("scan");
+        std::vector<Morsel> morselList = v->Morsels();
+        size_t all = morselList.size();
+        morselList.erase(std::remove_if(morselList.begin(), morselList.end(), [&](const Morsel& morsel) {
+            return morsel.column == &v->base->codes && !v->base->zoneMap.MayContainAny(morsel.begin / kMorselRows, codes);
+        }), morselList.end());
+        QueryTrace::Add(QueryCounter::MorselsSkipped, all - morselList.size());
+        CountScanned(morselList);
+        size_t morsels = morselList.size();
+        std::vector<SelectionVector> matched(morsels);
+        std::vector<std::vector<uint32_t>> matchedSlots(morsels);
+        ThreadPool::Shared().ParallelFor(morsels, [&](size_t m) {
+            const CodeColumn& column = *morselList[m].column;
+            column.ScanIn(codes, matched[m], morselList[m].begin, morselList[m].end);
+            std::vector<uint32_t>& slots = matchedSlots[m];
+            slots.resize(matched[m].size());
+            size_t batch[kDecodeBatch];
+            for (size_t start = 0; start < slots.size(); start += kDecodeBatch) {
+                size_t count = std::min(kDecodeBatch, slots.size() - start);
+                column.Gather(matched[m].data() + start, count, batch);
+                for (size_t i = 0; i < count; ++i) {
+                    slots[start + i] = slotOf[batch[i] - minCode];
                 }
             }
+        });
+
+        // Size every slot, then scatter morsel by morsel so each slot's rows stay ascending
+        QueryTrace::Phase("scatter");
+        std::vector<size_t> counts(slotCodes.size(), 0);
+        for (const std::vector<uint32_t>& slots : matchedSlots) {
+            for (uint32_t slot : slots) {
+                counts[slot]++;
+            }
+        }
+        std::vector<SelectionVector::Storage> storage(slotCodes.size());
+        for (size_t slot = 0; slot < slotCodes.size(); ++slot) {
+            storage[slot].resize(counts[slot]);
+            counts[slot] = 0;
+        }
+        for (size_t m = 0; m < morsels; ++m) {
+            uint32_t firstRow = static_cast<uint32_t>(morselList[m].firstRow);
+            for (size_t i = 0; i < matched[m].size(); ++i) {
+                uint32_t slot = matchedSlots[m][i];
+                storage[slot][counts[slot]++] = matched[m][i] + firstRow;
+            }
+        }
+        for (size_t slot = 0; slot < slotCodes.size(); ++slot) {
+            slotRows[slot] = SelectionVector(std::move(storage[slot]));
+        }
+    }
+
+    // Hand every key its slot's rows: the last key using a slot takes them, earlier duplicates copy
+    size_t matches = 0;
+    std::vector<size_t> uses(slotCodes.size(), 0);
+    for (size_t code : keyCodes) {
+        if (code != kNoCode) uses[slotOf[code - minCode]]++;
+    }
+    for (size_t k = 0; k < keys.size(); ++k) {
+        if (keyCodes[k] == kNoCode) continue;
+        uint32_t slot = slotOf[keyCodes[k] - minCode];
+        if (--uses[slot] == 0) {
+            results[k] = std::move(slotRows[slot]);
+        } else {
+            results[k] = slotRows[slot];
         }
+        matches += results[k].size();
     }
+    trace.SetMatches(matches);
     return results;
 }
 
-// Baseline column search (without dictionary encoding) for performance comparison
-std::vector<size_t> DictionaryCodec::BaselineSearch(const std::string& dataItem) {
-    std::vector<size_t> indices;
+// Code histogram with privatized counters: every partition counts its share of the morsels (or of the
+// selected rows) into its own array, then the arrays are summed slice by slice of the code space.
+// Partitions are capped so each has at least as many rows as counters to clear and merge.
+std::vector<uint64_t> DictionaryCodec::Version::CodeCounts(const SelectionVector* rows) const {
+    ThreadPool& pool = ThreadPool::Shared();
+    size_t codeSpace = DictionarySize();
+    size_t work = rows != nullptr ? rows->size() : dataSize;
+    size_t partitions = std::min<size_t>(pool.Size(), std::max<size_t>(1, work / std::max<size_t>(codeSpace, 1)));
+    QueryTrace::Phase("count");
+
+    std::vector<std::vector<uint32_t>> local(partitions);
+    if (rows == nullptr) {
+        std::vector<Morsel> morsels = Morsels();
+        CountScanned(morsels);
+        pool.ParallelFor(partitions, [&](size_t p) {
+            local[p].assign(codeSpace, 0);
+            for (size_t m = p; m < morsels.size(); m += partitions) {
+                morsels[m].column->CountCodes(morsels[m].begin, morsels[m].end, local[p].data());
+            }
+        });
+    } else {
+        QueryTrace::Add(QueryCounter::RowsScanned, rows->size());
+        pool.ParallelFor(partitions, [&](size_t p) {
+            local[p].assign(codeSpace, 0);
+            auto [begin, end] = ChunkBounds(rows->size(), partitions, p);
+            size_t codes[kDecodeBatch];
+            for (size_t start = begin; start < end; start += kDecodeBatch) {
+                size_t count = std::min(kDecodeBatch, end - start);
+                RowCodes(rows->data() + start, count, codes);
+                for (size_t i = 0; i < count; ++i) {
+                    local[p][codes[i]]++;
+                }
+            }
+        });
+    }
+
+    QueryTrace::Phase("merge");
+    std::vector<uint64_t> counts(codeSpace, 0);
+    size_t slices = std::min<size_t>(pool.Size(), std::max<size_t>(1, codeSpace / kMorselRows));
+    pool.ParallelFor(slices, [&](size_t s) {
+        auto [lo, hi] = ChunkBounds(codeSpace, slices, s);
+        for (const std::vector<uint32_t>& partial : local) {
+            for (size_t code = lo; code < hi; ++code) {
+                counts[code] += partial[code];
+            }
+        }
+    });
+    return counts;
+}
+
+// GROUP BY value, COUNT(*)
+std::vector<ValueCount> DictionaryCodec::GroupByCount(const SelectionVector* rows) const {
+    QueryTrace trace("GroupByCount", "count");
+    Snapshot v(*this);
+    std::vector<uint64_t> counts = v->CodeCounts(rows);
+    std::vector<ValueCount> groups;
+    for (size_t code = 0; code < counts.size(); ++code) {
+        if (counts[code] != 0) groups.emplace_back(v->KeyOf(code), counts[code]);
+    }
+    return trace.Finish(std::move(groups));
+}
+
+// Top-K: a partial sort of the codes by count, only the k winners are ordered
+std::vector<ValueCount> DictionaryCodec::TopK(size_t k, const SelectionVector* rows) const {
+    QueryTrace trace("TopK", "count");
+    Snapshot v(*this);
+    std::vector<uint64_t> counts = v->CodeCounts(rows);
+    QueryTrace::Phase("rank");
+    std::vector<uint32_t> codes;
+    for (size_t code = 0; code < counts.size(); ++code) {
+        if (counts[code] != 0) codes.push_back(static_cast<uint32_t>(code));
+    }
+    k = std::min(k, codes.size());
+    std::partial_sort(codes.begin(), codes.begin() + k, codes.end(), [&counts](uint32_t a, uint32_t b) {
+        return counts[a] != counts[b] ? counts[a] > counts[b] : a < b;
+    });
+
+    std::vector<ValueCount> top;
+    for (size_t i = 0; i < k; ++i) {
+        top.emplace_back(v->KeyOf(codes[i]), counts[codes[i]]);
+    }
+    return trace.Finish(std::move(top));
+}
+
+// COUNT(DISTINCT value): codes with at least one row
+size_t DictionaryCodec::CountDistinct(const SelectionVector* rows) const {
+    QueryTrace trace("CountDistinct", "count");
+    Snapshot v(*this);
+    std::vector<uint64_t> counts = v->CodeCounts(rows);
+    size_t distinct = counts.size() - std::count(counts.begin(), counts.end(), uint64_t(0));
+    trace.SetMatches(distinct);
+    return distinct;
+}
+
+// Codes equal to item
+CodeSet DictionaryCodec::ItemCodes(std::string_view item) const {
+    QueryTrace trace("ItemCodes", "lookup");
+    Snapshot v(*this);
+    CodeSet codes(v->DictionarySize());
+    size_t code = v->FindCode(item);
+    if (code != kNoCode) {
+        codes.Insert(code);
+    }
+    trace.SetMatches(codes.Count());
+    return codes;
+}
+
+// Codes of the values starting with prefix
+CodeSet DictionaryCodec::PrefixCodes(std::string_view prefix) const {
+    QueryTrace trace("PrefixCodes", "lookup");
+    Snapshot v(*this);
+    CodeSet codes = v->PrefixCodeSet(prefix);
+    trace.SetMatches(codes.Count());
+    return codes;
+}
 
-    size_t len = GetDataSize();
+// Selectivity estimate: the codes of kEstimateRows evenly spaced rows, scaled up to the column
+size_t DictionaryCodec::EstimateRows(const CodeSet& codes) const {
+    QueryTrace trace("EstimateRows", "sample");
+    Snapshot v(*this);
+    if (codes.Empty() || v->dataSize == 0) return 0;
+    size_t samples = std::min(kEstimateRows, v->dataSize);
+    std::vector<uint32_t> rows(samples);
+    for (size_t i = 0; i < samples; ++i) {
+        rows[i] = static_cast<uint32_t>(i * v->dataSize / samples);
+    }
+
+    size_t hits = 0;
+    size_t batch[kDecodeBatch];
+    QueryTrace::Add(QueryCounter::RowsScanned, samples);
+    for (size_t start = 0; start < samples; start += kDecodeBatch) {
+        size_t count = std::min(kDecodeBatch, samples - start);
+        v->RowCodes(rows.data() + start, count, batch);
+        for (size_t i = 0; i < count; ++i) {
+            hits += codes.Contains(batch[i]);
+        }
+    }
+    trace.SetMatches(hits * v->dataSize / samples);
+    return hits * v->dataSize / samples;
+}
+
+// Rows holding one of codes
+SelectionVector DictionaryCodec::ScanCodes(const CodeSet& codes) const {
+    QueryTrace trace("ScanCodes", "scan");
+    Snapshot v(*this);
+    return trace.Finish(v->ScanCodeSet(codes));
+}
+
+// Probe of a selection: the selected rows' codes are gathered a batch at a time and each row is kept
+// without a branch. Large selections are cut into chunks filtered on the shared pool, then joined.
+SelectionVector DictionaryCodec::FilterCodes(const CodeSet& codes, const SelectionVector& rows) const {
+    QueryTrace trace("FilterCodes", "filter");
+    Snapshot v(*this);
+    if (codes.Empty() || rows.empty()) return SelectionVector();
+    QueryTrace::Add(QueryCounter::RowsScanned, rows.size());
+
+    ThreadPool& pool = ThreadPool::Shared();
+    size_t chunks = std::min<size_t>(pool.Size(), std::max<size_t>(1, rows.size() / kMorselRows));
+    std::vector<SelectionVector::Storage> parts(chunks);
+    pool.ParallelFor(chunks, [&](size_t c) {
+        auto [begin, end] = ChunkBounds(rows.size(), chunks, c);
+        SelectionVector::Storage& kept = parts[c];
+        kept.resize(end - begin);
+        size_t n = 0;
+        size_t batch[kDecodeBatch];
+        for (size_t start = begin; start < end; start += kDecodeBatch) {
+            size_t count = std::min(kDecodeBatch, end - start);
+            const uint32_t* selected = rows.data() + start;
+            v->RowCodes(selected, count, batch);
+            for (size_t i = 0; i < count; ++i) {
+                kept[n] = selected[i];
+                n += codes.Contains(batch[i]);
+            }
+        }
+        kept.resize(n);
+    });
+    if (chunks == 1) return trace.Finish(SelectionVector(std::move(parts[0])));
+    QueryTrace::Phase("merge");
+
+    size_t total = 0;
+    for (const SelectionVector::Storage& part : parts) {
+        total += part.size();
+    }
+    SelectionVector::Storage merged;
+    merged.reserve(total);
+    for (const SelectionVector::Storage& part : parts) {
+        merged.insert(merged.end(), part.begin(), part.end());
+    }
+    return trace.Finish(SelectionVector(std::move(merged)));
+}
+
+// Baseline column search for performance comparison: a row-by-row string scan. No raw copy of the
+// column is kept, so each row's value is decoded from its code first; the scan measures that decode too.
+SelectionVector DictionaryCodec::BaselineSearch(std::string_view dataItem) const {
+    SelectionVector indices;
+    QueryTrace trace("BaselineSearch", "scan");
+    Snapshot v(*this);
+
+    size_t len = v->dataSize;
+    QueryTrace::Add(QueryCounter::RowsScanned, len);
+    QueryTrace::Add(QueryCounter::KeysProbed, len);
     for (size_t i = 0; i < len; ++i) {
-        if (dataColumn_[i] == dataItem) {
-            indices.push_back(i);
+        if (v->KeyOf(v->CodeAt(i)) == dataItem) {
+            indices.push_back(static_cast<uint32_t>(i));
         }
     }
-    return indices;
+    return trace.Finish(std::move(indices));
 }
 
-// Baseline column search (without dictionary encoding) for performance comparison
-std::vector<size_t> DictionaryCodec::BaselinePrefixSearch(const std::string& prefix) {
-    std::vector<size_t> indices;
+// Baseline column search for performance comparison, decoding each row as BaselineSearch does
+SelectionVector DictionaryCodec::BaselinePrefixSearch(std::string_view prefix) const {
+    SelectionVector indices;
     size_t prefixLen = prefix.size();
+    QueryTrace trace("BaselinePrefixSearch", "scan");
+    Snapshot v(*this);
 
-    size_t len = GetDataSize();
+    size_t len = v->dataSize;
+    QueryTrace::Add(QueryCounter::RowsScanned, len);
+    QueryTrace::Add(QueryCounter::KeysProbed, len);
     for (size_t i = 0; i < len; ++i) {
-        if (dataColumn_[i].compare(0, prefixLen, prefix) == 0) {
-            indices.push_back(i);
+        if (v->KeyOf(v->CodeAt(i)).substr(0, prefixLen) == prefix) {
+            indices.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return trace.Finish(std::move(indices));
+}
+
+// Baseline column search for performance comparison, decoding each row as BaselineSearch does
+SelectionVector DictionaryCodec::BaselineCompareSearch(CompareOp op, std::string_view bound) const {
+    SelectionVector indices;
+    QueryTrace trace("BaselineCompareSearch", "scan");
+    Snapshot v(*this);
+
+    size_t len = v->dataSize;
+    QueryTrace::Add(QueryCounter::RowsScanned, len);
+    QueryTrace::Add(QueryCounter::KeysProbed, len);
+    for (size_t i = 0; i < len; ++i) {
+        std::string_view value = v->KeyOf(v->CodeAt(i));
+        bool match = false;
+        switch (op) {
+            case CompareOp::Less:         match = value < bound; break;
+            case CompareOp::LessEqual:    match = value <= bound; break;
+            case CompareOp::Greater:      match = value > bound; break;
+            case CompareOp::GreaterEqual: match = value >= bound; break;
+        }
+        if (match) {
+            indices.push_back(static_cast<uint32_t>(i));
         }
     }
-    return indices;
+    return trace.Finish(std::move(indices));
 }
\ No newline at end of file
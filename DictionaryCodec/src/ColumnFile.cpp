@@ -0,0 +1,85 @@
+// ColumnFile.cpp: Column text file mapped into memory and split into rows on the shared thread pool
+#include "ColumnFile.h"
+#include "SimdKernels.h"
+#include "ThreadPool.h"
+#include <sys/stat.h>  // stat
+#include <algorithm>   // std::min, std::max
+#include <cstring>     // std::memchr
+
+namespace {
+
+// Chunks per pool thread, so threads that finish early pick up more
+constexpr size_t kChunksPerThread = 4;
+
+// Smallest chunk worth a task of its own
+constexpr size_t kMinChunkBytes = 1 << 20;
+
+// Bytes searched per kernel call, so the newline offsets fit a fixed 32-bit buffer
+constexpr size_t kSearchBytes = 1 << 16;
+
+} // namespace
+
+// Map path and split it into rows
+bool ColumnFile::Open(const std::string& path, unsigned int numThreads) {
+    Close();
+    if (!file_.Open(path)) {
+        // An empty file cannot be mapped, but it is a column without rows
+        struct stat st;
+        return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode) && st.st_size == 0;
+    }
+    const char* data = file_.Data();
+    size_t size = file_.Size();
+    file_.AdviseSequential(0, size);
+
+    // Chunk boundaries move past the next newline, so every chunk holds whole lines
+    ThreadPool& pool = ThreadPool::Shared();
+    unsigned int threads = numThreads == 0 ? pool.Size() : std::min(numThreads, pool.Size());
+    size_t chunks = std::max<size_t>(1, std::min<size_t>(threads * kChunksPerThread, size / kMinChunkBytes));
+    std::vector<size_t> bounds(chunks + 1, size);
+    bounds[0] = 0;
+    for (size_t c = 1; c < chunks; ++c) {
+        size_t start = std::max(c * (size / chunks), bounds[c - 1]);
+        const void* newline = start < size ? std::memchr(data + start, '\n', size - start) : nullptr;
+        bounds[c] = newline != nullptr ? static_cast<const char*>(newline) - data + 1 : size;
+    }
+
+    // Pass 1: newlines per chunk, summed into the first row of every chunk
+    const ScanKernels& kernels = ActiveKernels();
+    std::vector<size_t> firstRow(chunks + 1, 0);
+    pool.ParallelFor(chunks, [&](size_t c) {
+        firstRow[c + 1] = kernels.countByte(data + bounds[c], bounds[c + 1] - bounds[c], '\n');
+    }, threads);
+    for (size_t c = 0; c < chunks; ++c) {
+        firstRow[c + 1] += firstRow[c];
+    }
+
+    // A last line without a newline is a row too
+    bool unterminated = data[size - 1] != '\n';
+    rows_.resize(firstRow[chunks] + unterminated);
+
+    // Pass 2: every chunk writes its rows in place, from the newline offsets of one search block at a time
+    pool.ParallelFor(chunks, [&](size_t c) {
+        std::vector<uint32_t> newlines(kSearchBytes);
+        std::string_view* row = rows_.data() + firstRow[c];
+        const char* lineStart = data + bounds[c];
+        for (size_t block = bounds[c]; block < bounds[c + 1]; block += kSearchBytes) {
+            size_t n = std::min(kSearchBytes, bounds[c + 1] - block);
+            size_t found = kernels.findByte(data + block, n, '\n', 0, newlines.data());
+            for (size_t i = 0; i < found; ++i) {
+                const char* lineEnd = data + block + newlines[i];
+                *row++ = std::string_view(lineStart, lineEnd - lineStart);
+                lineStart = lineEnd + 1;
+            }
+        }
+        if (lineStart < data + bounds[c + 1]) {
+            *row = std::string_view(lineStart, data + bounds[c + 1] - lineStart);
+        }
+    }, threads);
+    return true;
+}
+
+// Unmap the file and drop the rows
+void ColumnFile::Close() {
+    std::vector<std::string_view>().swap(rows_);
+    file_.Close();
+}
@@ -0,0 +1,72 @@
+// ColumnGenerator.cpp: Synthetic string columns with controlled cardinality, skew and key length
+#include "ColumnGenerator.h"
+#include <algorithm> // std::max, std::shuffle, std::upper_bound
+#include <cmath>     // std::pow
+#include <numeric>   // std::iota
+#include <random>
+
+// Build the keys and, for Zipf, the rank weights
+ColumnGenerator::ColumnGenerator(const ColumnSpec& spec) : spec_(spec) {
+    spec_.cardinality = std::max<size_t>(1, spec_.cardinality);
+    std::mt19937_64 rng(spec_.seed);
+
+    // Base-26 digits needed to tell the keys apart
+    size_t width = 1;
+    for (size_t span = 26; span < spec_.cardinality; span *= 26) {
+        width++;
+    }
+    size_t minLength = std::max(spec_.minLength, width);
+    size_t maxLength = std::max(spec_.maxLength, minLength);
+    std::uniform_int_distribution<size_t> length(minLength, maxLength);
+    std::uniform_int_distribution<int> letter('a', 'z');
+
+    keys_.reserve(spec_.cardinality);
+    for (size_t i = 0; i < spec_.cardinality; ++i) {
+        std::string key(length(rng), 'a');
+        size_t value = i;
+        for (size_t d = width; d-- > 0;) {
+            key[d] = static_cast<char>('a' + value % 26);
+            value /= 26;
+        }
+        for (size_t c = width; c < key.size(); ++c) {
+            key[c] = static_cast<char>(letter(rng));
+        }
+        keys_.push_back(std::move(key));
+    }
+
+    if (spec_.distribution == ColumnSpec::Distribution::Zipf) {
+        cumulative_.resize(spec_.cardinality);
+        double total = 0.0;
+        for (size_t r = 0; r < spec_.cardinality; ++r) {
+            total += 1.0 / std::pow(static_cast<double>(r + 1), spec_.zipfExponent);
+            cumulative_[r] = total;
+        }
+        for (double& weight : cumulative_) {
+            weight /= total;
+        }
+        rankToKey_.resize(spec_.cardinality);
+        std::iota(rankToKey_.begin(), rankToKey_.end(), 0u);
+        std::shuffle(rankToKey_.begin(), rankToKey_.end(), rng);
+    }
+}
+
+// Key index for a uniform draw: a key directly, or the rank whose cumulative weight covers u
+size_t ColumnGenerator::Draw(double u) const {
+    if (cumulative_.empty()) {
+        return std::min(static_cast<size_t>(u * spec_.cardinality), spec_.cardinality - 1);
+    }
+    size_t rank = std::upper_bound(cumulative_.begin(), cumulative_.end(), u) - cumulative_.begin();
+    return rankToKey_[std::min(rank, spec_.cardinality - 1)];
+}
+
+// Draw every row; the row stream has its own seed, so it does not depend on how the keys were drawn
+std::vector<std::string> ColumnGenerator::Rows() const {
+    std::mt19937_64 rng(spec_.seed ^ 0x9E3779B97F4A7C15ull);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    std::vector<std::string> rows;
+    rows.reserve(spec_.rows);
+    for (size_t i = 0; i < spec_.rows; ++i) {
+        rows.push_back(keys_[Draw(uniform(rng))]);
+    }
+    return rows;
+}
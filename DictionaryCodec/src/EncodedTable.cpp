@@ -0,0 +1,325 @@
+// EncodedTable.cpp: Multi-column table of dictionary-encoded columns with conjunctive predicates
+#include "EncodedTable.h"
+#include "EncodedFormat.h"
+#include "MappedFile.h"
+#include <algorithm> // std::stable_sort, std::find
+#include <cstdio>    // std::remove, std::rename
+#include <cstring>   // std::memcpy, std::memcmp
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Zero bytes for padding column segments out to kTableSegmentAlignment
+const char kSegmentPadding[kTableSegmentAlignment] = {};
+
+// Temporary encoded file of column index while a table file is assembled
+std::string ColumnPath(const std::string& path, size_t index) {
+    return path + ".column" + std::to_string(index);
+}
+
+// True if value satisfies predicate
+bool Matches(const TablePredicate& predicate, std::string_view value) {
+    if (predicate.kind == TablePredicate::Kind::Prefix) {
+        return value.substr(0, predicate.value.size()) == predicate.value;
+    }
+    return value == predicate.value;
+}
+
+// Copy the whole file at path to out, returns its size (0 if it cannot be read)
+uint64_t CopyFile(const std::string& path, std::ofstream& out) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) return 0;
+    char buffer[1 << 16];
+    uint64_t bytes = 0;
+    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+        out.write(buffer, in.gcount());
+        bytes += in.gcount();
+    }
+    return bytes;
+}
+
+} // namespace
+
+// Helper to split a CSV line into fields
+bool EncodedTable::SplitCsvLine(const std::string& line, std::vector<std::string>& fields) {
+    fields.clear();
+    std::string field;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted) {
+            if (c != '"') {
+                field += c;
+            } else if (i + 1 < line.size() && line[i + 1] == '"') {
+                field += '"';
+                ++i;
+            } else {
+                quoted = false;
+            }
+        } else if (c == '"') {
+            quoted = true;
+        } else if (c == ',') {
+            fields.push_back(std::move(field));
+            field.clear();
+        } else if (c != '\r' || i + 1 != line.size()) {
+            field += c;
+        }
+    }
+    fields.push_back(std::move(field));
+    return !quoted;
+}
+
+// Encoding: every column of the CSV is encoded on its own, then the encoded files are laid end to end
+// behind the table header
+bool EncodedTable::EncodeCsvFile(const std::string& inputFile, const std::string& outputFile,
+                                 const EncodeOptions& options) {
+    if (options.streaming) {
+        std::cerr << "Error: tables are encoded in memory, encode without streaming" << std::endl;
+        return false;
+    }
+    Clear();
+
+    std::cout << "Loading file." << std::endl;
+    std::ifstream csv(inputFile);
+    std::string line;
+    std::vector<std::string> names;
+    if (!std::getline(csv, line) || !SplitCsvLine(line, names)) {
+        std::cerr << "Error: " << inputFile << " has no header row" << std::endl;
+        return false;
+    }
+
+    // Rows are split straight into their columns
+    std::vector<std::vector<std::string>> columnData(names.size());
+    std::vector<std::string> fields;
+    size_t lineNumber = 1;
+    while (std::getline(csv, line)) {
+        ++lineNumber;
+        if (!SplitCsvLine(line, fields) || fields.size() != names.size()) {
+            std::cerr << "Error: " << inputFile << " line " << lineNumber << " does not have "
+                      << names.size() << " fields" << std::endl;
+            return false;
+        }
+        for (size_t c = 0; c < names.size(); ++c) {
+            columnData[c].push_back(std::move(fields[c]));
+        }
+    }
+    csv.close();
+    size_t rows = columnData[0].size();
+
+    // Each column gets its own dictionary, written to a temporary encoded file
+    bool encoded = true;
+    for (size_t c = 0; c < names.size() && encoded; ++c) {
+        std::cout << "Encoding column " << names[c] << "." << std::endl;
+        DictionaryCodec column;
+        encoded = column.EncodeColumn(columnData[c], ColumnPath(outputFile, c), options);
+        std::vector<std::string>().swap(columnData[c]);
+    }
+    if (!encoded) {
+        for (size_t c = 0; c < names.size(); ++c) {
+            std::remove(ColumnPath(outputFile, c).c_str());
+        }
+        std::cerr << "Error: could not encode " << inputFile << std::endl;
+        return false;
+    }
+
+    // Header, column directory and names, then the column segments. The table is written under a
+    // temporary name and renamed into place, so a failed write leaves no partial table behind.
+    std::cout << "Writing table file." << std::endl;
+    std::string tempFile = outputFile + ".tmp";
+    std::ofstream file(tempFile, std::ios::binary);
+    TableFileHeader header = {};
+    std::memcpy(header.magic, kTableMagic, sizeof(kTableMagic));
+    header.version = kTableVersion;
+    header.columnCount = static_cast<uint32_t>(names.size());
+    header.rows = rows;
+    header.namesOffset = sizeof(header) + names.size() * sizeof(TableColumnEntry);
+    std::vector<uint64_t> nameOffsets(names.size() + 1, 0);
+    for (size_t c = 0; c < names.size(); ++c) {
+        nameOffsets[c + 1] = nameOffsets[c] + names[c].size();
+    }
+    header.namesBytes = nameOffsets.size() * sizeof(uint64_t) + nameOffsets.back();
+
+    std::vector<TableColumnEntry> directory(header.columnCount);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(TableColumnEntry));
+    file.write(reinterpret_cast<const char*>(nameOffsets.data()), nameOffsets.size() * sizeof(uint64_t));
+    for (const std::string& name : names) {
+        file.write(name.data(), name.size());
+    }
+
+    uint64_t end = header.namesOffset + header.namesBytes;
+    for (size_t c = 0; c < names.size() && encoded; ++c) {
+        directory[c].offset = AlignUp(end, kTableSegmentAlignment);
+        file.write(kSegmentPadding, directory[c].offset - end);
+        directory[c].bytes = CopyFile(ColumnPath(outputFile, c), file);
+        encoded = directory[c].bytes != 0;
+        end = directory[c].offset + directory[c].bytes;
+    }
+
+    // The directory is only known once every segment is in place
+    file.seekp(sizeof(header));
+    file.write(reinterpret_cast<const char*>(directory.data()), directory.size() * sizeof(TableColumnEntry));
+    file.close();
+    for (size_t c = 0; c < names.size(); ++c) {
+        std::remove(ColumnPath(outputFile, c).c_str());
+    }
+    if (!encoded || file.fail() || std::rename(tempFile.c_str(), outputFile.c_str()) != 0) {
+        std::remove(tempFile.c_str());
+        std::cerr << "Error: could not write " << outputFile << std::endl;
+        return false;
+    }
+    return LoadTableFile(outputFile);
+}
+
+// Map a table file: the header and names are read, then every column maps its own segment
+bool EncodedTable::LoadTableFile(const std::string& inputFile) {
+    Clear();
+    MappedFile file;
+    if (!file.Open(inputFile)) {
+        std::cerr << "Error: could not map " << inputFile << std::endl;
+        return false;
+    }
+
+    // Validate the header before trusting any offsets in it
+    TableFileHeader header;
+    if (file.Size() < sizeof(header)) {
+        std::cerr << "Error: " << inputFile << " is too small to be a table file" << std::endl;
+        return false;
+    }
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, kTableMagic, sizeof(kTableMagic)) != 0) {
+        std::cerr << "Error: " << inputFile << " is not a table file" << std::endl;
+        return false;
+    }
+    if (header.version != kTableVersion) {
+        std::cerr << "Error: " << inputFile << " has table version " << header.version
+                  << ", expected " << kTableVersion << std::endl;
+        return false;
+    }
+    size_t columnCount = header.columnCount;
+    if (columnCount == 0 || sizeof(header) + columnCount * sizeof(TableColumnEntry) > file.Size() ||
+        !SectionFits(header.namesOffset, header.namesBytes, file.Size()) ||
+        (columnCount + 1) * sizeof(uint64_t) > header.namesBytes) {
+        std::cerr << "Error: " << inputFile << " has a corrupt table header" << std::endl;
+        return false;
+    }
+
+    std::vector<TableColumnEntry> directory(columnCount);
+    std::memcpy(directory.data(), file.Data() + sizeof(header), columnCount * sizeof(TableColumnEntry));
+    std::vector<uint64_t> nameOffsets(columnCount + 1);
+    std::memcpy(nameOffsets.data(), file.Data() + header.namesOffset, nameOffsets.size() * sizeof(uint64_t));
+    const char* nameBytes = file.Data() + header.namesOffset + nameOffsets.size() * sizeof(uint64_t);
+    uint64_t nameBytesLen = header.namesBytes - nameOffsets.size() * sizeof(uint64_t);
+    for (size_t c = 0; c < columnCount; ++c) {
+        if (nameOffsets[c] > nameOffsets[c + 1] || nameOffsets[c + 1] > nameBytesLen ||
+            directory[c].offset % kTableSegmentAlignment != 0 ||
+            !SectionFits(directory[c].offset, directory[c].bytes, file.Size())) {
+            std::cerr << "Error: " << inputFile << " has a corrupt column directory" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> names(columnCount);
+    for (size_t c = 0; c < columnCount; ++c) {
+        names[c].assign(nameBytes + nameOffsets[c], nameOffsets[c + 1] - nameOffsets[c]);
+    }
+    file.Close();
+
+    std::vector<std::unique_ptr<DictionaryCodec>> columns;
+    for (size_t c = 0; c < columnCount; ++c) {
+        columns.push_back(std::make_unique<DictionaryCodec>());
+        if (!columns[c]->LoadEncodedSegment(inputFile, directory[c].offset, directory[c].bytes)) {
+            return false;
+        }
+        if (columns[c]->GetDataSize() != header.rows) {
+            std::cerr << "Error: " << inputFile << " column " << names[c] << " has "
+                      << columns[c]->GetDataSize() << " rows, expected " << header.rows << std::endl;
+            return false;
+        }
+    }
+
+    names_ = std::move(names);
+    columns_ = std::move(columns);
+    rows_ = header.rows;
+    return true;
+}
+
+// Conjunctive query: each predicate is resolved to a code set on its column (an empty set answers the
+// query at once), the sets are ordered by sampled selectivity, the most selective one is scanned and
+// every other probes only the rows that survived so far
+SelectionVector EncodedTable::Query(const std::vector<TablePredicate>& predicates) const {
+    struct Conjunct {
+        size_t column;
+        CodeSet codes;
+        size_t estimate;
+    };
+    std::vector<Conjunct> conjuncts;
+    for (const TablePredicate& predicate : predicates) {
+        size_t column = ColumnIndex(predicate.column);
+        if (column == columns_.size()) {
+            std::cerr << "Error: no column named " << predicate.column << std::endl;
+            return SelectionVector();
+        }
+        const DictionaryCodec& codec = *columns_[column];
+        CodeSet codes = predicate.kind == TablePredicate::Kind::Prefix ? codec.PrefixCodes(predicate.value)
+                                                                       : codec.ItemCodes(predicate.value);
+        if (codes.Empty()) return SelectionVector();
+        size_t estimate = codec.EstimateRows(codes);
+        conjuncts.push_back({column, std::move(codes), estimate});
+    }
+
+    if (conjuncts.empty()) {
+        SelectionVector::Storage all(rows_);
+        for (size_t row = 0; row < rows_; ++row) {
+            all[row] = static_cast<uint32_t>(row);
+        }
+        return SelectionVector(std::move(all));
+    }
+
+    std::stable_sort(conjuncts.begin(), conjuncts.end(), [](const Conjunct& a, const Conjunct& b) {
+        return a.estimate < b.estimate;
+    });
+    SelectionVector rows = columns_[conjuncts[0].column]->ScanCodes(conjuncts[0].codes);
+    for (size_t i = 1; i < conjuncts.size() && !rows.empty(); ++i) {
+        rows = columns_[conjuncts[i].column]->FilterCodes(conjuncts[i].codes, rows);
+    }
+    return rows;
+}
+
+// Baseline table search (values compared as strings row by row) for performance comparison
+SelectionVector EncodedTable::BaselineQuery(const std::vector<TablePredicate>& predicates) const {
+    std::vector<size_t> columns;
+    for (const TablePredicate& predicate : predicates) {
+        size_t column = ColumnIndex(predicate.column);
+        if (column == columns_.size()) {
+            std::cerr << "Error: no column named " << predicate.column << std::endl;
+            return SelectionVector();
+        }
+        columns.push_back(column);
+    }
+
+    SelectionVector indices;
+    for (size_t row = 0; row < rows_; ++row) {
+        bool match = true;
+        for (size_t p = 0; p < predicates.size() && match; ++p) {
+            match = Matches(predicates[p], GetValue(row, columns[p]));
+        }
+        if (match) {
+            indices.push_back(static_cast<uint32_t>(row));
+        }
+    }
+    return indices;
+}
+
+// Index of the column named name
+size_t EncodedTable::ColumnIndex(std::string_view name) const {
+    return std::find(names_.begin(), names_.end(), name) - names_.begin();
+}
+
+// Helper to drop every column
+void EncodedTable::Clear() {
+    names_.clear();
+    columns_.clear();
+    rows_ = 0;
+}
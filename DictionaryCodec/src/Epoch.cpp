@@ -0,0 +1,84 @@
+// Epoch.cpp: Epoch-based reclamation, so readers can use published data without locks or shared counters
+#include "Epoch.h"
+#include <thread> // std::this_thread::yield
+
+// A thread's slot and guard depth; the slot is handed back when the thread exits
+struct EpochManager::ThreadState {
+    Slot* slot = nullptr;
+    unsigned int depth = 0;
+
+    ~ThreadState() {
+        if (slot != nullptr) slot->inUse.store(false, std::memory_order_release);
+    }
+};
+
+// The manager is never destroyed, so threads still exiting during shutdown can hand back their slots
+EpochManager& EpochManager::Shared() {
+    static EpochManager* manager = new EpochManager();
+    return *manager;
+}
+
+// The calling thread's state
+EpochManager::ThreadState& EpochManager::LocalState() {
+    thread_local ThreadState state;
+    if (state.slot == nullptr) state.slot = Shared().AcquireSlot();
+    return state;
+}
+
+// Reuse the slot of a thread that has exited, or push a new one onto the list
+EpochManager::Slot* EpochManager::AcquireSlot() {
+    for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        bool free = false;
+        if (!slot->inUse.load(std::memory_order_relaxed) &&
+            slot->inUse.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+            return slot;
+        }
+    }
+    Slot* slot = new Slot();
+    slot->inUse.store(true, std::memory_order_relaxed);
+    slot->next = slots_.load(std::memory_order_relaxed);
+    while (!slots_.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    return slot;
+}
+
+// Pin: publish the epoch in the thread's own slot, then fence so the data the reader loads next cannot
+// be read before the pin is visible to a writer checking for quiescence
+EpochManager::Guard::Guard() {
+    ThreadState& state = LocalState();
+    if (state.depth++ == 0) {
+        state.slot->epoch.store(Shared().epoch_.load(std::memory_order_acquire), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+// Unpin once the outermost guard ends; every read of pinned data happens before the release
+EpochManager::Guard::~Guard() {
+    ThreadState& state = LocalState();
+    if (--state.depth == 0) {
+        state.slot->epoch.store(0, std::memory_order_release);
+    }
+}
+
+// Start a new epoch; the fence orders the writer's unpublishing before its later quiescence checks
+uint64_t EpochManager::Advance() {
+    uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return epoch;
+}
+
+// Every slot is either unpinned or pinned at epoch or later
+bool EpochManager::Quiescent(uint64_t epoch) const {
+    for (Slot* slot = slots_.load(std::memory_order_acquire); slot != nullptr; slot = slot->next) {
+        uint64_t pinned = slot->epoch.load(std::memory_order_acquire);
+        if (pinned != 0 && pinned < epoch) return false;
+    }
+    return true;
+}
+
+// Wait for the readers pinned before epoch to leave
+void EpochManager::Synchronize(uint64_t epoch) const {
+    while (!Quiescent(epoch)) {
+        std::this_thread::yield();
+    }
+}
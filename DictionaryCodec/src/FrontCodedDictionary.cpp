@@ -0,0 +1,250 @@
+// FrontCodedDictionary.cpp: Sorted, front-coded dictionary for point and prefix lookups
+#include "FrontCodedDictionary.h"
+#include "QueryStats.h"
+#include <algorithm> // std::sort, std::min
+#include <cstring>   // std::memcpy
+#include <numeric>   // std::iota
+#include <string>
+
+namespace {
+
+// Words of the fixed header (count, blockCount, identity)
+constexpr size_t kHeaderWords = 3;
+
+// Append value as a little-endian base-128 varint
+void PutVarint(std::vector<uint8_t>& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+// Read a varint from [p, end), returns false if it runs past end
+inline bool GetVarint(const uint8_t*& p, const uint8_t* end, uint64_t& value) {
+    value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t byte = *p++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+// Bytes before the block area
+inline size_t DirectoryBytes(size_t count, size_t blockCount, bool identity) {
+    size_t codeBytes = identity ? 0 : (count * sizeof(uint32_t) + 7) & ~size_t(7);
+    return (kHeaderWords + blockCount + 1) * sizeof(uint64_t) + codeBytes;
+}
+
+// Decodes the keys of one block in order; malformed bytes end the block early
+class BlockCursor {
+public:
+    BlockCursor(const uint8_t* begin, const uint8_t* end) : p_(begin), end_(end) {}
+
+    // Advance to the next key, false at the end of the block
+    bool Next() {
+        uint64_t shared = 0, length;
+        if (!first_ && !GetVarint(p_, end_, shared)) return false;
+        if (!GetVarint(p_, end_, length)) return false;
+        if (shared > key_.size() || length > static_cast<size_t>(end_ - p_)) return false;
+        key_.resize(shared);
+        key_.append(reinterpret_cast<const char*>(p_), length);
+        p_ += length;
+        first_ = false;
+        return true;
+    }
+
+    std::string_view Key() const { return key_; }
+
+private:
+    const uint8_t* p_;
+    const uint8_t* end_;
+    std::string key_;
+    bool first_ = true;
+};
+
+} // namespace
+
+// Build from the dictionary keys
+void FrontCodedDictionary::Build(const StringArena& keys, bool codesSorted) {
+    size_t count = keys.Size();
+    std::vector<uint32_t> order(count);
+    std::iota(order.begin(), order.end(), 0);
+    if (!codesSorted) {
+        // string_view compares bytes as unsigned char, the order every lookup assumes
+        std::sort(order.begin(), order.end(), [&keys](uint32_t a, uint32_t b) { return keys.Get(a) < keys.Get(b); });
+    }
+
+    // Block area: the head of each block whole, the rest as shared length + suffix
+    size_t blockCount = (count + kBlockKeys - 1) / kBlockKeys;
+    std::vector<uint64_t> blockOffsets;
+    blockOffsets.reserve(blockCount + 1);
+    std::vector<uint8_t> area;
+    std::string_view previous;
+    for (size_t i = 0; i < count; ++i) {
+        std::string_view key = keys.Get(order[i]);
+        if (i % kBlockKeys == 0) {
+            blockOffsets.push_back(area.size());
+            PutVarint(area, key.size());
+            area.insert(area.end(), key.begin(), key.end());
+        } else {
+            size_t shared = 0;
+            size_t limit = std::min(previous.size(), key.size());
+            while (shared < limit && previous[shared] == key[shared]) {
+                shared++;
+            }
+            PutVarint(area, shared);
+            PutVarint(area, key.size() - shared);
+            area.insert(area.end(), key.begin() + shared, key.end());
+        }
+        previous = key;
+    }
+    blockOffsets.push_back(area.size());
+
+    size_t directory = DirectoryBytes(count, blockCount, codesSorted);
+    size_t bytes = directory + area.size();
+    std::vector<uint64_t> owned((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    uint8_t* out = reinterpret_cast<uint8_t*>(owned.data());
+    uint64_t header[kHeaderWords] = {count, blockCount, codesSorted ? 1u : 0u};
+    std::memcpy(out, header, sizeof(header));
+    std::memcpy(out + sizeof(header), blockOffsets.data(), blockOffsets.size() * sizeof(uint64_t));
+    if (!codesSorted && count != 0) {
+        std::memcpy(out + sizeof(header) + blockOffsets.size() * sizeof(uint64_t), order.data(),
+                    count * sizeof(uint32_t));
+    }
+    if (!area.empty()) {
+        std::memcpy(out + directory, area.data(), area.size());
+    }
+
+    owned_ = std::move(owned);
+    Attach(owned_.data(), bytes);
+}
+
+// Point the dictionary at serialized bytes
+bool FrontCodedDictionary::Attach(const void* data, size_t bytes) {
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    uint64_t header[kHeaderWords];
+    if (bytes < sizeof(header)) return false;
+    std::memcpy(header, base, sizeof(header));
+    uint64_t count = header[0], blockCount = header[1];
+    bool identity = header[2] != 0;
+    if (count > bytes || blockCount != (count + kBlockKeys - 1) / kBlockKeys ||
+        DirectoryBytes(count, blockCount, identity) > bytes) {
+        return false;
+    }
+
+    size_t directory = DirectoryBytes(count, blockCount, identity);
+    const uint64_t* blockOffsets = reinterpret_cast<const uint64_t*>(base + sizeof(header));
+    for (size_t b = 0; b < blockCount; ++b) {
+        if (blockOffsets[b] > blockOffsets[b + 1]) return false;
+    }
+    if (blockOffsets[0] != 0 || blockOffsets[blockCount] != bytes - directory) return false;
+    const uint32_t* codes = identity ? nullptr : reinterpret_cast<const uint32_t*>(blockOffsets + blockCount + 1);
+    for (size_t i = 0; codes != nullptr && i < count; ++i) {
+        if (codes[i] >= count) return false;
+    }
+
+    // Keep owned storage only if data points into it
+    if (owned_.empty() || data != owned_.data()) {
+        owned_.clear();
+        owned_.shrink_to_fit();
+    }
+    data_ = base;
+    bytes_ = bytes;
+    count_ = count;
+    blockCount_ = blockCount;
+    blockOffsets_ = blockOffsets;
+    codes_ = codes;
+    blocks_ = base + directory;
+    blockBytes_ = bytes - directory;
+    return true;
+}
+
+// Drop the dictionary
+void FrontCodedDictionary::Clear() {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    data_ = nullptr;
+    bytes_ = 0;
+    count_ = 0;
+    blockCount_ = 0;
+    blockOffsets_ = nullptr;
+    codes_ = nullptr;
+    blocks_ = nullptr;
+    blockBytes_ = 0;
+}
+
+// First key of a block, read in place
+std::string_view FrontCodedDictionary::BlockHead(size_t block) const {
+    const uint8_t* p = blocks_ + blockOffsets_[block];
+    const uint8_t* end = blocks_ + blockOffsets_[block + 1];
+    uint64_t length;
+    if (!GetVarint(p, end, length) || length > static_cast<size_t>(end - p)) return std::string_view();
+    return std::string_view(reinterpret_cast<const char*>(p), length);
+}
+
+// Sorted position of the first key not below key
+size_t FrontCodedDictionary::LowerBound(std::string_view key, bool* exact) const {
+    *exact = false;
+
+    // First block whose head is not below key
+    size_t lo = 0, hi = blockCount_;
+    size_t probes = 0;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (BlockHead(mid) < key) lo = mid + 1; else hi = mid;
+        probes++;
+    }
+    if (lo == 0) {
+        *exact = blockCount_ != 0 && BlockHead(0) == key;
+        QueryTrace::Add(QueryCounter::KeysProbed, probes + 1);
+        return 0;
+    }
+
+    // The answer lies inside the block before it, or is that block's head
+    size_t block = lo - 1;
+    size_t position = block * kBlockKeys;
+    BlockCursor cursor(blocks_ + blockOffsets_[block], blocks_ + blockOffsets_[block + 1]);
+    while (cursor.Next()) {
+        probes++;
+        if (cursor.Key() >= key) {
+            *exact = cursor.Key() == key;
+            QueryTrace::Add(QueryCounter::KeysProbed, probes);
+            return position;
+        }
+        position++;
+    }
+    *exact = lo < blockCount_ && BlockHead(lo) == key;
+    QueryTrace::Add(QueryCounter::KeysProbed, probes + 1);
+    return std::min(position, count_);
+}
+
+// Code of key, or kNotFound
+size_t FrontCodedDictionary::Find(std::string_view key) const {
+    bool exact;
+    size_t position = LowerBound(key, &exact);
+    return exact ? CodeAt(position) : kNotFound;
+}
+
+// Sorted positions of the keys starting with prefix: from the prefix itself up to its successor
+// (the prefix without trailing 0xFF bytes, last byte incremented)
+std::pair<size_t, size_t> FrontCodedDictionary::PrefixRange(std::string_view prefix) const {
+    bool exact;
+    size_t lo = LowerBound(prefix, &exact);
+    std::string successor(prefix);
+    while (!successor.empty() && static_cast<uint8_t>(successor.back()) == 0xFF) {
+        successor.pop_back();
+    }
+    if (successor.empty()) return {lo, count_};
+    successor.back() = static_cast<char>(static_cast<uint8_t>(successor.back()) + 1);
+    return {lo, LowerBound(successor, &exact)};
+}
+
+// Sorted position of the first key above key or not below it (keys are distinct, so an exact match
+// is the only key to step over)
+size_t FrontCodedDictionary::Rank(std::string_view key, bool afterKey) const {
+    bool exact;
+    size_t position = LowerBound(key, &exact);
+    return afterKey && exact ? position + 1 : position;
+}
@@ -0,0 +1,89 @@
+// MappedFile.cpp: Read-only memory mapping of a file, or of a range of one
+#include "MappedFile.h"
+#include <fcntl.h>     // open
+#include <sys/mman.h>  // mmap, munmap, madvise
+#include <sys/stat.h>  // fstat
+#include <unistd.h>    // close, sysconf
+#include <algorithm>   // std::min
+#include <utility>     // std::swap
+
+MappedFile::~MappedFile() {
+    Close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    std::swap(data_, other.data_);
+    std::swap(size_, other.size_);
+    std::swap(mapping_, other.mapping_);
+    std::swap(mappingSize_, other.mappingSize_);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        Close();
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(mapping_, other.mapping_);
+        std::swap(mappingSize_, other.mappingSize_);
+    }
+    return *this;
+}
+
+// Map the file read-only into memory
+bool MappedFile::Open(const std::string& path) {
+    return Open(path, 0, 0);
+}
+
+// Map a range of the file; length 0 maps from offset to the end
+bool MappedFile::Open(const std::string& path, size_t offset, size_t length) {
+    Close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    size_t fileSize = 0;
+    if (fstat(fd, &st) == 0) fileSize = static_cast<size_t>(st.st_size);
+    if (length == 0 && offset < fileSize) length = fileSize - offset;
+    if (length == 0 || offset > fileSize || length > fileSize - offset) {
+        ::close(fd);
+        return false;
+    }
+
+    // mmap needs a page-aligned file offset, so the mapping starts at the page holding offset
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t alignedOffset = offset & ~(page - 1);
+    size_t mappingSize = length + (offset - alignedOffset);
+    void* addr = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(alignedOffset));
+    ::close(fd); // The mapping keeps its own reference to the file
+    if (addr == MAP_FAILED) return false;
+
+    mapping_ = static_cast<char*>(addr);
+    mappingSize_ = mappingSize;
+    data_ = mapping_ + (offset - alignedOffset);
+    size_ = length;
+    return true;
+}
+
+// Unmap the file
+void MappedFile::Close() {
+    if (mapping_ != nullptr) {
+        munmap(mapping_, mappingSize_);
+        mapping_ = nullptr;
+        mappingSize_ = 0;
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
+
+// Hint the kernel that a region will be read front to back
+void MappedFile::AdviseSequential(size_t offset, size_t length) const {
+    if (data_ == nullptr || offset >= size_) return;
+
+    // madvise needs a page-aligned start address, offsets are taken from the start of the mapping
+    offset += data_ - mapping_;
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t alignedOffset = offset & ~(page - 1);
+    size_t alignedLength = std::min(length + (offset - alignedOffset), mappingSize_ - alignedOffset);
+    madvise(mapping_ + alignedOffset, alignedLength, MADV_SEQUENTIAL);
+}
@@ -0,0 +1,231 @@
+// PostingIndex.cpp: Inverted index from each code to a compressed list of the rows holding it
+#include "PostingIndex.h"
+#include <algorithm> // std::min
+#include <cstring>   // std::memcpy
+
+namespace {
+
+// Bits needed to store value
+inline uint32_t BitsFor(uint32_t value) {
+    return value == 0 ? 0 : 32 - __builtin_clz(value);
+}
+
+// Bytes of the fixed part of the layout (code space, offsets, padded counts)
+inline size_t DirectoryBytes(size_t codeSpace) {
+    size_t countBytes = (codeSpace * sizeof(uint32_t) + 7) & ~size_t(7);
+    return sizeof(uint64_t) + (codeSpace + 1) * sizeof(uint64_t) + countBytes;
+}
+
+// Bytes of one compressed block holding n rows with bits per delta
+inline size_t BlockBytes(size_t n, uint32_t bits) {
+    return 2 * sizeof(uint32_t) + ((n - 1) * bits + 31) / 32 * sizeof(uint32_t);
+}
+
+// Widest (delta - 1) inside rows[0, n)
+inline uint32_t BlockBits(const uint32_t* rows, size_t n) {
+    uint32_t maxGap = 0;
+    for (size_t i = 1; i < n; ++i) {
+        uint32_t gap = rows[i] - rows[i - 1] - 1;
+        if (gap > maxGap) maxGap = gap;
+    }
+    return BitsFor(maxGap);
+}
+
+// Compressed bytes of a whole posting list
+size_t ListBytes(const uint32_t* rows, size_t count) {
+    size_t bytes = 0;
+    for (size_t i = 0; i < count; i += PostingIndex::kBlockRows) {
+        size_t n = std::min(PostingIndex::kBlockRows, count - i);
+        bytes += BlockBytes(n, BlockBits(rows + i, n));
+    }
+    return bytes;
+}
+
+// Write a whole posting list, returns the bytes written
+size_t WriteList(const uint32_t* rows, size_t count, uint8_t* out) {
+    uint8_t* start = out;
+    for (size_t i = 0; i < count; i += PostingIndex::kBlockRows) {
+        size_t n = std::min(PostingIndex::kBlockRows, count - i);
+        const uint32_t* block = rows + i;
+        uint32_t bits = BlockBits(block, n);
+
+        uint32_t header[2] = {block[0], bits};
+        std::memcpy(out, header, sizeof(header));
+        out += sizeof(header);
+
+        // Bit-pack (delta - 1) through a 64-bit accumulator, flushing whole 32-bit words
+        uint64_t acc = 0;
+        unsigned filled = 0;
+        for (size_t j = 1; j < n && bits != 0; ++j) {
+            acc |= static_cast<uint64_t>(block[j] - block[j - 1] - 1) << filled;
+            filled += bits;
+            if (filled >= 32) {
+                uint32_t word = static_cast<uint32_t>(acc);
+                std::memcpy(out, &word, sizeof(word));
+                out += sizeof(word);
+                acc >>= 32;
+                filled -= 32;
+            }
+        }
+        if (filled > 0) {
+            uint32_t word = static_cast<uint32_t>(acc);
+            std::memcpy(out, &word, sizeof(word));
+            out += sizeof(word);
+        }
+    }
+    return out - start;
+}
+
+// True if the list at [list, list + bytes) holds exactly count rows in well-formed blocks
+bool ValidList(const uint8_t* list, size_t bytes, size_t count) {
+    for (size_t i = 0; i < count; i += PostingIndex::kBlockRows) {
+        size_t n = std::min(PostingIndex::kBlockRows, count - i);
+        uint32_t header[2];
+        if (bytes < sizeof(header)) return false;
+        std::memcpy(header, list, sizeof(header));
+        if (header[1] > 32) return false;
+        size_t blockBytes = BlockBytes(n, header[1]);
+        if (blockBytes > bytes) return false;
+        list += blockBytes;
+        bytes -= blockBytes;
+    }
+    return bytes == 0;
+}
+
+} // namespace
+
+// Build the index for codes 0 .. codeSpace - 1 from an encoded column
+void PostingIndex::Build(const CodeColumn& column, size_t codeSpace) {
+    size_t rows = column.Size();
+
+    // Counting sort: rows grouped by code, ascending within each group
+    std::vector<uint64_t> starts(codeSpace + 1, 0);
+    for (size_t i = 0; i < rows; ++i) {
+        starts[column.Get(i) + 1]++;
+    }
+    std::vector<uint32_t> counts(codeSpace);
+    for (size_t code = 0; code < codeSpace; ++code) {
+        counts[code] = static_cast<uint32_t>(starts[code + 1]);
+        starts[code + 1] += starts[code];
+    }
+    std::vector<uint32_t> grouped(rows);
+    std::vector<uint64_t> fill(starts.begin(), starts.end() - 1);
+    for (size_t i = 0; i < rows; ++i) {
+        grouped[fill[column.Get(i)]++] = static_cast<uint32_t>(i);
+    }
+
+    // Size every list, then write the directory and the blocks
+    std::vector<uint64_t> offsets(codeSpace + 1, 0);
+    for (size_t code = 0; code < codeSpace; ++code) {
+        offsets[code + 1] = offsets[code] + ListBytes(grouped.data() + starts[code], counts[code]);
+    }
+
+    size_t directory = DirectoryBytes(codeSpace);
+    size_t bytes = directory + offsets[codeSpace];
+    owned_.assign((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+    uint8_t* out = reinterpret_cast<uint8_t*>(owned_.data());
+
+    uint64_t space = codeSpace;
+    std::memcpy(out, &space, sizeof(space));
+    std::memcpy(out + sizeof(uint64_t), offsets.data(), offsets.size() * sizeof(uint64_t));
+    if (!counts.empty()) {
+        std::memcpy(out + sizeof(uint64_t) * (codeSpace + 2), counts.data(), counts.size() * sizeof(uint32_t));
+    }
+    for (size_t code = 0; code < codeSpace; ++code) {
+        WriteList(grouped.data() + starts[code], counts[code], out + directory + offsets[code]);
+    }
+
+    Attach(out, bytes);
+}
+
+// Point the index at serialized bytes
+bool PostingIndex::Attach(const void* data, size_t bytes) {
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    uint64_t codeSpace;
+    if (bytes < sizeof(codeSpace)) return false;
+    std::memcpy(&codeSpace, base, sizeof(codeSpace));
+    if (codeSpace > bytes || DirectoryBytes(codeSpace) > bytes) return false;
+
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(base + sizeof(uint64_t));
+    size_t directory = DirectoryBytes(codeSpace);
+    for (size_t code = 0; code < codeSpace; ++code) {
+        if (offsets[code] > offsets[code + 1]) return false;
+    }
+    if (offsets[0] != 0 || offsets[codeSpace] != bytes - directory) return false;
+
+    // Every list must hold its count in whole blocks, so Decode never reads past it
+    const uint32_t* counts = reinterpret_cast<const uint32_t*>(base + sizeof(uint64_t) * (codeSpace + 2));
+    const uint8_t* blocks = base + directory;
+    for (size_t code = 0; code < codeSpace; ++code) {
+        if (!ValidList(blocks + offsets[code], offsets[code + 1] - offsets[code], counts[code])) return false;
+    }
+
+    // Keep owned storage only if data points into it
+    if (owned_.empty() || data != owned_.data()) {
+        owned_.clear();
+        owned_.shrink_to_fit();
+    }
+    data_ = base;
+    bytes_ = bytes;
+    codeSpace_ = codeSpace;
+    offsets_ = offsets;
+    counts_ = counts;
+    blocks_ = blocks;
+    blockBytes_ = bytes - directory;
+    return true;
+}
+
+// Drop the index
+void PostingIndex::Clear() {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    data_ = nullptr;
+    bytes_ = 0;
+    codeSpace_ = 0;
+    offsets_ = nullptr;
+    counts_ = nullptr;
+    blocks_ = nullptr;
+    blockBytes_ = 0;
+}
+
+// Number of rows holding code
+size_t PostingIndex::Count(size_t code) const {
+    return code < codeSpace_ ? counts_[code] : 0;
+}
+
+// Append the rows holding code in ascending order
+void PostingIndex::Decode(size_t code, SelectionVector& results) const {
+    size_t count = Count(code);
+    if (count == 0) return;
+    results.reserve(results.size() + count);
+
+    const uint8_t* in = blocks_ + offsets_[code];
+    for (size_t i = 0; i < count; i += kBlockRows) {
+        size_t n = std::min(kBlockRows, count - i);
+        uint32_t header[2];
+        std::memcpy(header, in, sizeof(header));
+        in += sizeof(header);
+
+        uint32_t row = header[0];
+        uint32_t bits = header[1];
+        results.push_back(row);
+
+        // Unpack (delta - 1) values and prefix-sum them back into row ids
+        uint64_t acc = 0;
+        unsigned available = 0;
+        uint32_t mask = bits == 32 ? ~uint32_t(0) : (uint32_t(1) << bits) - 1;
+        for (size_t j = 1; j < n; ++j) {
+            if (available < bits) {
+                uint32_t word;
+                std::memcpy(&word, in, sizeof(word));
+                in += sizeof(word);
+                acc |= static_cast<uint64_t>(word) << available;
+                available += 32;
+            }
+            row += (static_cast<uint32_t>(acc) & mask) + 1;
+            acc >>= bits;
+            available -= bits;
+            results.push_back(row);
+        }
+    }
+}
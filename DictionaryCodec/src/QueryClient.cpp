@@ -0,0 +1,259 @@
+// QueryClient.cpp: Client of the query server, with pipelined and blocking calls
+#include "QueryClient.h"
+#include <sys/socket.h>  // socket, connect, recv, send
+#include <sys/un.h>      // sockaddr_un
+#include <unistd.h>      // close
+#include <algorithm>     // std::max
+#include <cerrno>
+#include <cstring>       // memcpy, strerror
+#include <iostream>
+
+namespace {
+
+// Bytes read from the server at a time
+constexpr size_t kReadBytes = 64 << 10;
+
+// Helper to append a little-endian integer
+template <typename T>
+void AppendInt(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Helper to read an integer at pos, false if it runs past end
+template <typename T>
+bool ReadInt(const char* data, size_t end, size_t& pos, T& value) {
+    if (end - pos < sizeof(value)) return false;
+    memcpy(&value, data + pos, sizeof(value));
+    pos += sizeof(value);
+    return true;
+}
+
+} // namespace
+
+QueryClient::~QueryClient() {
+    Close();
+}
+
+// Connect to the socket
+bool QueryClient::Connect(const std::string& socketPath) {
+    Close();
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path must be 1 to " << sizeof(addr.sun_path) - 1 << " bytes" << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+        std::cerr << "Error: cannot connect to " << socketPath << ": " << strerror(errno) << std::endl;
+        if (fd >= 0) ::close(fd);
+        return false;
+    }
+    fd_ = fd;
+    return true;
+}
+
+// Close the connection and drop anything buffered
+void QueryClient::Close() {
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+    out_.clear();
+    in_.clear();
+    inPos_ = 0;
+}
+
+// Queue a header
+uint32_t QueryClient::QueueHeader(uint16_t op, uint16_t column, uint16_t flags, size_t payloadBytes) {
+    FrameHeader header{};
+    header.payloadBytes = static_cast<uint32_t>(payloadBytes);
+    header.requestId = nextRequestId_++;
+    header.op = op;
+    header.flags = flags;
+    header.column = column;
+    out_.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    return header.requestId;
+}
+
+uint32_t QueryClient::SendColumns() {
+    return QueueHeader(kOpColumns, 0, 0, 0);
+}
+
+uint32_t QueryClient::SendItem(uint16_t column, std::string_view key, bool countOnly) {
+    uint32_t id = QueueHeader(kOpItem, column, countOnly ? kRequestCountOnly : 0, key.size());
+    out_ += key;
+    return id;
+}
+
+uint32_t QueryClient::SendPrefix(uint16_t column, std::string_view prefix, bool countOnly) {
+    uint32_t id = QueueHeader(kOpPrefix, column, countOnly ? kRequestCountOnly : 0, prefix.size());
+    out_ += prefix;
+    return id;
+}
+
+uint32_t QueryClient::SendBatch(uint16_t column, const std::vector<std::string>& keys, bool countOnly) {
+    size_t bytes = sizeof(uint32_t);
+    for (const std::string& key : keys) {
+        bytes += sizeof(uint32_t) + key.size();
+    }
+    uint32_t id = QueueHeader(kOpBatch, column, countOnly ? kRequestCountOnly : 0, bytes);
+    AppendInt(out_, static_cast<uint32_t>(keys.size()));
+    for (const std::string& key : keys) {
+        AppendInt(out_, static_cast<uint32_t>(key.size()));
+        out_ += key;
+    }
+    return id;
+}
+
+// Write the queued requests
+bool QueryClient::Flush() {
+    if (fd_ < 0) return false;
+    size_t sent = 0;
+    while (sent < out_.size()) {
+        ssize_t n = send(fd_, out_.data() + sent, out_.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            std::cerr << "Error: lost the connection to the server" << std::endl;
+            Close();
+            return false;
+        }
+        sent += static_cast<size_t>(n);
+    }
+    out_.clear();
+    return true;
+}
+
+// Read until bytes are buffered past inPos_
+bool QueryClient::Fill(size_t bytes) {
+    if (inPos_ > 0 && in_.size() - inPos_ < bytes) {
+        in_.erase(0, inPos_);
+        inPos_ = 0;
+    }
+    while (in_.size() - inPos_ < bytes) {
+        size_t size = in_.size();
+        in_.resize(size + std::max(kReadBytes, bytes - (size - inPos_)));
+        ssize_t n = recv(fd_, &in_[size], in_.size() - size, 0);
+        in_.resize(size + (n > 0 ? static_cast<size_t>(n) : 0));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            std::cerr << "Error: lost the connection to the server" << std::endl;
+            Close();
+            return false;
+        }
+    }
+    return true;
+}
+
+// Read and decode the next frame
+bool QueryClient::Receive(QueryResponse& response) {
+    if (fd_ < 0) return false;
+    FrameHeader header;
+    if (!Fill(sizeof(header))) return false;
+    memcpy(&header, in_.data() + inPos_, sizeof(header));
+    if (!Fill(sizeof(header) + header.payloadBytes)) return false;
+
+    const char* data = in_.data();
+    size_t pos = inPos_ + sizeof(header);
+    size_t end = pos + header.payloadBytes;
+    inPos_ = end;
+
+    response.requestId = header.requestId;
+    response.op = header.op;
+    response.status = header.status;
+    response.counts.clear();
+    response.results.clear();
+    response.columns.clear();
+    response.error.clear();
+
+    if (header.status != kStatusOk) {
+        response.error.assign(data + pos, header.payloadBytes);
+        return true;
+    }
+
+    bool valid = true;
+    if (header.op == kOpColumns) {
+        uint32_t count = 0;
+        valid = ReadInt(data, end, pos, count);
+        for (uint32_t c = 0; valid && c < count; ++c) {
+            ServedColumn column;
+            uint32_t length = 0;
+            valid = ReadInt(data, end, pos, column.rows) && ReadInt(data, end, pos, length) && end - pos >= length;
+            if (!valid) break;
+            column.name.assign(data + pos, length);
+            pos += length;
+            response.columns.push_back(std::move(column));
+        }
+    } else {
+        // One result per key: its row count, then its rows unless the request was count-only
+        bool countOnly = (header.flags & kRequestCountOnly) != 0;
+        while (valid && pos < end) {
+            uint32_t count = 0;
+            valid = ReadInt(data, end, pos, count);
+            if (!valid) break;
+            response.counts.push_back(count);
+            if (countOnly) continue;
+            valid = (end - pos) / sizeof(uint32_t) >= count;
+            if (!valid) break;
+            SelectionVector rows;
+            memcpy(rows.Extend(count), data + pos, count * sizeof(uint32_t));
+            pos += count * sizeof(uint32_t);
+            response.results.push_back(std::move(rows));
+        }
+        if (header.op == kOpItem || header.op == kOpPrefix) valid = valid && response.counts.size() == 1;
+    }
+    if (!valid) {
+        std::cerr << "Error: malformed response to request " << header.requestId << std::endl;
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// Send the queued request and read its response
+bool QueryClient::Roundtrip(uint32_t requestId, QueryResponse& response) {
+    if (!Flush() || !Receive(response)) return false;
+    if (response.requestId != requestId) {
+        std::cerr << "Error: response to request " << response.requestId << " while waiting for " << requestId
+                  << ", a blocking call was mixed with pipelined requests" << std::endl;
+        return false;
+    }
+    if (response.status != kStatusOk) {
+        std::cerr << "Error: " << response.error << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool QueryClient::Columns(std::vector<ServedColumn>& columns) {
+    QueryResponse response;
+    if (!Roundtrip(SendColumns(), response)) return false;
+    columns = std::move(response.columns);
+    return true;
+}
+
+bool QueryClient::QueryItem(uint16_t column, std::string_view key, SelectionVector& rows) {
+    QueryResponse response;
+    if (!Roundtrip(SendItem(column, key), response)) return false;
+    rows = std::move(response.results[0]);
+    return true;
+}
+
+bool QueryClient::QueryPrefix(uint16_t column, std::string_view prefix, SelectionVector& rows) {
+    QueryResponse response;
+    if (!Roundtrip(SendPrefix(column, prefix), response)) return false;
+    rows = std::move(response.results[0]);
+    return true;
+}
+
+bool QueryClient::QueryBatch(uint16_t column, const std::vector<std::string>& keys, std::vector<SelectionVector>& results) {
+    QueryResponse response;
+    if (!Roundtrip(SendBatch(column, keys), response)) return false;
+    if (response.results.size() != keys.size()) {
+        std::cerr << "Error: " << response.results.size() << " results for " << keys.size() << " keys" << std::endl;
+        return false;
+    }
+    results = std::move(response.results);
+    return true;
+}
@@ -0,0 +1,338 @@
+// QueryServer.cpp: Long-lived server answering queries on loaded columns over a Unix domain socket
+#include "QueryServer.h"
+#include <sys/socket.h>  // socket, bind, listen, accept, recv, send, shutdown
+#include <sys/stat.h>    // lstat
+#include <sys/un.h>      // sockaddr_un
+#include <unistd.h>      // close, unlink
+#include <cerrno>
+#include <cstring>       // memcpy, strerror
+#include <iostream>
+
+namespace {
+
+// Bytes read from a connection at a time
+constexpr size_t kReadBytes = 64 << 10;
+
+// Responses are written once this many bytes are waiting, even in the middle of a burst
+constexpr size_t kFlushBytes = 1 << 20;
+
+// Helper to append a little-endian integer
+template <typename T>
+void AppendInt(std::string& out, T value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Helper to append a response header
+void AppendHeader(std::string& out, const FrameHeader& request, uint16_t status, uint64_t payloadBytes) {
+    FrameHeader header{};
+    header.payloadBytes = static_cast<uint32_t>(payloadBytes);
+    header.requestId = request.requestId;
+    header.op = request.op;
+    header.flags = request.flags;
+    header.status = status;
+    out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+// Helper to append an error response carrying message
+void AppendError(std::string& out, const FrameHeader& request, uint16_t status, const std::string& message) {
+    AppendHeader(out, request, status, message.size());
+    out += message;
+}
+
+// Helper to append one query result: the row count, then the rows unless only counts were asked for
+void AppendResult(std::string& out, const SelectionVector& rows, bool countOnly) {
+    AppendInt(out, static_cast<uint32_t>(rows.size()));
+    if (!countOnly) {
+        out.append(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(uint32_t));
+    }
+}
+
+// Helper to count the payload bytes of one result
+uint64_t ResultBytes(const SelectionVector& rows, bool countOnly) {
+    return sizeof(uint32_t) + (countOnly ? 0 : rows.size() * sizeof(uint32_t));
+}
+
+// Helper to write all of data, false if the client has gone
+bool SendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+// Stop, and close a socket that Serve never ran on
+QueryServer::~QueryServer() {
+    Stop();
+    if (listenFd_ >= 0) {
+        ::close(listenFd_);
+        unlink(socketPath_.c_str());
+    }
+}
+
+// Load a column
+bool QueryServer::AddColumn(const std::string& name, const std::string& encodedFile) {
+    if (columns_.size() > UINT16_MAX) {
+        std::cerr << "Error: a server holds at most " << UINT16_MAX + 1 << " columns" << std::endl;
+        return false;
+    }
+    auto codec = std::make_unique<DictionaryCodec>();
+    if (!codec->LoadEncodedFile(encodedFile)) {
+        return false;
+    }
+    names_.push_back(name);
+    columns_.push_back(std::move(codec));
+    return true;
+}
+
+// Bind the socket
+bool QueryServer::Listen(const std::string& socketPath) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: socket path must be 1 to " << sizeof(addr.sun_path) - 1 << " bytes" << std::endl;
+        return false;
+    }
+    memcpy(addr.sun_path, socketPath.data(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "Error: cannot create a socket: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // A socket file nobody accepts on is left over from a server that did not shut down
+    struct stat st;
+    if (lstat(socketPath.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            std::cerr << "Error: " << socketPath << " exists and is not a socket" << std::endl;
+            ::close(fd);
+            return false;
+        }
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0) {
+            std::cerr << "Error: another server is listening on " << socketPath << std::endl;
+            ::close(fd);
+            return false;
+        }
+        ::close(fd);
+        unlink(socketPath.c_str());
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            std::cerr << "Error: cannot create a socket: " << strerror(errno) << std::endl;
+            return false;
+        }
+    }
+
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Error: cannot listen on " << socketPath << ": " << strerror(errno) << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    listenFd_ = fd;
+    socketPath_ = socketPath;
+    return true;
+}
+
+// Accept loop
+void QueryServer::Serve() {
+    if (listenFd_ < 0) {
+        std::cerr << "Error: call Listen before Serve" << std::endl;
+        return;
+    }
+
+    while (!stopping_) {
+        int fd = accept4(listenFd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (!stopping_) std::cerr << "Error: accept failed: " << strerror(errno) << std::endl;
+            break;
+        }
+
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        ReapConnections();
+        if (stopping_) {
+            ::close(fd);
+            break;
+        }
+        connections_.emplace_back();
+        Connection& connection = connections_.back();
+        connection.fd = fd;
+        connection.thread = std::thread(&QueryServer::HandleConnection, this, std::ref(connection));
+    }
+
+    // Wake every connection blocked in a read, then wait for them; connection threads never take
+    // the mutex, so joining under it cannot deadlock
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    for (Connection& connection : connections_) {
+        shutdown(connection.fd, SHUT_RDWR);
+    }
+    for (Connection& connection : connections_) {
+        connection.thread.join();
+        ::close(connection.fd);
+    }
+    connections_.clear();
+    ::close(listenFd_);
+    listenFd_ = -1;
+    unlink(socketPath_.c_str());
+}
+
+// Shutting a socket down wakes the thread blocked on it; descriptors are only closed by Serve, so
+// none of them can have been reused
+void QueryServer::Stop() {
+    stopping_ = true;
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    if (listenFd_ >= 0) shutdown(listenFd_, SHUT_RDWR);
+    for (Connection& connection : connections_) {
+        shutdown(connection.fd, SHUT_RDWR);
+    }
+}
+
+// Join finished connections (called with connectionsMutex_ held)
+void QueryServer::ReapConnections() {
+    for (auto it = connections_.begin(); it != connections_.end();) {
+        if (it->finished.load(std::memory_order_acquire)) {
+            it->thread.join();
+            ::close(it->fd);
+            it = connections_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+// Read whatever the client has sent, answer every complete request in it, write the responses
+void QueryServer::HandleConnection(Connection& connection) {
+    std::string in;
+    std::string out;
+    std::unique_ptr<char[]> buffer(new char[kReadBytes]);
+    bool open = true;
+
+    while (open && !stopping_) {
+        ssize_t n = recv(connection.fd, buffer.get(), kReadBytes, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        in.append(buffer.get(), static_cast<size_t>(n));
+
+        size_t pos = 0;
+        while (in.size() - pos >= sizeof(FrameHeader)) {
+            FrameHeader request;
+            memcpy(&request, in.data() + pos, sizeof(request));
+            if (request.payloadBytes > kMaxRequestBytes) {
+                std::cerr << "Error: request of " << request.payloadBytes << " bytes, closing the connection" << std::endl;
+                open = false;
+                break;
+            }
+            if (in.size() - pos - sizeof(request) < request.payloadBytes) break;
+
+            HandleRequest(request, in.data() + pos + sizeof(request), out);
+            pos += sizeof(request) + request.payloadBytes;
+
+            if (out.size() >= kFlushBytes) {
+                if (!SendAll(connection.fd, out)) open = false;
+                out.clear();
+                if (!open) break;
+            }
+        }
+        in.erase(0, pos);
+
+        if (!out.empty()) {
+            if (!SendAll(connection.fd, out)) open = false;
+            out.clear();
+        }
+    }
+
+    // The client sees the end of the stream now; the descriptor itself stays open until the connection
+    // is reaped, so Stop never shuts down a reused one
+    shutdown(connection.fd, SHUT_RDWR);
+    connection.finished.store(true, std::memory_order_release);
+}
+
+// Answer one request
+void QueryServer::HandleRequest(const FrameHeader& request, const char* payload, std::string& out) {
+    if (request.op == kOpColumns) {
+        uint64_t bytes = sizeof(uint32_t);
+        for (const std::string& name : names_) {
+            bytes += sizeof(uint64_t) + sizeof(uint32_t) + name.size();
+        }
+        AppendHeader(out, request, kStatusOk, bytes);
+        AppendInt(out, static_cast<uint32_t>(columns_.size()));
+        for (size_t c = 0; c < columns_.size(); ++c) {
+            AppendInt(out, static_cast<uint64_t>(columns_[c]->GetDataSize()));
+            AppendInt(out, static_cast<uint32_t>(names_[c].size()));
+            out += names_[c];
+        }
+        return;
+    }
+
+    if (request.column >= columns_.size()) {
+        AppendError(out, request, kStatusBadRequest, "no column " + std::to_string(request.column));
+        return;
+    }
+    DictionaryCodec& column = *columns_[request.column];
+    bool countOnly = (request.flags & kRequestCountOnly) != 0;
+    std::string_view key(payload, request.payloadBytes);
+
+    if (request.op == kOpItem || request.op == kOpPrefix) {
+        SelectionVector rows = request.op == kOpItem ? column.SIMDQueryItem(key) : column.SIMDQueryByPrefix(key);
+        uint64_t bytes = ResultBytes(rows, countOnly);
+        if (bytes > UINT32_MAX) {
+            AppendError(out, request, kStatusTooLarge, std::to_string(rows.size()) + " rows do not fit in a frame");
+            return;
+        }
+        AppendHeader(out, request, kStatusOk, bytes);
+        AppendResult(out, rows, countOnly);
+        return;
+    }
+
+    if (request.op == kOpBatch) {
+        // Keys are length-prefixed, each must lie inside the payload
+        uint32_t keyCount = 0;
+        bool valid = request.payloadBytes >= sizeof(keyCount);
+        size_t pos = sizeof(keyCount);
+        std::vector<std::string> keys;
+        if (valid) {
+            memcpy(&keyCount, payload, sizeof(keyCount));
+            valid = keyCount <= (request.payloadBytes - pos) / sizeof(uint32_t);
+        }
+        if (valid) keys.reserve(keyCount);
+        for (uint32_t i = 0; valid && i < keyCount; ++i) {
+            uint32_t length = 0;
+            valid = request.payloadBytes - pos >= sizeof(length);
+            if (!valid) break;
+            memcpy(&length, payload + pos, sizeof(length));
+            pos += sizeof(length);
+            valid = request.payloadBytes - pos >= length;
+            if (!valid) break;
+            keys.emplace_back(payload + pos, length);
+            pos += length;
+        }
+        if (!valid || pos != request.payloadBytes) {
+            AppendError(out, request, kStatusBadRequest, "malformed batch");
+            return;
+        }
+
+        std::vector<SelectionVector> results = column.QueryBatch(keys);
+        uint64_t bytes = 0;
+        for (const SelectionVector& rows : results) {
+            bytes += ResultBytes(rows, countOnly);
+        }
+        if (bytes > UINT32_MAX) {
+            AppendError(out, request, kStatusTooLarge, "batch result does not fit in a frame");
+            return;
+        }
+        AppendHeader(out, request, kStatusOk, bytes);
+        for (const SelectionVector& rows : results) {
+            AppendResult(out, rows, countOnly);
+        }
+        return;
+    }
+
+    AppendError(out, request, kStatusBadRequest, "unknown op " + std::to_string(request.op));
+}
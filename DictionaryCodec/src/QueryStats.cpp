@@ -0,0 +1,241 @@
+// QueryStats.cpp: Optional per-query execution statistics and hardware counters
+#include "QueryStats.h"
+#include <linux/perf_event.h>  // perf_event_attr, PERF_*
+#include <sys/syscall.h>       // SYS_perf_event_open
+#include <unistd.h>            // syscall, read, close
+#include <algorithm>           // std::min
+#include <cstring>             // memset, strcmp
+#include <sstream>
+
+namespace {
+
+// Helper to open one counter on the calling thread, user space only; -1 if the kernel refuses it
+int OpenCounter(uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+// The calling thread's counters, opened on first use and closed when the thread exits
+class ThreadCounters {
+public:
+    ~ThreadCounters() {
+        for (int fd : fds_) {
+            if (fd >= 0) close(fd);
+        }
+    }
+
+    static ThreadCounters& Get() {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+
+    // Current values of the counters that opened
+    HardwareCounts Read() {
+        Open();
+        HardwareCounts counts;
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            uint64_t value = 0;
+            if (fds_[i] >= 0 && read(fds_[i], &value, sizeof(value)) == sizeof(value)) {
+                counts.values[i] = value;
+                counts.available |= 1u << i;
+            }
+        }
+        return counts;
+    }
+
+    uint32_t Available() {
+        Open();
+        uint32_t available = 0;
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            if (fds_[i] >= 0) available |= 1u << i;
+        }
+        return available;
+    }
+
+private:
+    void Open() {
+        if (opened_) return;
+        opened_ = true;
+        static const struct { uint32_t type; uint64_t config; } kEvents[kHardwareCounters] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+            {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+        };
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            fds_[i] = OpenCounter(kEvents[i].type, kEvents[i].config);
+        }
+    }
+
+    bool opened_ = false;
+    int fds_[kHardwareCounters] = {-1, -1, -1, -1, -1, -1};
+};
+
+// Helper to subtract start from end for the counters both readings have
+HardwareCounts Delta(const HardwareCounts& start, const HardwareCounts& end) {
+    HardwareCounts delta;
+    delta.available = start.available & end.available;
+    for (size_t i = 0; i < kHardwareCounters; ++i) {
+        if ((delta.available >> i) & 1) delta.values[i] = end.values[i] - start.values[i];
+    }
+    return delta;
+}
+
+// Helper to write the available counters as a JSON object
+void WriteHardware(std::ostream& out, const HardwareCounts& hardware) {
+    out << "{";
+    const char* separator = "";
+    for (size_t i = 0; i < kHardwareCounters; ++i) {
+        if (!hardware.Has(static_cast<HardwareCounter>(i))) continue;
+        out << separator << "\"" << HardwareCounterName(static_cast<HardwareCounter>(i)) << "\": "
+            << hardware.values[i];
+        separator = ", ";
+    }
+    out << "}";
+}
+
+} // namespace
+
+const char* QueryCounterName(QueryCounter counter) {
+    static const char* const kNames[kQueryCounters] = {
+        "keys_probed", "rows_scanned", "bytes_scanned", "morsels_skipped", "index_rows", "result_allocations",
+    };
+    return kNames[static_cast<size_t>(counter)];
+}
+
+const char* HardwareCounterName(HardwareCounter counter) {
+    static const char* const kNames[kHardwareCounters] = {
+        "instructions", "cycles", "llc_misses", "branch_misses", "task_clock_ns", "page_faults",
+    };
+    return kNames[static_cast<size_t>(counter)];
+}
+
+// The record as one line of JSON
+std::string QueryStats::ToJson() const {
+    std::ostringstream out;
+    out.precision(9);
+    out << "{\"query\": \"" << query << "\", \"seconds\": " << seconds;
+    for (size_t i = 0; i < kQueryCounters; ++i) {
+        out << ", \"" << QueryCounterName(static_cast<QueryCounter>(i)) << "\": " << counters[i];
+    }
+    out << ", \"matches\": " << matches << ", \"hardware\": ";
+    WriteHardware(out, hardware);
+    out << ", \"phases\": [";
+    for (size_t p = 0; p < phases.size(); ++p) {
+        out << (p > 0 ? ", " : "") << "{\"name\": \"" << phases[p].name << "\", \"seconds\": " << phases[p].seconds
+            << ", \"hardware\": ";
+        WriteHardware(out, phases[p].hardware);
+        out << "}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+// Install the profiler on the calling thread
+QueryProfiler::QueryProfiler(bool hardwareCounters)
+    : previous_(current_), hardwareCounters_(hardwareCounters) {
+    current_ = this;
+}
+
+QueryProfiler::~QueryProfiler() {
+    current_ = previous_;
+}
+
+// Write every record as one line of JSON
+void QueryProfiler::WriteJsonLines(std::ostream& out) const {
+    for (const QueryStats& record : records_) {
+        out << record.ToJson() << "\n";
+    }
+}
+
+// Hardware counters the kernel lets the calling thread open
+HardwareCounts QueryProfiler::AvailableCounters() {
+    HardwareCounts counts;
+    counts.available = ThreadCounters::Get().Available();
+    return counts;
+}
+
+// Start recording a query on the calling thread
+void QueryTrace::Begin(const char* query, const char* firstPhase) {
+    profiler_ = QueryProfiler::current_;
+    owner_ = true;
+    stats_.query = query;
+    stats_.phases.push_back({firstPhase, 0, {}});
+    if (profiler_->hardwareCounters_) phaseHardware_ = ThreadCounters::Get().Read();
+    start_ = std::chrono::steady_clock::now();
+    phaseStart_ = start_;
+    active_ = this;
+}
+
+// Close the current phase; pool tasks of the phase have finished, as every parallel loop waits for them
+void QueryTrace::NextPhase(const char* name) {
+    if (name != nullptr && strcmp(stats_.phases.back().name, name) == 0) return;
+
+    auto now = std::chrono::steady_clock::now();
+    PhaseStats& phase = stats_.phases.back();
+    phase.seconds = std::chrono::duration<double>(now - phaseStart_).count();
+    phaseStart_ = now;
+    if (profiler_->hardwareCounters_) {
+        HardwareCounts current = ThreadCounters::Get().Read();
+        phase.hardware = Delta(phaseHardware_, current);
+        phaseHardware_ = current;
+        size_t index = std::min(stats_.phases.size() - 1, kMaxPhases - 1);
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            phase.hardware.values[i] += taskHardware_[index][i].exchange(0, std::memory_order_relaxed);
+        }
+    }
+
+    if (name != nullptr) {
+        stats_.phases.push_back({name, 0, {}});
+        phase_.store(std::min(stats_.phases.size() - 1, kMaxPhases - 1), std::memory_order_relaxed);
+    }
+}
+
+// Close the last phase and hand the record to the profiler
+void QueryTrace::End() {
+    NextPhase(nullptr);
+    active_ = nullptr;
+
+    stats_.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    for (size_t i = 0; i < kQueryCounters; ++i) {
+        stats_.counters[i] = counters_[i].load(std::memory_order_relaxed);
+    }
+    stats_.matches = matches_;
+    stats_.hardware.available = stats_.phases.front().hardware.available;
+    for (const PhaseStats& phase : stats_.phases) {
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            stats_.hardware.values[i] += phase.hardware.values[i];
+        }
+    }
+    profiler_->records_.push_back(std::move(stats_));
+}
+
+// Record into trace for the scope of one pool task
+QueryTrace::TaskScope::TaskScope(QueryTrace* trace) : trace_(trace), previous_(active_) {
+    if (trace_ == active_) {
+        trace_ = nullptr;
+        return;
+    }
+    active_ = trace_;
+    if (trace_->profiler_->hardwareCounters_) start_ = ThreadCounters::Get().Read();
+}
+
+QueryTrace::TaskScope::~TaskScope() {
+    if (trace_ == nullptr) return;
+    if (trace_->profiler_->hardwareCounters_) {
+        HardwareCounts delta = Delta(start_, ThreadCounters::Get().Read());
+        size_t phase = trace_->phase_.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < kHardwareCounters; ++i) {
+            if (delta.values[i] != 0) trace_->taskHardware_[phase][i].fetch_add(delta.values[i], std::memory_order_relaxed);
+        }
+    }
+    active_ = previous_;
+}
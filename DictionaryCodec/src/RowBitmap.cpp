@@ -0,0 +1,211 @@
+// RowBitmap.cpp: Compressed (roaring-style) set of row ids for combining query results
+#include "RowBitmap.h"
+#include <algorithm> // std::set_intersection, std::set_union, std::lower_bound
+#include <iterator>  // std::back_inserter
+
+namespace {
+
+constexpr size_t kChunkWords = (size_t(1) << 16) / 64;
+
+} // namespace
+
+bool RowBitmap::Chunk::Contains(uint16_t offset) const {
+    if (IsBitmap()) {
+        return (bits[offset >> 6] >> (offset & 63)) & 1;
+    }
+    return std::binary_search(array.begin(), array.end(), offset);
+}
+
+// Switch from array to bitmap storage
+void RowBitmap::Chunk::ToBitmap() {
+    if (IsBitmap()) return;
+    bits.assign(kChunkWords, 0);
+    for (uint16_t offset : array) {
+        bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+    }
+    array.clear();
+    array.shrink_to_fit();
+}
+
+// Pick the cheaper storage for the cardinality
+void RowBitmap::Chunk::Normalize() {
+    if (IsBitmap() && cardinality <= kArrayLimit) {
+        array.clear();
+        array.reserve(cardinality);
+        for (size_t w = 0; w < kChunkWords; ++w) {
+            uint64_t word = bits[w];
+            while (word) {
+                array.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+        bits.clear();
+        bits.shrink_to_fit();
+    } else if (!IsBitmap() && cardinality > kArrayLimit) {
+        ToBitmap();
+    }
+}
+
+// Build from an ascending selection
+RowBitmap RowBitmap::FromSelection(const SelectionVector& selection) {
+    RowBitmap bitmap;
+    size_t i = 0;
+    while (i < selection.size()) {
+        Chunk chunk;
+        chunk.key = selection[i] >> 16;
+
+        // Rows of one chunk are contiguous in an ascending selection
+        size_t end = i;
+        while (end < selection.size() && (selection[end] >> 16) == chunk.key) {
+            end++;
+        }
+        chunk.cardinality = static_cast<uint32_t>(end - i);
+
+        if (chunk.cardinality > kArrayLimit) {
+            chunk.bits.assign(kChunkWords, 0);
+            for (; i < end; ++i) {
+                uint16_t offset = static_cast<uint16_t>(selection[i]);
+                chunk.bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+            }
+        } else {
+            chunk.array.reserve(chunk.cardinality);
+            for (; i < end; ++i) {
+                chunk.array.push_back(static_cast<uint16_t>(selection[i]));
+            }
+        }
+        bitmap.chunks_.push_back(std::move(chunk));
+    }
+    return bitmap;
+}
+
+// Expand back into an ascending selection
+SelectionVector RowBitmap::ToSelection() const {
+    SelectionVector selection;
+    selection.reserve(Cardinality());
+    for (const Chunk& chunk : chunks_) {
+        uint32_t base = chunk.key << 16;
+        if (chunk.IsBitmap()) {
+            for (size_t w = 0; w < kChunkWords; ++w) {
+                selection.AppendMask(chunk.bits[w], base + static_cast<uint32_t>(w * 64));
+            }
+        } else {
+            for (uint16_t offset : chunk.array) {
+                selection.push_back(base + offset);
+            }
+        }
+    }
+    return selection;
+}
+
+// Intersect two chunks with the same key
+RowBitmap::Chunk RowBitmap::AndChunks(const Chunk& a, const Chunk& b) {
+    Chunk out;
+    out.key = a.key;
+
+    if (a.IsBitmap() && b.IsBitmap()) {
+        out.bits.resize(kChunkWords);
+        for (size_t w = 0; w < kChunkWords; ++w) {
+            out.bits[w] = a.bits[w] & b.bits[w];
+            out.cardinality += __builtin_popcountll(out.bits[w]);
+        }
+        out.Normalize();
+    } else if (a.IsBitmap() || b.IsBitmap()) {
+        // Probe the array side against the bitmap side
+        const Chunk& arr = a.IsBitmap() ? b : a;
+        const Chunk& map = a.IsBitmap() ? a : b;
+        for (uint16_t offset : arr.array) {
+            if (map.Contains(offset)) out.array.push_back(offset);
+        }
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+    } else {
+        std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                              std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+    }
+    return out;
+}
+
+// Union two chunks with the same key
+RowBitmap::Chunk RowBitmap::OrChunks(const Chunk& a, const Chunk& b) {
+    Chunk out;
+    out.key = a.key;
+
+    if (!a.IsBitmap() && !b.IsBitmap() && a.cardinality + b.cardinality <= kArrayLimit) {
+        std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                       std::back_inserter(out.array));
+        out.cardinality = static_cast<uint32_t>(out.array.size());
+        return out;
+    }
+
+    // The result may be dense, so work on a bitmap and normalize at the end
+    out.bits.assign(kChunkWords, 0);
+    for (const Chunk* side : {&a, &b}) {
+        if (side->IsBitmap()) {
+            for (size_t w = 0; w < kChunkWords; ++w) out.bits[w] |= side->bits[w];
+        } else {
+            for (uint16_t offset : side->array) out.bits[offset >> 6] |= uint64_t(1) << (offset & 63);
+        }
+    }
+    for (uint64_t word : out.bits) {
+        out.cardinality += __builtin_popcountll(word);
+    }
+    out.Normalize();
+    return out;
+}
+
+// Rows present in both bitmaps
+RowBitmap RowBitmap::And(const RowBitmap& other) const {
+    RowBitmap result;
+    size_t i = 0, j = 0;
+    while (i < chunks_.size() && j < other.chunks_.size()) {
+        if (chunks_[i].key < other.chunks_[j].key) {
+            i++;
+        } else if (chunks_[i].key > other.chunks_[j].key) {
+            j++;
+        } else {
+            Chunk chunk = AndChunks(chunks_[i++], other.chunks_[j++]);
+            if (chunk.cardinality != 0) result.chunks_.push_back(std::move(chunk));
+        }
+    }
+    return result;
+}
+
+// Rows present in either bitmap
+RowBitmap RowBitmap::Or(const RowBitmap& other) const {
+    RowBitmap result;
+    size_t i = 0, j = 0;
+    while (i < chunks_.size() || j < other.chunks_.size()) {
+        if (j == other.chunks_.size() || (i < chunks_.size() && chunks_[i].key < other.chunks_[j].key)) {
+            result.chunks_.push_back(chunks_[i++]);
+        } else if (i == chunks_.size() || other.chunks_[j].key < chunks_[i].key) {
+            result.chunks_.push_back(other.chunks_[j++]);
+        } else {
+            result.chunks_.push_back(OrChunks(chunks_[i++], other.chunks_[j++]));
+        }
+    }
+    return result;
+}
+
+bool RowBitmap::Contains(uint32_t row) const {
+    uint32_t key = row >> 16;
+    auto it = std::lower_bound(chunks_.begin(), chunks_.end(), key,
+                               [](const Chunk& chunk, uint32_t k) { return chunk.key < k; });
+    return it != chunks_.end() && it->key == key && it->Contains(static_cast<uint16_t>(row));
+}
+
+size_t RowBitmap::Cardinality() const {
+    size_t total = 0;
+    for (const Chunk& chunk : chunks_) {
+        total += chunk.cardinality;
+    }
+    return total;
+}
+
+// Bytes held by the containers
+size_t RowBitmap::MemoryBytes() const {
+    size_t total = chunks_.size() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks_) {
+        total += chunk.array.capacity() * sizeof(uint16_t) + chunk.bits.capacity() * sizeof(uint64_t);
+    }
+    return total;
+}
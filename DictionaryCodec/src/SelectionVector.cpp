@@ -0,0 +1,29 @@
+// SelectionVector.cpp: Query result as an ascending list of 32-bit row ids
+#include "SelectionVector.h"
+#include "SimdKernels.h"
+#include <algorithm>   // std::set_intersection, std::set_union
+#include <iterator>    // std::back_inserter
+
+// Append base + i for every set bit i of mask
+void SelectionVector::AppendMaskCompact(uint64_t mask, uint32_t base) {
+    size_t size = rows_.size();
+    // The kernel may store past the last match, so leave room for its slack
+    uint32_t* out = Extend(64 + kKernelSlack);
+    rows_.resize(size + ActiveKernels().compact(mask, base, out));
+}
+
+// Rows present in both selections
+SelectionVector SelectionVector::Intersect(const SelectionVector& other) const {
+    Storage rows;
+    rows.reserve(std::min(size(), other.size()));
+    std::set_intersection(begin(), end(), other.begin(), other.end(), std::back_inserter(rows));
+    return SelectionVector(std::move(rows));
+}
+
+// Rows present in either selection
+SelectionVector SelectionVector::Union(const SelectionVector& other) const {
+    Storage rows;
+    rows.reserve(size() + other.size());
+    std::set_union(begin(), end(), other.begin(), other.end(), std::back_inserter(rows));
+    return SelectionVector(std::move(rows));
+}
@@ -0,0 +1,148 @@
+// SimdKernels.cpp: CPU detection, kernel dispatch and the portable scalar kernels
+#include "SimdKernels.h"
+#include <algorithm> // std::count
+#include <cstdlib>   // std::getenv
+#include <cstring>   // std::memchr, std::memcmp, std::strcmp
+#include <initializer_list>
+
+const CompactTable kCompactTable;
+
+namespace {
+
+// Scalar kernels write every row and advance by the match, so the loops have no branches
+
+template <typename T>
+size_t RangeScalar(const void* data, size_t n, uint32_t base, uint64_t lo, uint64_t hi, uint32_t* out) {
+    const T* codes = static_cast<const T*>(data);
+    uint64_t span = hi - lo; // One unsigned compare covers both bounds
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        out[count] = base + static_cast<uint32_t>(i);
+        count += static_cast<uint64_t>(codes[i]) - lo <= span;
+    }
+    return count;
+}
+
+template <typename T>
+size_t SmallSetScalar(const void* data, size_t n, uint32_t base, const uint64_t* keys, size_t count,
+                      uint32_t* out) {
+    const T* codes = static_cast<const T*>(data);
+    size_t matches = 0;
+    for (size_t i = 0; i < n; ++i) {
+        bool hit = false;
+        for (size_t k = 0; k < count; ++k) {
+            hit |= codes[i] == keys[k];
+        }
+        out[matches] = base + static_cast<uint32_t>(i);
+        matches += hit;
+    }
+    return matches;
+}
+
+template <typename T>
+size_t BitmapScalar(const void* data, size_t n, uint32_t base, const uint32_t* bitmap, uint32_t* out) {
+    const T* codes = static_cast<const T*>(data);
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t code = codes[i];
+        out[count] = base + static_cast<uint32_t>(i);
+        count += (bitmap[code >> 5] >> (code & 31)) & 1;
+    }
+    return count;
+}
+
+size_t CompactScalar(uint64_t mask, uint32_t base, uint32_t* out) {
+    size_t count = 0;
+    while (mask) {
+        out[count++] = base + static_cast<uint32_t>(__builtin_ctzll(mask));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+bool StartsWithScalar(const char* key, const char* prefix, size_t len) {
+    return std::memcmp(key, prefix, len) == 0;
+}
+
+size_t CountByteScalar(const char* data, size_t n, char byte) {
+    return std::count(data, data + n, byte);
+}
+
+// Byte offsets are written exactly, so this one jumps from match to match instead
+size_t FindByteScalar(const char* data, size_t n, char byte, uint32_t base, uint32_t* out) {
+    size_t count = 0;
+    const char* end = data + n;
+    for (const char* p = data; (p = static_cast<const char*>(std::memchr(p, byte, end - p))) != nullptr; ++p) {
+        out[count++] = base + static_cast<uint32_t>(p - data);
+    }
+    return count;
+}
+
+} // namespace
+
+// Best level this CPU (and OS) supports
+SimdLevel DetectSimdLevel() {
+    __builtin_cpu_init();
+    // Byte and word compares need BW, the 128/256-bit mask forms need VL
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512vl")) {
+        return SimdLevel::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse4.2")) return SimdLevel::SSE42;
+    return SimdLevel::Scalar;
+}
+
+// Name of a level
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SSE42:  return "sse4.2";
+        case SimdLevel::AVX2:   return "avx2";
+        case SimdLevel::AVX512: return "avx512";
+        default:                return "scalar";
+    }
+}
+
+// Kernels for a level, built up from the scalar set
+ScanKernels MakeScanKernels(SimdLevel level) {
+    ScanKernels kernels;
+    kernels.range[0] = &RangeScalar<uint8_t>;
+    kernels.range[1] = &RangeScalar<uint16_t>;
+    kernels.range[2] = &RangeScalar<uint32_t>;
+    kernels.range[3] = &RangeScalar<uint64_t>;
+    kernels.smallSet[0] = &SmallSetScalar<uint8_t>;
+    kernels.smallSet[1] = &SmallSetScalar<uint16_t>;
+    kernels.smallSet[2] = &SmallSetScalar<uint32_t>;
+    kernels.smallSet[3] = &SmallSetScalar<uint64_t>;
+    kernels.bitmap[0] = &BitmapScalar<uint8_t>;
+    kernels.bitmap[1] = &BitmapScalar<uint16_t>;
+    kernels.bitmap[2] = &BitmapScalar<uint32_t>;
+    kernels.bitmap[3] = &BitmapScalar<uint64_t>;
+    kernels.compact = &CompactScalar;
+    kernels.startsWith = &StartsWithScalar;
+    kernels.countByte = &CountByteScalar;
+    kernels.findByte = &FindByteScalar;
+
+    if (level >= SimdLevel::SSE42) AddSSE42Kernels(kernels);
+    if (level >= SimdLevel::AVX2) AddAVX2Kernels(kernels);
+    if (level >= SimdLevel::AVX512) AddAVX512Kernels(kernels);
+    kernels.level = level;
+    kernels.name = SimdLevelName(level);
+    return kernels;
+}
+
+// Kernels chosen on first use
+const ScanKernels& ActiveKernels() {
+    static const ScanKernels kernels = [] {
+        SimdLevel level = DetectSimdLevel();
+
+        // DICTCODEC_SIMD can only lower the level, never enable instructions the CPU lacks
+        if (const char* requested = std::getenv("DICTCODEC_SIMD")) {
+            for (SimdLevel cap : {SimdLevel::Scalar, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512}) {
+                if (std::strcmp(requested, SimdLevelName(cap)) == 0 && cap < level) level = cap;
+            }
+        }
+        return MakeScanKernels(level);
+    }();
+    return kernels;
+}
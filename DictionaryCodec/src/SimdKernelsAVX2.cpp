@@ -0,0 +1,253 @@
+// SimdKernelsAVX2.cpp: 256-bit scan kernels, compiled with -mavx2
+#include "SimdKernels.h"
+#include <immintrin.h> // AVX2 SIMD instructions
+#include <cstring>     // std::memcmp, std::memcpy
+
+namespace {
+
+// Per-width lane operations. Match32 runs a lane predicate over 32 consecutive codes and
+// returns one bit per code, so every width shares the same scan driver.
+struct Lanes8 {
+    using T = uint8_t;
+    static __m256i Set1(uint64_t v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+    static __m256i Equal(__m256i a, __m256i b) { return _mm256_cmpeq_epi8(a, b); }
+    // lo <= x <= hi as unsigned: x survives both the max with lo and the min with hi
+    static __m256i InRange(__m256i x, __m256i lo, __m256i hi) {
+        return _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, lo), x),
+                                _mm256_cmpeq_epi8(_mm256_min_epu8(x, hi), x));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(pred(v)));
+    }
+    // 8 codes zero-extended to 32-bit lanes
+    static __m256i Widen8(const T* codes) {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(codes)));
+    }
+};
+
+struct Lanes16 {
+    using T = uint16_t;
+    static __m256i Set1(uint64_t v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+    static __m256i Equal(__m256i a, __m256i b) { return _mm256_cmpeq_epi16(a, b); }
+    static __m256i InRange(__m256i x, __m256i lo, __m256i hi) {
+        return _mm256_and_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(x, lo), x),
+                                _mm256_cmpeq_epi16(_mm256_min_epu16(x, hi), x));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        __m256i c0 = pred(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes)));
+        __m256i c1 = pred(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes + 16)));
+        // Pack the compare results down to one byte per code; packs interleaves 128-bit lanes,
+        // the permute restores row order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(c0, c1), _MM_SHUFFLE(3, 1, 2, 0));
+        return static_cast<uint32_t>(_mm256_movemask_epi8(packed));
+    }
+    static __m256i Widen8(const T* codes) {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes)));
+    }
+};
+
+struct Lanes32 {
+    using T = uint32_t;
+    static __m256i Set1(uint64_t v) { return _mm256_set1_epi32(static_cast<int>(v)); }
+    static __m256i Equal(__m256i a, __m256i b) { return _mm256_cmpeq_epi32(a, b); }
+    static __m256i InRange(__m256i x, __m256i lo, __m256i hi) {
+        return _mm256_and_si256(_mm256_cmpeq_epi32(_mm256_max_epu32(x, lo), x),
+                                _mm256_cmpeq_epi32(_mm256_min_epu32(x, hi), x));
+    }
+    template <typename Pred>
+    static uint32_t Match8(const T* codes, Pred pred) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+        return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(pred(v))));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        return Match8(codes, pred) | (Match8(codes + 8, pred) << 8)
+             | (Match8(codes + 16, pred) << 16) | (Match8(codes + 24, pred) << 24);
+    }
+    static __m256i Widen8(const T* codes) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+    }
+};
+
+struct Lanes64 {
+    using T = uint64_t;
+    static __m256i Set1(uint64_t v) { return _mm256_set1_epi64x(static_cast<long long>(v)); }
+    static __m256i Equal(__m256i a, __m256i b) { return _mm256_cmpeq_epi64(a, b); }
+    // AVX2 has no unsigned 64-bit compare, so flip the sign bits and compare signed;
+    // lo and hi are passed in already flipped
+    static __m256i InRange(__m256i x, __m256i lo, __m256i hi) {
+        __m256i flipped = _mm256_xor_si256(x, _mm256_set1_epi64x(static_cast<long long>(1ULL << 63)));
+        __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi64(lo, flipped), _mm256_cmpgt_epi64(flipped, hi));
+        return _mm256_xor_si256(outside, _mm256_set1_epi64x(-1));
+    }
+    template <typename Pred>
+    static uint32_t Match4(const T* codes, Pred pred) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes));
+        return static_cast<uint32_t>(_mm256_movemask_pd(_mm256_castsi256_pd(pred(v))));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        uint32_t mask = 0;
+        for (size_t j = 0; j < 32; j += 4) {
+            mask |= Match4(codes + j, pred) << j;
+        }
+        return mask;
+    }
+};
+
+// Write base + i for every set bit i of mask: 8 bits per step, one lane-table load and one 256-bit store
+inline uint32_t* Compact32(uint32_t mask, uint32_t base, uint32_t* out) {
+    for (unsigned shift = 0; shift < 32 && (mask >> shift) != 0; shift += 8) {
+        unsigned bits = (mask >> shift) & 0xFF;
+        __m256i lanes = _mm256_load_si256(reinterpret_cast<const __m256i*>(kCompactTable.lanes[bits]));
+        __m256i rows = _mm256_add_epi32(lanes, _mm256_set1_epi32(static_cast<int>(base + shift)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), rows);
+        out += __builtin_popcount(bits);
+    }
+    return out;
+}
+
+// Scan codes[0, n) 32 at a time; the tail is copied into a zero-padded block and its padding masked off
+template <typename T, typename Match32>
+size_t ScanTyped(const void* data, size_t n, uint32_t base, Match32 match32, uint32_t* out) {
+    const T* codes = static_cast<const T*>(data);
+    uint32_t* start = out;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        out = Compact32(match32(codes + i), base + static_cast<uint32_t>(i), out);
+    }
+    if (i < n) {
+        alignas(32) T tail[32] = {};
+        std::memcpy(tail, codes + i, (n - i) * sizeof(T));
+        uint32_t valid = (uint32_t(1) << (n - i)) - 1;
+        out = Compact32(match32(tail) & valid, base + static_cast<uint32_t>(i), out);
+    }
+    return out - start;
+}
+
+// Run a lane predicate over a code array of the given lane width
+template <typename Lanes, typename Pred>
+size_t ScanLanes(const void* data, size_t n, uint32_t base, Pred pred, uint32_t* out) {
+    using T = typename Lanes::T;
+    return ScanTyped<T>(data, n, base, [pred](const T* codes) { return Lanes::Match32(codes, pred); }, out);
+}
+
+template <typename Lanes>
+size_t Range(const void* data, size_t n, uint32_t base, uint64_t lo, uint64_t hi, uint32_t* out) {
+    // The 64-bit lanes compare signed, so their bounds are sign-flipped up front
+    uint64_t flip = sizeof(typename Lanes::T) == 8 ? (uint64_t(1) << 63) : 0;
+    __m256i loVec = Lanes::Set1(lo ^ flip);
+    __m256i hiVec = Lanes::Set1(hi ^ flip);
+    return ScanLanes<Lanes>(data, n, base, [loVec, hiVec](__m256i v) { return Lanes::InRange(v, loVec, hiVec); },
+                            out);
+}
+
+// Small code sets: OR together one equality compare per member
+template <typename Lanes>
+size_t SmallSet(const void* data, size_t n, uint32_t base, const uint64_t* keys, size_t count, uint32_t* out) {
+    __m256i keyVecs[kMaxSmallSetKeys];
+    for (size_t k = 0; k < count; ++k) {
+        keyVecs[k] = Lanes::Set1(keys[k]);
+    }
+    return ScanLanes<Lanes>(data, n, base,
+                            [&keyVecs, count](__m256i v) {
+                                __m256i hit = Lanes::Equal(v, keyVecs[0]);
+                                for (size_t k = 1; k < count; ++k) {
+                                    hit = _mm256_or_si256(hit, Lanes::Equal(v, keyVecs[k]));
+                                }
+                                return hit;
+                            },
+                            out);
+}
+
+// Test 8 codes held in 32-bit lanes against a membership bitmap with one gather
+inline uint32_t GatherMembers8(__m256i codes, const uint32_t* bitmap) {
+    __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bitmap), _mm256_srli_epi32(codes, 5), 4);
+    __m256i bits = _mm256_srlv_epi32(words, _mm256_and_si256(codes, _mm256_set1_epi32(31)));
+    // Move each membership bit into the sign bit so movemask can collect it
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_slli_epi32(bits, 31))));
+}
+
+// Large code sets: gather membership bits from the set's bitmap, 8 codes per gather
+template <typename Lanes>
+size_t Bitmap(const void* data, size_t n, uint32_t base, const uint32_t* bitmap, uint32_t* out) {
+    using T = typename Lanes::T;
+    return ScanTyped<T>(data, n, base,
+                        [bitmap](const T* codes) {
+                            return GatherMembers8(Lanes::Widen8(codes), bitmap)
+                                 | (GatherMembers8(Lanes::Widen8(codes + 8), bitmap) << 8)
+                                 | (GatherMembers8(Lanes::Widen8(codes + 16), bitmap) << 16)
+                                 | (GatherMembers8(Lanes::Widen8(codes + 24), bitmap) << 24);
+                        },
+                        out);
+}
+
+size_t Compact(uint64_t mask, uint32_t base, uint32_t* out) {
+    uint32_t* end = Compact32(static_cast<uint32_t>(mask), base, out);
+    return Compact32(static_cast<uint32_t>(mask >> 32), base + 32, end) - out;
+}
+
+// Compare 32 bytes at a time, the tail byte by byte
+bool StartsWith(const char* key, const char* prefix, size_t len) {
+    for (; len >= 32; len -= 32, key += 32, prefix += 32) {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefix));
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b))) != 0xFFFFFFFFu) return false;
+    }
+    return std::memcmp(key, prefix, len) == 0;
+}
+
+// Compare 32 bytes at a time, the tail byte by byte
+size_t CountByte(const char* data, size_t n, char byte) {
+    __m256i needle = _mm256_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        count += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle))));
+    }
+    for (; i < n; ++i) {
+        count += data[i] == byte;
+    }
+    return count;
+}
+
+size_t FindByte(const char* data, size_t n, char byte, uint32_t base, uint32_t* out) {
+    __m256i needle = _mm256_set1_epi8(byte);
+    uint32_t* next = out;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, needle)));
+        for (; mask != 0; mask &= mask - 1) {
+            *next++ = base + static_cast<uint32_t>(i + __builtin_ctz(mask));
+        }
+    }
+    for (; i < n; ++i) {
+        if (data[i] == byte) *next++ = base + static_cast<uint32_t>(i);
+    }
+    return next - out;
+}
+
+} // namespace
+
+// Replace the kernels AVX2 speeds up (64-bit membership tests have no gather and stay as they are)
+void AddAVX2Kernels(ScanKernels& kernels) {
+    kernels.range[0] = &Range<Lanes8>;
+    kernels.range[1] = &Range<Lanes16>;
+    kernels.range[2] = &Range<Lanes32>;
+    kernels.range[3] = &Range<Lanes64>;
+    kernels.smallSet[0] = &SmallSet<Lanes8>;
+    kernels.smallSet[1] = &SmallSet<Lanes16>;
+    kernels.smallSet[2] = &SmallSet<Lanes32>;
+    kernels.smallSet[3] = &SmallSet<Lanes64>;
+    kernels.bitmap[0] = &Bitmap<Lanes8>;
+    kernels.bitmap[1] = &Bitmap<Lanes16>;
+    kernels.bitmap[2] = &Bitmap<Lanes32>;
+    kernels.compact = &Compact;
+    kernels.startsWith = &StartsWith;
+    kernels.countByte = &CountByte;
+    kernels.findByte = &FindByte;
+}
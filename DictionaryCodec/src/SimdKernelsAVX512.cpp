@@ -0,0 +1,220 @@
+// SimdKernelsAVX512.cpp: 512-bit scan kernels, compiled with -mavx512f -mavx512bw -mavx512vl
+#include "SimdKernels.h"
+#include <immintrin.h> // AVX-512 SIMD instructions
+#include <cstring>     // std::memcpy
+
+// GCC 12's AVX-512 headers seed results with _mm512_undefined_epi32, which trips a false
+// maybe-uninitialized warning wherever those intrinsics inline
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+namespace {
+
+// Per-width lane operations. Compares land in mask registers, so there is no movemask step:
+// Match64 runs a predicate over 64 consecutive codes and returns one bit per code.
+struct Lanes8 {
+    using T = uint8_t;
+    static constexpr size_t kLanes = 64;
+    static __m512i Set1(uint64_t v) { return _mm512_set1_epi8(static_cast<char>(v)); }
+    static uint64_t Equal(__m512i a, __m512i b) { return _mm512_cmpeq_epi8_mask(a, b); }
+    // lo <= x <= hi as one unsigned compare: x - lo <= hi - lo
+    static uint64_t InRange(__m512i x, __m512i lo, __m512i span) {
+        return _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, lo), span);
+    }
+    // 16 codes zero-extended to 32-bit lanes
+    static __m512i Widen16(const T* codes) {
+        return _mm512_cvtepu8_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes)));
+    }
+};
+
+struct Lanes16 {
+    using T = uint16_t;
+    static constexpr size_t kLanes = 32;
+    static __m512i Set1(uint64_t v) { return _mm512_set1_epi16(static_cast<short>(v)); }
+    static uint64_t Equal(__m512i a, __m512i b) { return _mm512_cmpeq_epi16_mask(a, b); }
+    static uint64_t InRange(__m512i x, __m512i lo, __m512i span) {
+        return _mm512_cmple_epu16_mask(_mm512_sub_epi16(x, lo), span);
+    }
+    static __m512i Widen16(const T* codes) {
+        return _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(codes)));
+    }
+};
+
+struct Lanes32 {
+    using T = uint32_t;
+    static constexpr size_t kLanes = 16;
+    static __m512i Set1(uint64_t v) { return _mm512_set1_epi32(static_cast<int>(v)); }
+    static uint64_t Equal(__m512i a, __m512i b) { return _mm512_cmpeq_epi32_mask(a, b); }
+    static uint64_t InRange(__m512i x, __m512i lo, __m512i span) {
+        return _mm512_cmple_epu32_mask(_mm512_sub_epi32(x, lo), span);
+    }
+    static __m512i Widen16(const T* codes) {
+        return _mm512_loadu_si512(codes);
+    }
+};
+
+struct Lanes64 {
+    using T = uint64_t;
+    static constexpr size_t kLanes = 8;
+    static __m512i Set1(uint64_t v) { return _mm512_set1_epi64(static_cast<long long>(v)); }
+    static uint64_t Equal(__m512i a, __m512i b) { return _mm512_cmpeq_epi64_mask(a, b); }
+    // AVX-512 compares 64-bit lanes unsigned, no sign flip needed
+    static uint64_t InRange(__m512i x, __m512i lo, __m512i span) {
+        return _mm512_cmple_epu64_mask(_mm512_sub_epi64(x, lo), span);
+    }
+};
+
+template <typename Lanes, typename Pred>
+uint64_t Match64(const typename Lanes::T* codes, Pred pred) {
+    uint64_t mask = 0;
+    for (size_t j = 0; j < 64; j += Lanes::kLanes) {
+        mask |= pred(_mm512_loadu_si512(codes + j)) << j;
+    }
+    return mask;
+}
+
+// Write base + i for every set bit i of mask: each 16-bit slice compresses the matching row ids
+// to the front of a register, which is stored whole (cheaper than a compress straight to memory)
+inline uint32_t* Compact64(uint64_t mask, uint32_t base, uint32_t* out) {
+    const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    for (unsigned shift = 0; shift < 64 && (mask >> shift) != 0; shift += 16) {
+        __mmask16 bits = static_cast<__mmask16>(mask >> shift);
+        if (bits == 0) continue;
+        __m512i rows = _mm512_add_epi32(iota, _mm512_set1_epi32(static_cast<int>(base + shift)));
+        _mm512_storeu_si512(out, _mm512_maskz_compress_epi32(bits, rows));
+        out += __builtin_popcount(bits);
+    }
+    return out;
+}
+
+// Scan codes[0, n) 64 at a time; the tail is copied into a zero-padded block and its padding masked off
+template <typename T, typename Match>
+size_t ScanTyped(const void* data, size_t n, uint32_t base, Match match64, uint32_t* out) {
+    const T* codes = static_cast<const T*>(data);
+    uint32_t* start = out;
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        out = Compact64(match64(codes + i), base + static_cast<uint32_t>(i), out);
+    }
+    if (i < n) {
+        alignas(64) T tail[64] = {};
+        std::memcpy(tail, codes + i, (n - i) * sizeof(T));
+        uint64_t valid = (uint64_t(1) << (n - i)) - 1;
+        out = Compact64(match64(tail) & valid, base + static_cast<uint32_t>(i), out);
+    }
+    return out - start;
+}
+
+template <typename Lanes>
+size_t Range(const void* data, size_t n, uint32_t base, uint64_t lo, uint64_t hi, uint32_t* out) {
+    using T = typename Lanes::T;
+    __m512i loVec = Lanes::Set1(lo);
+    __m512i spanVec = Lanes::Set1(hi - lo);
+    return ScanTyped<T>(data, n, base,
+                        [loVec, spanVec](const T* codes) {
+                            return Match64<Lanes>(codes, [loVec, spanVec](__m512i v) {
+                                return Lanes::InRange(v, loVec, spanVec);
+                            });
+                        },
+                        out);
+}
+
+// Small code sets: OR together one equality compare per member
+template <typename Lanes>
+size_t SmallSet(const void* data, size_t n, uint32_t base, const uint64_t* keys, size_t count, uint32_t* out) {
+    using T = typename Lanes::T;
+    __m512i keyVecs[kMaxSmallSetKeys];
+    for (size_t k = 0; k < count; ++k) {
+        keyVecs[k] = Lanes::Set1(keys[k]);
+    }
+    return ScanTyped<T>(data, n, base,
+                        [&keyVecs, count](const T* codes) {
+                            return Match64<Lanes>(codes, [&keyVecs, count](__m512i v) {
+                                uint64_t hit = Lanes::Equal(v, keyVecs[0]);
+                                for (size_t k = 1; k < count; ++k) {
+                                    hit |= Lanes::Equal(v, keyVecs[k]);
+                                }
+                                return hit;
+                            });
+                        },
+                        out);
+}
+
+// Test 16 codes held in 32-bit lanes against a membership bitmap with one gather
+inline uint64_t GatherMembers16(__m512i codes, const uint32_t* bitmap) {
+    __m512i words = _mm512_i32gather_epi32(_mm512_srli_epi32(codes, 5), bitmap, 4);
+    __m512i bit = _mm512_sllv_epi32(_mm512_set1_epi32(1), _mm512_and_si512(codes, _mm512_set1_epi32(31)));
+    return _mm512_test_epi32_mask(words, bit);
+}
+
+// Large code sets: gather membership bits from the set's bitmap, 16 codes per gather
+template <typename Lanes>
+size_t Bitmap(const void* data, size_t n, uint32_t base, const uint32_t* bitmap, uint32_t* out) {
+    using T = typename Lanes::T;
+    return ScanTyped<T>(data, n, base,
+                        [bitmap](const T* codes) {
+                            return GatherMembers16(Lanes::Widen16(codes), bitmap)
+                                 | (GatherMembers16(Lanes::Widen16(codes + 16), bitmap) << 16)
+                                 | (GatherMembers16(Lanes::Widen16(codes + 32), bitmap) << 32)
+                                 | (GatherMembers16(Lanes::Widen16(codes + 48), bitmap) << 48);
+                        },
+                        out);
+}
+
+size_t Compact(uint64_t mask, uint32_t base, uint32_t* out) {
+    return Compact64(mask, base, out) - out;
+}
+
+// Compare 64 bytes at a time; the tail uses masked loads, which never touch bytes past len
+bool StartsWith(const char* key, const char* prefix, size_t len) {
+    for (; len >= 64; len -= 64, key += 64, prefix += 64) {
+        if (_mm512_cmpneq_epi8_mask(_mm512_loadu_si512(key), _mm512_loadu_si512(prefix)) != 0) return false;
+    }
+    __mmask64 valid = (uint64_t(1) << len) - 1;
+    return _mm512_mask_cmpneq_epi8_mask(valid, _mm512_maskz_loadu_epi8(valid, key),
+                                        _mm512_maskz_loadu_epi8(valid, prefix)) == 0;
+}
+
+// Compare 64 bytes at a time; the tail is one masked load
+size_t CountByte(const char* data, size_t n, char byte) {
+    __m512i needle = _mm512_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 64 <= n; i += 64) {
+        count += __builtin_popcountll(_mm512_cmpeq_epi8_mask(_mm512_loadu_si512(data + i), needle));
+    }
+    __mmask64 valid = (uint64_t(1) << (n - i)) - 1;
+    return count + __builtin_popcountll(_mm512_mask_cmpeq_epi8_mask(valid, _mm512_maskz_loadu_epi8(valid, data + i), needle));
+}
+
+size_t FindByte(const char* data, size_t n, char byte, uint32_t base, uint32_t* out) {
+    __m512i needle = _mm512_set1_epi8(byte);
+    uint32_t* next = out;
+    for (size_t i = 0; i < n; i += 64) {
+        __mmask64 valid = n - i >= 64 ? ~uint64_t(0) : (uint64_t(1) << (n - i)) - 1;
+        uint64_t mask = _mm512_mask_cmpeq_epi8_mask(valid, _mm512_maskz_loadu_epi8(valid, data + i), needle);
+        for (; mask != 0; mask &= mask - 1) {
+            *next++ = base + static_cast<uint32_t>(i + __builtin_ctzll(mask));
+        }
+    }
+    return next - out;
+}
+
+} // namespace
+
+// Replace the kernels AVX-512 speeds up (64-bit membership tests stay as they are)
+void AddAVX512Kernels(ScanKernels& kernels) {
+    kernels.range[0] = &Range<Lanes8>;
+    kernels.range[1] = &Range<Lanes16>;
+    kernels.range[2] = &Range<Lanes32>;
+    kernels.range[3] = &Range<Lanes64>;
+    kernels.smallSet[0] = &SmallSet<Lanes8>;
+    kernels.smallSet[1] = &SmallSet<Lanes16>;
+    kernels.smallSet[2] = &SmallSet<Lanes32>;
+    kernels.smallSet[3] = &SmallSet<Lanes64>;
+    kernels.bitmap[0] = &Bitmap<Lanes8>;
+    kernels.bitmap[1] = &Bitmap<Lanes16>;
+    kernels.bitmap[2] = &Bitmap<Lanes32>;
+    kernels.compact = &Compact;
+    kernels.startsWith = &StartsWith;
+    kernels.countByte = &CountByte;
+    kernels.findByte = &FindByte;
+}
@@ -0,0 +1,205 @@
+// SimdKernelsSSE42.cpp: 128-bit scan kernels, compiled with -msse4.2
+#include "SimdKernels.h"
+#include <nmmintrin.h> // SSE4.2 SIMD instructions
+#include <cstring>     // std::memcmp, std::memcpy
+
+namespace {
+
+// Per-width lane operations. Match32 runs a lane predicate over 32 consecutive codes and
+// returns one bit per code, so every width shares the same scan driver.
+struct Lanes8 {
+    using T = uint8_t;
+    static __m128i Set1(uint64_t v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static __m128i Equal(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+    // lo <= x <= hi as unsigned: x survives both the max with lo and the min with hi
+    static __m128i InRange(__m128i x, __m128i lo, __m128i hi) {
+        return _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, lo), x), _mm_cmpeq_epi8(_mm_min_epu8(x, hi), x));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        uint32_t m0 = _mm_movemask_epi8(pred(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes))));
+        uint32_t m1 = _mm_movemask_epi8(pred(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 16))));
+        return m0 | (m1 << 16);
+    }
+};
+
+struct Lanes16 {
+    using T = uint16_t;
+    static __m128i Set1(uint64_t v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static __m128i Equal(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+    static __m128i InRange(__m128i x, __m128i lo, __m128i hi) {
+        return _mm_and_si128(_mm_cmpeq_epi16(_mm_max_epu16(x, lo), x), _mm_cmpeq_epi16(_mm_min_epu16(x, hi), x));
+    }
+    // 16 codes: pack the compare results down to one byte per code
+    template <typename Pred>
+    static uint32_t Match16(const T* codes, Pred pred) {
+        __m128i c0 = pred(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes)));
+        __m128i c1 = pred(_mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + 8)));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(c0, c1)));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        return Match16(codes, pred) | (Match16(codes + 16, pred) << 16);
+    }
+};
+
+struct Lanes32 {
+    using T = uint32_t;
+    static __m128i Set1(uint64_t v) { return _mm_set1_epi32(static_cast<int>(v)); }
+    static __m128i Equal(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+    static __m128i InRange(__m128i x, __m128i lo, __m128i hi) {
+        return _mm_and_si128(_mm_cmpeq_epi32(_mm_max_epu32(x, lo), x), _mm_cmpeq_epi32(_mm_min_epu32(x, hi), x));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        uint32_t mask = 0;
+        for (size_t j = 0; j < 32; j += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j));
+            mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(pred(v)))) << j;
+        }
+        return mask;
+    }
+};
+
+struct Lanes64 {
+    using T = uint64_t;
+    static __m128i Set1(uint64_t v) { return _mm_set1_epi64x(static_cast<long long>(v)); }
+    static __m128i Equal(__m128i a, __m128i b) { return _mm_cmpeq_epi64(a, b); }
+    // No unsigned 64-bit compare, so flip the sign bits and compare signed; lo and hi come in already flipped
+    static __m128i InRange(__m128i x, __m128i lo, __m128i hi) {
+        __m128i flipped = _mm_xor_si128(x, _mm_set1_epi64x(static_cast<long long>(1ULL << 63)));
+        __m128i outside = _mm_or_si128(_mm_cmpgt_epi64(lo, flipped), _mm_cmpgt_epi64(flipped, hi));
+        return _mm_xor_si128(outside, _mm_set1_epi64x(-1));
+    }
+    template <typename Pred>
+    static uint32_t Match32(const T* codes, Pred pred) {
+        uint32_t mask = 0;
+        for (size_t j = 0; j < 32; j += 2) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(codes + j));
+            mask |= static_cast<uint32_t>(_mm_movemask_pd(_mm_castsi128_pd(pred(v)))) << j;
+        }
+        return mask;
+    }
+};
+
+// Write base + i for every set bit i of mask, 8 bits per step through the lane table
+inline uint32_t* Compact32(uint32_t mask, uint32_t base, uint32_t* out) {
+    for (unsigned shift = 0; shift < 32 && (mask >> shift) != 0; shift += 8) {
+        unsigned bits = (mask >> shift) & 0xFF;
+        __m128i offset = _mm_set1_epi32(static_cast<int>(base + shift));
+        const __m128i* lanes = reinterpret_cast<const __m128i*>(kCompactTable.lanes[bits]);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_add_epi32(_mm_load_si128(lanes), offset));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4), _mm_add_epi32(_mm_load_si128(lanes + 1), offset));
+        out += __builtin_popcount(bits);
+    }
+    return out;
+}
+
+// Scan codes[0, n) 32 at a time; the tail is copied into a zero-padded block and its padding masked off
+template <typename Lanes, typename Pred>
+size_t ScanLanes(const void* data, size_t n, uint32_t base, Pred pred, uint32_t* out) {
+    using T = typename Lanes::T;
+    const T* codes = static_cast<const T*>(data);
+    uint32_t* start = out;
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        out = Compact32(Lanes::Match32(codes + i, pred), base + static_cast<uint32_t>(i), out);
+    }
+    if (i < n) {
+        alignas(16) T tail[32] = {};
+        std::memcpy(tail, codes + i, (n - i) * sizeof(T));
+        uint32_t valid = (uint32_t(1) << (n - i)) - 1;
+        out = Compact32(Lanes::Match32(tail, pred) & valid, base + static_cast<uint32_t>(i), out);
+    }
+    return out - start;
+}
+
+template <typename Lanes>
+size_t Range(const void* data, size_t n, uint32_t base, uint64_t lo, uint64_t hi, uint32_t* out) {
+    // The 64-bit lanes compare signed, so their bounds are sign-flipped up front
+    uint64_t flip = sizeof(typename Lanes::T) == 8 ? (uint64_t(1) << 63) : 0;
+    __m128i loVec = Lanes::Set1(lo ^ flip);
+    __m128i hiVec = Lanes::Set1(hi ^ flip);
+    return ScanLanes<Lanes>(data, n, base, [loVec, hiVec](__m128i v) { return Lanes::InRange(v, loVec, hiVec); },
+                            out);
+}
+
+template <typename Lanes>
+size_t SmallSet(const void* data, size_t n, uint32_t base, const uint64_t* keys, size_t count, uint32_t* out) {
+    __m128i keyVecs[kMaxSmallSetKeys];
+    for (size_t k = 0; k < count; ++k) {
+        keyVecs[k] = Lanes::Set1(keys[k]);
+    }
+    return ScanLanes<Lanes>(data, n, base,
+                            [&keyVecs, count](__m128i v) {
+                                __m128i hit = Lanes::Equal(v, keyVecs[0]);
+                                for (size_t k = 1; k < count; ++k) {
+                                    hit = _mm_or_si128(hit, Lanes::Equal(v, keyVecs[k]));
+                                }
+                                return hit;
+                            },
+                            out);
+}
+
+size_t Compact(uint64_t mask, uint32_t base, uint32_t* out) {
+    uint32_t* end = Compact32(static_cast<uint32_t>(mask), base, out);
+    return Compact32(static_cast<uint32_t>(mask >> 32), base + 32, end) - out;
+}
+
+// Compare 16 bytes at a time, the tail byte by byte
+bool StartsWith(const char* key, const char* prefix, size_t len) {
+    for (; len >= 16; len -= 16, key += 16, prefix += 16) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefix));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF) return false;
+    }
+    return std::memcmp(key, prefix, len) == 0;
+}
+
+// Compare 16 bytes at a time, the tail byte by byte
+size_t CountByte(const char* data, size_t n, char byte) {
+    __m128i needle = _mm_set1_epi8(byte);
+    size_t count = 0, i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        count += __builtin_popcount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)));
+    }
+    for (; i < n; ++i) {
+        count += data[i] == byte;
+    }
+    return count;
+}
+
+size_t FindByte(const char* data, size_t n, char byte, uint32_t base, uint32_t* out) {
+    __m128i needle = _mm_set1_epi8(byte);
+    uint32_t* next = out;
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        for (uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, needle)); mask != 0; mask &= mask - 1) {
+            *next++ = base + static_cast<uint32_t>(i + __builtin_ctz(mask));
+        }
+    }
+    for (; i < n; ++i) {
+        if (data[i] == byte) *next++ = base + static_cast<uint32_t>(i);
+    }
+    return next - out;
+}
+
+} // namespace
+
+// Replace the kernels SSE4.2 speeds up (membership bitmaps stay scalar, there is no gather)
+void AddSSE42Kernels(ScanKernels& kernels) {
+    kernels.range[0] = &Range<Lanes8>;
+    kernels.range[1] = &Range<Lanes16>;
+    kernels.range[2] = &Range<Lanes32>;
+    kernels.range[3] = &Range<Lanes64>;
+    kernels.smallSet[0] = &SmallSet<Lanes8>;
+    kernels.smallSet[1] = &SmallSet<Lanes16>;
+    kernels.smallSet[2] = &SmallSet<Lanes32>;
+    kernels.smallSet[3] = &SmallSet<Lanes64>;
+    kernels.compact = &Compact;
+    kernels.startsWith = &StartsWith;
+    kernels.countByte = &CountByte;
+    kernels.findByte = &FindByte;
+}
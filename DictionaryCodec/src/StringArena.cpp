@@ -0,0 +1,61 @@
+// StringArena.cpp: Dictionary keys stored back to back in one buffer, indexed by code
+#include "StringArena.h"
+#include <utility>
+
+// Drop every string, leaving owned storage with room for count strings of bytes in total
+void StringArena::Reset(size_t count, size_t bytes) {
+    ownedOffsets_.assign(1, 0);
+    ownedOffsets_.reserve(count + 1);
+    ownedBytes_.clear();
+    ownedBytes_.reserve(bytes);
+    offsets_ = ownedOffsets_.data();
+    bytes_ = ownedBytes_.data();
+    count_ = 0;
+}
+
+// Append a copy of key to owned storage
+size_t StringArena::Add(std::string_view key) {
+    // An attached arena copies its strings into owned storage first
+    if (offsets_ != ownedOffsets_.data()) {
+        std::vector<uint64_t> offsets(offsets_, offsets_ + count_ + 1);
+        std::vector<char> bytes(bytes_ + offsets_[0], bytes_ + offsets_[count_]);
+        for (uint64_t& offset : offsets) {
+            offset -= offsets_[0];
+        }
+        ownedOffsets_ = std::move(offsets);
+        ownedBytes_ = std::move(bytes);
+    }
+    ownedBytes_.insert(ownedBytes_.end(), key.begin(), key.end());
+    ownedOffsets_.push_back(ownedBytes_.size());
+    offsets_ = ownedOffsets_.data();
+    bytes_ = ownedBytes_.data();
+    return count_++;
+}
+
+// Point the arena at an external offsets array and byte buffer
+bool StringArena::Attach(const uint64_t* offsets, size_t count, const char* bytes, size_t bytesLen) {
+    for (size_t i = 0; i < count; ++i) {
+        if (offsets[i] > offsets[i + 1]) return false;
+    }
+    if (offsets[count] > bytesLen) return false;
+
+    ownedOffsets_.clear();
+    ownedOffsets_.shrink_to_fit();
+    ownedBytes_.clear();
+    ownedBytes_.shrink_to_fit();
+    offsets_ = offsets;
+    bytes_ = bytes;
+    count_ = count;
+    return true;
+}
+
+// Drop every string and release owned storage
+void StringArena::Clear() {
+    ownedOffsets_.assign(1, 0);
+    ownedOffsets_.shrink_to_fit();
+    ownedBytes_.clear();
+    ownedBytes_.shrink_to_fit();
+    offsets_ = ownedOffsets_.data();
+    bytes_ = ownedBytes_.data();
+    count_ = 0;
+}
@@ -0,0 +1,99 @@
+// ThreadPool.cpp: Persistent worker threads that run indexed tasks for parallel loops
+#include "ThreadPool.h"
+#include "QueryStats.h"
+#include <algorithm> // std::min, std::find
+
+// Start numThreads - 1 workers, the caller of a loop is the remaining thread
+ThreadPool::ThreadPool(unsigned int numThreads) {
+    if (numThreads == 0) numThreads = std::thread::hardware_concurrency();
+    for (unsigned int t = 1; t < numThreads; ++t) {
+        workers_.emplace_back(&ThreadPool::WorkerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+// Pool shared by the codec, sized to the hardware
+ThreadPool& ThreadPool::Shared() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Run fn(i) for every i in [0, tasks) and wait for all of them
+void ThreadPool::ParallelFor(size_t tasks, const std::function<void(size_t)>& fn, unsigned int maxThreads) {
+    // A profiled query's tasks record into its trace on whichever thread runs them
+    if (QueryTrace* trace = QueryTrace::Active()) {
+        RunLoop(tasks, [&fn, trace](size_t i) {
+            QueryTrace::TaskScope scope(trace);
+            fn(i);
+        }, maxThreads);
+        return;
+    }
+    RunLoop(tasks, fn, maxThreads);
+}
+
+// Run the loop on up to maxThreads threads
+void ThreadPool::RunLoop(size_t tasks, const std::function<void(size_t)>& fn, unsigned int maxThreads) {
+    unsigned int threads = maxThreads == 0 ? Size() : std::min(maxThreads, Size());
+    if (threads <= 1 || tasks <= 1) {
+        for (size_t i = 0; i < tasks; ++i) {
+            fn(i);
+        }
+        return;
+    }
+
+    Loop loop;
+    loop.fn = &fn;
+    loop.tasks = tasks;
+    loop.helpers = static_cast<unsigned int>(std::min<size_t>(threads - 1, tasks - 1));
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.push_back(&loop);
+    wake_.notify_all();
+
+    RunTasks(loop, lock);
+
+    // No task is left to claim: stop more workers joining, then wait for the ones inside
+    auto it = std::find(queue_.begin(), queue_.end(), &loop);
+    if (it != queue_.end()) queue_.erase(it);
+    done_.wait(lock, [&loop] { return loop.finished == loop.tasks && loop.active == 0; });
+}
+
+// Claim and run tasks of loop until none are left
+void ThreadPool::RunTasks(Loop& loop, std::unique_lock<std::mutex>& lock) {
+    while (loop.next < loop.tasks) {
+        size_t i = loop.next++;
+        lock.unlock();
+        (*loop.fn)(i);
+        lock.lock();
+        loop.finished++;
+    }
+}
+
+// Worker thread body: join queued loops until the pool shuts down
+void ThreadPool::WorkerMain() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (stopping_) return;
+
+        Loop* loop = queue_.front();
+        if (--loop->helpers == 0) queue_.pop_front();
+        loop->active++;
+
+        RunTasks(*loop, lock);
+
+        // The caller owns the loop, it may return as soon as the last worker leaves
+        loop->active--;
+        if (loop->active == 0 && loop->finished == loop->tasks) done_.notify_all();
+    }
+}
@@ -0,0 +1,205 @@
+// ZoneMap.cpp: Per-zone code bounds and presence filters, so scans can skip zones that cannot match
+#include "ZoneMap.h"
+#include <algorithm> // std::min, std::max
+#include <cstring>   // std::memcpy
+#include <utility>   // std::pair
+
+namespace {
+
+// Header words of the layout (rows, zone count, filter bits, exact)
+constexpr size_t kHeaderWords = 4;
+
+// Codes are unpacked this many at a time while filling a zone
+constexpr size_t kFillBatch = 1024;
+
+// Sets with more members than this are not probed against a hashed filter, one of them almost
+// always hits anyway
+constexpr size_t kProbeCodes = 64;
+
+// Filter bits per zone for a code space: an exact bitmap if it fits, the largest Bloom filter if not
+size_t FilterBitsFor(size_t codeSpace) {
+    if (codeSpace > ZoneMap::kMaxFilterBits) return ZoneMap::kMaxFilterBits;
+    size_t bits = 64;
+    while (bits < codeSpace) bits <<= 1;
+    return bits;
+}
+
+// The two filter bits of a code in a hashed filter of filterBits bits
+inline std::pair<size_t, size_t> HashedBits(size_t code, size_t filterBits) {
+    uint64_t hash = code * 0x9E3779B97F4A7C15ULL;
+    return {(hash >> 40) & (filterBits - 1), (hash >> 20) & (filterBits - 1)};
+}
+
+// Bytes of the layout
+inline size_t LayoutBytes(size_t zoneCount, size_t filterBits) {
+    return kHeaderWords * sizeof(uint64_t) + zoneCount * 2 * sizeof(uint64_t) + zoneCount * filterBits / 8;
+}
+
+} // namespace
+
+// Bytes of the serialized map
+size_t ZoneMap::BytesFor(size_t rows, size_t codeSpace) {
+    return LayoutBytes((rows + kZoneRows - 1) / kZoneRows, FilterBitsFor(codeSpace));
+}
+
+// Build the map of an encoded column
+void ZoneMap::Build(const CodeColumn& column, size_t codeSpace) {
+    Allocate(column.Size(), codeSpace);
+    Fill(column, 0);
+}
+
+// Allocate an empty map: every zone starts with an empty code range and no filter bits
+void ZoneMap::Allocate(size_t rows, size_t codeSpace) {
+    size_t zoneCount = (rows + kZoneRows - 1) / kZoneRows;
+    size_t filterBits = FilterBitsFor(codeSpace);
+    size_t bytes = LayoutBytes(zoneCount, filterBits);
+    owned_.assign(bytes / sizeof(uint64_t), 0);
+
+    uint64_t header[kHeaderWords] = {rows, zoneCount, filterBits, codeSpace <= kMaxFilterBits ? 1u : 0u};
+    std::memcpy(owned_.data(), header, sizeof(header));
+    std::fill(owned_.begin() + kHeaderWords, owned_.begin() + kHeaderWords + zoneCount, ~uint64_t(0));
+    Attach(owned_.data(), bytes);
+}
+
+// Record the zones of codes
+void ZoneMap::Fill(const CodeColumn& codes, size_t firstRow) {
+    uint64_t* minCodes = owned_.data() + kHeaderWords;
+    uint64_t* maxCodes = minCodes + zoneCount_;
+    uint32_t* filters = reinterpret_cast<uint32_t*>(maxCodes + zoneCount_);
+    size_t batch[kFillBatch];
+
+    for (size_t begin = 0; begin < codes.Size(); begin += kZoneRows) {
+        size_t zone = (firstRow + begin) / kZoneRows;
+        if (zone >= zoneCount_) break;
+        size_t end = std::min(begin + kZoneRows, codes.Size());
+        uint64_t lo = minCodes[zone], hi = maxCodes[zone];
+        uint32_t* filter = filters + zone * (filterBits_ / 32);
+        for (size_t start = begin; start < end; start += kFillBatch) {
+            size_t count = std::min(kFillBatch, end - start);
+            codes.Unpack(start, start + count, batch);
+            for (size_t i = 0; i < count; ++i) {
+                size_t code = batch[i];
+                lo = std::min<uint64_t>(lo, code);
+                hi = std::max<uint64_t>(hi, code);
+                if (exact_) {
+                    filter[code >> 5] |= uint32_t(1) << (code & 31);
+                } else {
+                    auto [a, b] = HashedBits(code, filterBits_);
+                    filter[a >> 5] |= uint32_t(1) << (a & 31);
+                    filter[b >> 5] |= uint32_t(1) << (b & 31);
+                }
+            }
+        }
+        minCodes[zone] = lo;
+        maxCodes[zone] = hi;
+    }
+}
+
+// Point the map at serialized bytes
+bool ZoneMap::Attach(const void* data, size_t bytes) {
+    const uint8_t* base = static_cast<const uint8_t*>(data);
+    uint64_t header[kHeaderWords];
+    if (bytes < sizeof(header)) return false;
+    std::memcpy(header, base, sizeof(header));
+    uint64_t rows = header[0], zoneCount = header[1], filterBits = header[2], exact = header[3];
+    if (zoneCount != (rows + kZoneRows - 1) / kZoneRows || zoneCount > bytes ||
+        filterBits < 32 || filterBits > kMaxFilterBits || (filterBits & (filterBits - 1)) != 0 || exact > 1 ||
+        LayoutBytes(zoneCount, filterBits) != bytes) {
+        return false;
+    }
+
+    // Keep owned storage only if data points into it
+    if (owned_.empty() || data != owned_.data()) {
+        owned_.clear();
+        owned_.shrink_to_fit();
+    }
+    data_ = base;
+    bytes_ = bytes;
+    rows_ = rows;
+    zoneCount_ = zoneCount;
+    filterBits_ = filterBits;
+    exact_ = exact == 1;
+    minCodes_ = reinterpret_cast<const uint64_t*>(base) + kHeaderWords;
+    maxCodes_ = minCodes_ + zoneCount;
+    filters_ = reinterpret_cast<const uint32_t*>(maxCodes_ + zoneCount);
+    return true;
+}
+
+// Drop the map
+void ZoneMap::Clear() {
+    owned_.clear();
+    owned_.shrink_to_fit();
+    data_ = nullptr;
+    bytes_ = 0;
+    rows_ = 0;
+    zoneCount_ = 0;
+    filterBits_ = 0;
+    exact_ = false;
+    minCodes_ = nullptr;
+    maxCodes_ = nullptr;
+    filters_ = nullptr;
+}
+
+// Bounds first, then the filter bit(s) of the code
+bool ZoneMap::MayContain(size_t zone, size_t code) const {
+    if (zone >= zoneCount_) return true;
+    if (code < minCodes_[zone] || code > maxCodes_[zone]) return false;
+
+    const uint32_t* filter = Filter(zone);
+    if (exact_) {
+        return (filter[code >> 5] >> (code & 31)) & 1;
+    }
+    auto [a, b] = HashedBits(code, filterBits_);
+    return ((filter[a >> 5] >> (a & 31)) & 1) && ((filter[b >> 5] >> (b & 31)) & 1);
+}
+
+// The range clipped to the zone's bounds, then (exact filters only) any code present inside it
+bool ZoneMap::MayOverlap(size_t zone, size_t lo, size_t hi) const {
+    if (lo >= hi) return false;
+    if (zone >= zoneCount_) return true;
+    size_t first = std::max<size_t>(lo, minCodes_[zone]);
+    size_t last = std::min<size_t>(hi - 1, maxCodes_[zone]);
+    if (first > last) return false;
+    return !exact_ || AnyInRange(zone, first, last);
+}
+
+// The set's bounds clipped to the zone's, then its members tested against the filter: word by word
+// for an exact filter, one probe per member for a hashed one
+bool ZoneMap::MayContainAny(size_t zone, const CodeSet& set) const {
+    if (set.Empty()) return false;
+    if (zone >= zoneCount_) return true;
+    size_t first = std::max<size_t>(set.Min(), minCodes_[zone]);
+    size_t last = std::min<size_t>(set.Max(), maxCodes_[zone]);
+    if (first > last) return false;
+    if (set.IsContiguous()) {
+        return !exact_ || AnyInRange(zone, first, last);
+    }
+
+    if (exact_) {
+        // The filter has no bits outside the zone's bounds, so whole words can be compared
+        const uint32_t* filter = Filter(zone);
+        const uint32_t* bitmap = set.Bitmap();
+        for (size_t word = first >> 5; word <= last >> 5; ++word) {
+            if (filter[word] & bitmap[word]) return true;
+        }
+        return false;
+    }
+    if (set.Count() > kProbeCodes) return true;
+    for (size_t code : set.Codes()) {
+        if (MayContain(zone, code)) return true;
+    }
+    return false;
+}
+
+// True if zone's exact filter has a bit set in codes [lo, last]
+bool ZoneMap::AnyInRange(size_t zone, size_t lo, size_t last) const {
+    const uint32_t* filter = Filter(zone);
+    size_t firstWord = lo >> 5, lastWord = last >> 5;
+    for (size_t word = firstWord; word <= lastWord; ++word) {
+        uint32_t bits = filter[word];
+        if (word == firstWord) bits &= ~uint32_t(0) << (lo & 31);
+        if (word == lastWord) bits &= ~uint32_t(0) >> (31 - (last & 31));
+        if (bits != 0) return true;
+    }
+    return false;
+}